@@ -5,6 +5,15 @@
       "sources": [
         "lib/hdt.cc",
         "lib/HdtDocument.cc",
+        "lib/HdtCursor.cc",
+        "lib/BasicGraphPattern.cc",
+        "lib/ContinuationTable.cc",
+        "lib/QueryExecutor.cc",
+        "lib/PatternStatistics.cc",
+        "lib/LiteralIndex.cc",
+        "lib/PrefixRange.cc",
+        "lib/HdtMemory.cc",
+        "lib/HdtRegistry.cc",
         "<!@(ls -1 deps/libhdt/src/bitsequence/*.cpp)",
         "<!@(ls -1 deps/libhdt/src/dictionary/*.cpp)",
         "<!@(ls -1 deps/libhdt/src/hdt/*.cpp)",
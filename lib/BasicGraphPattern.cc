@@ -0,0 +1,284 @@
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <HDTEnums.hpp>
+#include <HDTManager.hpp>
+#include "BasicGraphPattern.h"
+#include "HdtDocument.h"
+#include "PatternStatistics.h"
+
+using namespace std;
+using namespace hdt;
+
+// A merge join scans all matches of a pattern, so it is only chosen
+// if the pattern has at most this many matches per row to join with
+const size_t MERGE_JOIN_FACTOR = 32;
+
+
+
+/******** Construction ********/
+
+
+// Creates a basic graph pattern from a list of subject, predicate, and object strings.
+BasicGraphPattern::BasicGraphPattern(HDT* hdt, TermCache* termCache, const vector<string>& components,
+                                     const PatternStatistics* statistics)
+  : hdt(hdt), dict(hdt->getDictionary()), termCache(termCache), statistics(statistics),
+    shared(dict->getNshared()), hasMatches(true) {
+  map<string, int> variableIds;
+  for (size_t i = 0; i + 2 < components.size(); i += 3) {
+    Pattern pattern;
+    for (int position = 0; position < 3; position++) {
+      string component(components[i + position]);
+      Term& term = pattern.terms[position];
+      term.id = 0, term.variable = -1;
+      // Assign an index to every distinct variable
+      if (component[0] == '?') {
+        map<string, int>::const_iterator variable = variableIds.find(component);
+        if (variable != variableIds.end()) {
+          term.variable = variable->second;
+        }
+        else {
+          term.variable = variableIds[component] = variables.size();
+          variables.push_back(component.substr(1));
+          variableRoles.push_back(SUBJECT);
+        }
+      }
+      // Look up the ID of every other term; without it, the pattern has no matches
+      else if (!component.empty()) {
+        TripleComponentRole role = (TripleComponentRole)position;
+        term.id = dict->stringToId(role == OBJECT ? toHdtLiteral(component) : component, role);
+        hasMatches = hasMatches && term.id;
+      }
+    }
+    patterns.push_back(pattern);
+  }
+
+  // Estimate the number of matches of every pattern on its own
+  for (vector<Pattern>::iterator pattern = patterns.begin(); hasMatches && pattern != patterns.end(); pattern++) {
+    TripleID tripleId(pattern->terms[0].id, pattern->terms[1].id, pattern->terms[2].id);
+    IteratorTripleID* it = hdt->getTriples()->search(tripleId);
+    pattern->estimate = it->estimatedNumResults();
+    uint64_t count;
+    if (it->numResultEstimation() != EXACT && statistics && statistics->Count(tripleId, count))
+      pattern->estimate = (size_t)count;
+    hasMatches = it->hasNext();
+    delete it;
+  }
+}
+
+
+
+/******** Evaluation ********/
+
+
+// Evaluates the pattern, decoding the bindings from offset to offset + limit.
+size_t BasicGraphPattern::Evaluate(uint64_t offset, uint64_t limit, vector<string>& bindings) {
+  if (!hasMatches)
+    return 0;
+  OrderPatterns();
+
+  // Join the patterns one by one, starting from a single empty row
+  const size_t width = Width();
+  vector<size_t> rows(width, 0), joined;
+  vector<bool> bound(variables.size(), false);
+  for (size_t i = 0; i < patterns.size() && !rows.empty(); i++) {
+    const Pattern& pattern = patterns[i];
+    // Only the last pattern can stop once enough rows have been found
+    size_t maxRows = i + 1 < patterns.size() ? SIZE_MAX : (size_t)std::min<uint64_t>(offset + limit, SIZE_MAX);
+
+    // Merge on the join variable if there is a single one, bound in the same position
+    int joinVariable = -1, joinPositions = 0;
+    TripleComponentRole joinRole = SUBJECT;
+    for (int position = 0; position < 3; position++) {
+      int variable = pattern.terms[position].variable;
+      if (variable >= 0 && bound[variable])
+        joinVariable = variable, joinRole = (TripleComponentRole)position, joinPositions++;
+    }
+    joined.clear();
+    if (!(joinPositions == 1 && variableRoles[joinVariable] == joinRole &&
+          pattern.estimate <= MERGE_JOIN_FACTOR * (rows.size() / width) &&
+          MergeJoin(pattern, joinVariable, joinRole, rows, joined, maxRows)))
+      BindJoin(pattern, rows, joined, maxRows);
+    rows.swap(joined);
+
+    // Mark the variables of the pattern as bound
+    for (int position = 0; position < 3; position++)
+      if (pattern.terms[position].variable >= 0)
+        bound[pattern.terms[position].variable] = true;
+  }
+
+  // Decode the requested rows
+  const size_t rowCount = rows.size() / width;
+  map<size_t, string> decoded[3];
+  size_t count = 0;
+  for (size_t row = offset; row < rowCount && count < limit; row++, count++) {
+    for (size_t variable = 0; variable < variables.size(); variable++) {
+      size_t id = rows[row * width + variable];
+      TripleComponentRole role = variableRoles[variable];
+      map<size_t, string>::const_iterator term = decoded[role].find(id);
+      if (term == decoded[role].end())
+        term = decoded[role].insert(make_pair(id, termCache->Decode(dict, id, role))).first;
+      bindings.push_back(term->second);
+    }
+  }
+  return count;
+}
+
+// Orders the patterns such that selective and connected patterns come first.
+void BasicGraphPattern::OrderPatterns() {
+  vector<Pattern> remaining(patterns), ordered;
+  vector<bool> bound(variables.size(), false);
+  while (!remaining.empty()) {
+    // Prefer patterns that share a bound variable, and then patterns with fewer matches
+    size_t best = 0, bestCost = 0;
+    bool bestConnected = false;
+    for (size_t i = 0; i < remaining.size(); i++) {
+      bool connected = false;
+      for (int position = 0; position < 3; position++) {
+        int variable = remaining[i].terms[position].variable;
+        connected = connected || (variable >= 0 && bound[variable]);
+      }
+      size_t cost = Cost(remaining[i], bound);
+      if (i == 0 || (connected && !bestConnected) || (connected == bestConnected && cost < bestCost))
+        best = i, bestCost = cost, bestConnected = connected;
+    }
+
+    // The position in which a variable is first bound determines its ID space
+    const Pattern& next = remaining[best];
+    for (int position = 0; position < 3; position++) {
+      int variable = next.terms[position].variable;
+      if (variable >= 0 && !bound[variable]) {
+        bound[variable] = true;
+        variableRoles[variable] = (TripleComponentRole)position;
+      }
+    }
+    ordered.push_back(next);
+    remaining.erase(remaining.begin() + best);
+  }
+  patterns.swap(ordered);
+}
+
+// Estimates the number of matches of the pattern per row in which the given variables are bound.
+// Without statistics for its predicate, this is the number of matches of the pattern on its own.
+size_t BasicGraphPattern::Cost(const Pattern& pattern, const vector<bool>& bound) const {
+  const PatternStatistics::Predicate* predicate =
+    statistics ? statistics->GetPredicate(pattern.terms[PREDICATE].id) : NULL;
+  if (!predicate)
+    return pattern.estimate;
+  // A bound subject or object matches the average number of triples per subject or object
+  const Term &subject = pattern.terms[SUBJECT], &object = pattern.terms[OBJECT];
+  bool subjectBound = subject.variable >= 0 && bound[subject.variable];
+  bool objectBound = object.variable >= 0 && bound[object.variable];
+  uint64_t cost = pattern.estimate;
+  if (subjectBound && predicate->subjects)
+    cost = std::min(cost, (predicate->triples + predicate->subjects - 1) / predicate->subjects);
+  if (objectBound && predicate->objects)
+    cost = std::min(cost, (predicate->triples + predicate->objects - 1) / predicate->objects);
+  return (size_t)cost;
+}
+
+// Joins the rows with the matches of the pattern by searching the pattern once per row.
+void BasicGraphPattern::BindJoin(const Pattern& pattern, const vector<size_t>& rows,
+                                 vector<size_t>& joined, size_t maxRows) {
+  const size_t width = Width();
+  vector<size_t> row(width);
+  for (size_t start = 0; start < rows.size() && joined.size() / width < maxRows; start += width) {
+    // Substitute the bound variables of the row into the pattern
+    size_t ids[3];
+    bool valid = true;
+    for (int position = 0; position < 3; position++) {
+      const Term& term = pattern.terms[position];
+      ids[position] = term.id;
+      if (term.variable >= 0 && rows[start + term.variable]) {
+        ids[position] = Convert(rows[start + term.variable], variableRoles[term.variable],
+                                (TripleComponentRole)position);
+        valid = valid && ids[position];
+      }
+    }
+    if (!valid)
+      continue;
+
+    // Extend the row with every match
+    TripleID tripleId(ids[0], ids[1], ids[2]);
+    IteratorTripleID* it = hdt->getTriples()->search(tripleId);
+    while (it->hasNext() && joined.size() / width < maxRows) {
+      copy(rows.begin() + start, rows.begin() + start + width, row.begin());
+      if (Bind(pattern, *it->next(), &row[0]))
+        joined.insert(joined.end(), row.begin(), row.end());
+    }
+    delete it;
+  }
+}
+
+// Joins the rows with the matches of the pattern by merging both sorted on the join variable.
+// Returns false if the matches of the pattern are not sorted on that variable.
+bool BasicGraphPattern::MergeJoin(const Pattern& pattern, int variable, TripleComponentRole role,
+                                  vector<size_t>& rows, vector<size_t>& joined, size_t maxRows) {
+  TripleID tripleId(pattern.terms[0].id, pattern.terms[1].id, pattern.terms[2].id);
+  IteratorTripleID* it = hdt->getTriples()->search(tripleId);
+  if (!it->isSorted(role)) {
+    delete it;
+    return false;
+  }
+
+  // Sort the rows on the join variable
+  const size_t width = Width(), rowCount = rows.size() / width;
+  vector<pair<size_t, size_t> > keys(rowCount);
+  for (size_t i = 0; i < rowCount; i++)
+    keys[i] = make_pair(rows[i * width + variable], i * width);
+  sort(keys.begin(), keys.end());
+
+  // Walk through the rows and matches in the order of the join variable
+  vector<size_t> row(width);
+  size_t first = 0, previous = 0;
+  bool sorted = true;
+  while (sorted && first < rowCount && joined.size() / width < maxRows && it->hasNext()) {
+    TripleID& triple = *it->next();
+    size_t key = getComponent(triple, role);
+    sorted = key >= previous;
+    previous = key;
+    while (first < rowCount && keys[first].first < key)
+      first++;
+    for (size_t i = first; i < rowCount && keys[i].first == key && joined.size() / width < maxRows; i++) {
+      copy(rows.begin() + keys[i].second, rows.begin() + keys[i].second + width, row.begin());
+      if (Bind(pattern, triple, &row[0]))
+        joined.insert(joined.end(), row.begin(), row.end());
+    }
+  }
+  delete it;
+
+  // Let the caller fall back to another join if the order turned out to be different
+  if (!sorted)
+    joined.clear();
+  return sorted;
+}
+
+// Extends the row with the bindings of a matching triple, returning false if they conflict.
+bool BasicGraphPattern::Bind(const Pattern& pattern, TripleID& triple, size_t* row) {
+  for (int position = 0; position < 3; position++) {
+    int variable = pattern.terms[position].variable;
+    if (variable >= 0) {
+      size_t id = Convert(getComponent(triple, position), (TripleComponentRole)position,
+                          variableRoles[variable]);
+      if (!id || (row[variable] && row[variable] != id))
+        return false;
+      row[variable] = id;
+    }
+  }
+  return true;
+}
+
+// Converts an ID from one position into another, returning 0 if it does not occur there.
+size_t BasicGraphPattern::Convert(size_t id, TripleComponentRole from, TripleComponentRole to) {
+  if (from == to)
+    return id;
+  // Subjects and objects share the IDs of terms that occur in both positions
+  if (from != PREDICATE && to != PREDICATE)
+    return id <= shared ? id : 0;
+  // Other conversions go through the string representation
+  map<size_t, size_t>& cache = conversions[from][to];
+  map<size_t, size_t>::const_iterator conversion = cache.find(id);
+  if (conversion != cache.end())
+    return conversion->second;
+  return cache[id] = dict->stringToId(dict->idToString(id, from), to);
+}
@@ -0,0 +1,72 @@
+#ifndef BASICGRAPHPATTERN_H
+#define BASICGRAPHPATTERN_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <HDTManager.hpp>
+
+class TermCache;
+class PatternStatistics;
+
+// Evaluates a basic graph pattern over an HDT document,
+// joining triple patterns in dictionary ID space and only decoding the final bindings
+class BasicGraphPattern {
+ public:
+  // Creates a basic graph pattern from a list of subject, predicate, and object strings,
+  // in which strings starting with a question mark are variables;
+  // statistics, if available, make the estimates exact and refine the join order
+  BasicGraphPattern(hdt::HDT* hdt, TermCache* termCache, const std::vector<std::string>& components,
+                    const PatternStatistics* statistics = NULL);
+
+  // Evaluates the pattern, decoding the bindings from offset to offset + limit
+  // into rows that have one term for every variable, and returns the number of rows
+  size_t Evaluate(uint64_t offset, uint64_t limit, std::vector<std::string>& bindings);
+
+  // Accessors
+  const std::vector<std::string>& GetVariables() const { return variables; }
+
+ private:
+  // A subject, predicate, or object of a triple pattern,
+  // which is either a dictionary ID (0 if unbound) or a variable
+  struct Term {
+    size_t id;
+    int variable;
+  };
+  struct Pattern {
+    Term terms[3];
+    size_t estimate;
+  };
+
+  hdt::HDT* hdt;
+  hdt::Dictionary* dict;
+  TermCache* termCache;
+  const PatternStatistics* statistics;
+  size_t shared;
+  std::vector<Pattern> patterns;
+  std::vector<std::string> variables;
+  // The position in which each variable is first bound, determining its ID space
+  std::vector<hdt::TripleComponentRole> variableRoles;
+  // Cached conversions of IDs between positions
+  std::map<size_t, size_t> conversions[3][3];
+  bool hasMatches;
+
+  // Returns the number of IDs in a row of bindings
+  size_t Width() const { return variables.empty() ? 1 : variables.size(); }
+
+  // Orders the patterns such that selective and connected patterns come first
+  void OrderPatterns();
+  // Estimates the number of matches of the pattern per row in which the given variables are bound
+  size_t Cost(const Pattern& pattern, const std::vector<bool>& bound) const;
+  // Joins the rows with the matches of the pattern
+  void BindJoin(const Pattern& pattern, const std::vector<size_t>& rows,
+                std::vector<size_t>& joined, size_t maxRows);
+  bool MergeJoin(const Pattern& pattern, int variable, hdt::TripleComponentRole role,
+                 std::vector<size_t>& rows, std::vector<size_t>& joined, size_t maxRows);
+  // Extends the row with the bindings of a matching triple, returning false if they conflict
+  bool Bind(const Pattern& pattern, hdt::TripleID& triple, size_t* row);
+  // Converts an ID from one position into another, returning 0 if it does not occur there
+  size_t Convert(size_t id, hdt::TripleComponentRole from, hdt::TripleComponentRole to);
+};
+
+#endif
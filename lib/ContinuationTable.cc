@@ -0,0 +1,74 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <HDTManager.hpp>
+#include "ContinuationTable.h"
+
+using namespace std;
+using namespace hdt;
+
+// Parks the iterator, which is positioned at the given match of the pattern,
+// and returns a token to resume from it.
+string ContinuationTable::Park(const TripleID& pattern, uint64_t position, IteratorTripleID* it,
+                               const shared_ptr<HDT>& hdt) {
+  lock_guard<mutex> lock(entriesMutex);
+  // Without room for iterators, resuming falls back to skipping
+  if (closed || !capacity) {
+    delete it;
+    return ToToken(pattern, position);
+  }
+  // Evict the oldest iterator if the table is full
+  if (entries.size() >= capacity) {
+    delete entries.begin()->second.it;
+    entries.erase(entries.begin());
+  }
+  uint64_t id = nextId++;
+  Entry entry = { pattern, position, it, hdt };
+  entries[id] = entry;
+  return ToToken(pattern, position, id);
+}
+
+// Takes the parked iterator for the pattern and position out of the table, together with its HDT,
+// returning NULL if it is no longer available.
+IteratorTripleID* ContinuationTable::Take(uint64_t id, const TripleID& pattern, uint64_t position,
+                                          shared_ptr<HDT>& hdt) {
+  lock_guard<mutex> lock(entriesMutex);
+  map<uint64_t, Entry>::iterator entry = entries.find(id);
+  if (entry == entries.end() || entry->second.position != position ||
+      entry->second.pattern.getSubject()   != pattern.getSubject()   ||
+      entry->second.pattern.getPredicate() != pattern.getPredicate() ||
+      entry->second.pattern.getObject()    != pattern.getObject())
+    return NULL;
+  IteratorTripleID* it = entry->second.it;
+  hdt = entry->second.hdt;
+  entries.erase(entry);
+  return it;
+}
+
+// Deletes all parked iterators and disables further parking.
+void ContinuationTable::Close() {
+  lock_guard<mutex> lock(entriesMutex);
+  for (map<uint64_t, Entry>::iterator entry = entries.begin(); entry != entries.end(); entry++)
+    delete entry->second.it;
+  entries.clear();
+  closed = true;
+}
+
+// Creates a token for the given position without a parked iterator.
+string ContinuationTable::ToToken(const TripleID& pattern, uint64_t position, uint64_t id) {
+  char token[128];
+  snprintf(token, sizeof(token), "%" PRIx64 ".%" PRIx64 ".%" PRIx64 ".%" PRIx64 ".%" PRIx64,
+           (uint64_t)pattern.getSubject(), (uint64_t)pattern.getPredicate(), (uint64_t)pattern.getObject(),
+           position, id);
+  return token;
+}
+
+// Parses the token, returning false if it is invalid.
+bool ContinuationTable::FromToken(const string& token, TripleID& pattern, uint64_t& position, uint64_t& id) {
+  uint64_t subject, predicate, object;
+  int length = 0;
+  if (sscanf(token.c_str(), "%" SCNx64 ".%" SCNx64 ".%" SCNx64 ".%" SCNx64 ".%" SCNx64 "%n",
+             &subject, &predicate, &object, &position, &id, &length) != 5 || length != (int)token.size())
+    return false;
+  pattern = TripleID(subject, predicate, object);
+  return true;
+}
@@ -0,0 +1,51 @@
+#ifndef CONTINUATIONTABLE_H
+#define CONTINUATIONTABLE_H
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <HDTManager.hpp>
+
+// A bounded table of iterators that were left open after a page of results,
+// such that the next page of the same pattern can resume without skipping all previous matches.
+// Continuation tokens identify a pattern, a position in its matches, and optionally a parked iterator.
+class ContinuationTable {
+ public:
+  ContinuationTable(size_t capacity) : capacity(capacity), nextId(1), closed(false) { }
+  ~ContinuationTable() { Close(); }
+
+  // Parks the iterator, which is positioned at the given match of the pattern,
+  // and returns a token to resume from it; the table takes ownership of the iterator
+  // and keeps the HDT it iterates over alive while it is parked
+  std::string Park(const hdt::TripleID& pattern, uint64_t position, hdt::IteratorTripleID* it,
+                   const std::shared_ptr<hdt::HDT>& hdt);
+  // Takes the parked iterator for the pattern and position out of the table, together with its HDT,
+  // returning NULL if it is no longer available
+  hdt::IteratorTripleID* Take(uint64_t id, const hdt::TripleID& pattern, uint64_t position,
+                              std::shared_ptr<hdt::HDT>& hdt);
+  // Deletes all parked iterators and disables further parking
+  void Close();
+
+  // Creates a token for the given position without a parked iterator
+  static std::string ToToken(const hdt::TripleID& pattern, uint64_t position, uint64_t id = 0);
+  // Parses the token, returning false if it is invalid
+  static bool FromToken(const std::string& token, hdt::TripleID& pattern, uint64_t& position, uint64_t& id);
+
+ private:
+  struct Entry {
+    hdt::TripleID pattern;
+    uint64_t position;
+    hdt::IteratorTripleID* it;
+    std::shared_ptr<hdt::HDT> hdt;
+  };
+
+  std::mutex entriesMutex;
+  std::map<uint64_t, Entry> entries;
+  const size_t capacity;
+  uint64_t nextId;
+  bool closed;
+};
+
+#endif
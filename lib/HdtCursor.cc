@@ -0,0 +1,188 @@
+#include <node.h>
+#include <nan.h>
+#include <assert.h>
+#include <algorithm>
+#include <memory>
+#include <HDTManager.hpp>
+#include "HdtCursor.h"
+#include "PerIsolate.h"
+
+using namespace v8;
+using namespace hdt;
+
+const uint32_t SELF = 0;
+
+
+
+/******** Construction and destruction ********/
+
+
+// Creates a new cursor over the given iterator, which it takes ownership of.
+// The cursor keeps the HDT alive until it is closed.
+HdtCursor::HdtCursor(const Local<Object>& handle, const Local<Object>& documentHandle,
+                     HdtDocument* document, shared_ptr<HDT> hdt, IteratorTripleID* iterator, uint64_t limit)
+  : document(document), hdt(hdt), iterator(iterator), remaining(limit), reading(false), closed(false) {
+  this->Wrap(handle);
+  // Keep the document alive for as long as the cursor exists
+  this->documentHandle.Reset(documentHandle);
+}
+
+// Deletes the cursor.
+HdtCursor::~HdtCursor() {
+  Destroy();
+  documentHandle.Reset();
+}
+
+// Destroys the cursor, releasing its iterator and HDT.
+void HdtCursor::Destroy() {
+  if (iterator) {
+    delete iterator;
+    iterator = NULL;
+  }
+  hdt.reset();
+}
+
+// Constructs a JavaScript wrapper for a cursor.
+NAN_METHOD(HdtCursor::New) {
+  assert(info.IsConstructCall());
+  info.GetReturnValue().Set(info.This());
+}
+
+// Returns the constructor of HdtCursor.
+// Every worker thread has a constructor of its own.
+PerIsolate<Function> cursorConstructors;
+const Nan::Persistent<Function>& HdtCursor::GetConstructor() {
+  Nan::Persistent<Function>& cursorConstructor = cursorConstructors.Get();
+  if (cursorConstructor.IsEmpty()) {
+    // Create constructor template
+    Local<FunctionTemplate> constructorTemplate = Nan::New<FunctionTemplate>(New);
+    constructorTemplate->SetClassName(Nan::New("HdtCursor").ToLocalChecked());
+    constructorTemplate->InstanceTemplate()->SetInternalFieldCount(1);
+    // Create prototype
+    Nan::SetPrototypeMethod(constructorTemplate, "_next", Next);
+    Nan::SetPrototypeMethod(constructorTemplate, "_close", Close);
+    Nan::SetAccessor(constructorTemplate->PrototypeTemplate(),
+                     Nan::New("closed").ToLocalChecked(), Closed);
+    // Set constructor
+    cursorConstructor.Reset(Nan::GetFunction(constructorTemplate).ToLocalChecked());
+  }
+  return cursorConstructor;
+}
+
+// Marks the start of a read, returning false if the cursor cannot be read.
+bool HdtCursor::BeginRead() {
+  if (reading || closed || !iterator || !remaining)
+    return false;
+  reading = true;
+  return true;
+}
+
+// Marks the end of a read of the given number of triples.
+void HdtCursor::EndRead(uint32_t count) {
+  reading = false;
+  remaining -= std::min<uint64_t>(count, remaining);
+  // Finish a close that was requested during the read
+  if (closed)
+    Destroy();
+}
+
+
+
+/******** HdtCursor#_next ********/
+
+class NextTriplesWorker : public Nan::AsyncWorker {
+  HdtCursor* cursor;
+  shared_ptr<HDT> hdt;
+  // JavaScript function arguments
+  uint32_t batchSize;
+  // Callback return values
+  TriplePage page;
+  bool done;
+
+public:
+  NextTriplesWorker(HdtCursor* cursor, uint32_t batchSize, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), cursor(cursor), hdt(cursor->GetHDT()), batchSize(batchSize), done(false) {
+    SaveToPersistent(SELF, self);
+  };
+
+  ~NextTriplesWorker() { cursor->EndRead(page.triples.size()); }
+
+  void Execute() {
+    try {
+      // Read the next batch, without exceeding the cursor's limit
+      IteratorTripleID* it = cursor->GetIterator();
+      uint64_t limit = std::min<uint64_t>(batchSize, cursor->GetRemaining());
+      page.Read(it, hdt->getDictionary(), cursor->GetTermCache(), limit);
+      done = !it->hasNext() || page.triples.size() == cursor->GetRemaining();
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    // Send the JavaScript array and whether the cursor is exhausted through the callback
+    const unsigned argc = 3;
+    Local<Value> argv[argc] = { Nan::Null(), page.ToArray(), Nan::New<Boolean>(done) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Reads the next batch of triples from the cursor.
+// JavaScript signature: HdtCursor#_next(batchSize, callback)
+NAN_METHOD(HdtCursor::Next) {
+  assert(info.Length() == 2);
+  HdtCursor* cursor = Unwrap<HdtCursor>(info.This());
+  const Local<Function> callback = info[1].As<Function>();
+
+  // Only one read at a time can access the iterator
+  if (cursor->reading) {
+    Local<Value> argv[] = { Exception::Error(Nan::New("The cursor is already being read").ToLocalChecked()) };
+    Nan::Call(callback, info.This(), 1, argv);
+  }
+  // A closed or exhausted cursor has no more triples
+  else if (cursor->closed || !cursor->document->GetHDT() || !cursor->BeginRead()) {
+    // Release the HDT of a cursor whose document was closed
+    if (!cursor->closed && !cursor->document->GetHDT()) {
+      cursor->closed = true;
+      cursor->Destroy();
+    }
+    const unsigned argc = 3;
+    Local<Value> argv[argc] = { Nan::Null(), Nan::New<Array>(0), Nan::True() };
+    Nan::Call(callback, info.This(), argc, argv);
+  }
+  else {
+    // Cursors read long streams of triples, so they give way to other searches
+    cursor->document->QueueWorker(new NextTriplesWorker(cursor,
+      Nan::To<uint32_t>(info[0]).FromJust(), new Nan::Callback(callback), info.This()), LowPriority);
+  }
+}
+
+
+
+/******** HdtCursor#_close ********/
+
+// Closes the cursor, releasing its iterator once no read is pending.
+// JavaScript signature: HdtCursor#_close()
+NAN_METHOD(HdtCursor::Close) {
+  HdtCursor* cursor = Unwrap<HdtCursor>(info.This());
+  cursor->closed = true;
+  if (!cursor->reading)
+    cursor->Destroy();
+}
+
+
+
+/******** HdtCursor#closed ********/
+
+
+// Gets a boolean indicating whether the cursor or its document is closed.
+NAN_PROPERTY_GETTER(HdtCursor::Closed) {
+  HdtCursor* cursor = Unwrap<HdtCursor>(info.This());
+  info.GetReturnValue().Set(Nan::New<Boolean>(cursor->closed || !cursor->document->GetHDT()));
+}
@@ -0,0 +1,49 @@
+#ifndef HDTCURSOR_H
+#define HDTCURSOR_H
+
+#include <node.h>
+#include <nan.h>
+#include <memory>
+#include <HDTManager.hpp>
+#include "HdtDocument.h"
+
+class HdtCursor : public node::ObjectWrap {
+ public:
+  HdtCursor(const v8::Local<v8::Object>& handle, const v8::Local<v8::Object>& documentHandle,
+            HdtDocument* document, std::shared_ptr<hdt::HDT> hdt,
+            hdt::IteratorTripleID* iterator, uint64_t limit);
+
+  static const Nan::Persistent<v8::Function>& GetConstructor();
+
+  // Accessors
+  std::shared_ptr<hdt::HDT> GetHDT() { return hdt; }
+  TermCache* GetTermCache() { return document->GetTermCache(); }
+  hdt::IteratorTripleID* GetIterator() { return iterator; }
+  uint64_t GetRemaining() { return remaining; }
+
+  // Marks the start and end of a read, during which the iterator cannot be destroyed
+  bool BeginRead();
+  void EndRead(uint32_t count);
+
+ private:
+  HdtDocument* document;
+  Nan::Persistent<v8::Object> documentHandle;
+  std::shared_ptr<hdt::HDT> hdt;
+  hdt::IteratorTripleID* iterator;
+  uint64_t remaining;
+  bool reading, closed;
+
+  // Construction and destruction
+  ~HdtCursor();
+  void Destroy();
+  static NAN_METHOD(New);
+
+  // HdtCursor#_next(batchSize, callback, self)
+  static NAN_METHOD(Next);
+  // HdtCursor#_close()
+  static NAN_METHOD(Close);
+  // HdtCursor#closed
+  static NAN_PROPERTY_GETTER(Closed);
+};
+
+#endif
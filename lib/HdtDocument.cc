@@ -1,42 +1,177 @@
 #include <node.h>
 #include <nan.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <HDTEnums.hpp>
 #include <HDTManager.hpp>
 #include <HDTVocabulary.hpp>
 #include <LiteralDictionary.hpp>
 #include "HdtDocument.h"
+#include "HdtCursor.h"
+#include "BasicGraphPattern.h"
+#include "ContinuationTable.h"
+#include "PerIsolate.h"
+#include "../deps/libhdt/src/header/PlainHeader.hpp"
 #include "../deps/libhdt/src/util/fileUtil.hpp"
 
 using namespace v8;
 using namespace hdt;
 
 const uint32_t SELF = 0;
+const char* const CLOSED_ERROR = "The HDT document cannot be accessed because it is closed";
+const char* const ABORTED_ERROR = "The query was aborted";
+// Default number of bytes of decoded terms to cache per document
+const size_t DEFAULT_TERM_CACHE_SIZE = 32 * 1024 * 1024;
+// Default number of bytes of search results to cache per document
+const size_t DEFAULT_PAGE_CACHE_SIZE = 0;
+// Minimum number of bytes per shard of the page cache, which is the size limit of a single page,
+// and maximum number of shards; small page caches thus have fewer shards
+const size_t PAGE_CACHE_SHARD_SIZE = 4 * 1024 * 1024;
+const size_t MAX_PAGE_CACHE_SHARDS = 16;
+// Maximum number of iterators per document that are kept open for continuation tokens
+const size_t MAX_PARKED_ITERATORS = 64;
+// Default and maximum number of query threads per document; 0 uses libuv's thread pool
+const size_t DEFAULT_THREAD_COUNT = 0;
+const size_t MAX_THREAD_COUNT = 256;
+// Maximum number of triples of a page that is searched before long scans
+const uint64_t SMALL_PAGE_SIZE = 1024;
+// Number of triples that an export thread encodes at once
+const uint64_t EXPORT_CHUNK_SIZE = 64 * 1024;
+// Number of bytes of encoded terms that every export thread caches
+const size_t EXPORT_TERM_CACHE_SIZE = 4 * 1024 * 1024;
+// Number of bytes of prefix ranges that every document caches for autocompletion
+const size_t PREFIX_CACHE_SIZE = 256 * 1024;
+// Maximum number of bytes that are copied at once when changing the header
+const uint64_t COPY_CHUNK_SIZE = 16 * 1024 * 1024;
 
 
 
 /******** Construction and destruction ********/
 
 
-// Creates a new HDT document.
-HdtDocument::HdtDocument(const Local<Object>& handle, HDT* hdt) : hdt(hdt), features(0) {
+// Creates a new HDT document, which takes ownership of the mapped HDT,
+// or shares it with the other documents of the registry.
+HdtDocument::HdtDocument(const Local<Object>& handle, const string& filename,
+                         const shared_ptr<MappedHdt>& mapped, bool shared,
+                         size_t termCacheSize, size_t pageCacheSize, size_t threadCount)
+  : filename(filename), termCache(termCacheSize, &metrics),
+    pageCache(pageCacheSize,
+              std::max((size_t)1, std::min(pageCacheSize / PAGE_CACHE_SHARD_SIZE, MAX_PAGE_CACHE_SHARDS))),
+    prefixCache(PREFIX_CACHE_SIZE), continuations(MAX_PARKED_ITERATORS),
+    executor(threadCount ? new QueryExecutor(threadCount) : NULL),
+    statistics(mapped->statistics.get()), literalIndex(mapped->literalIndex.get()), features(0), shared(shared) {
   this->Wrap(handle);
+  // A shared mapping stays alive while this document or any of its workers still holds the HDT or memory
+  if (shared) {
+    this->mapped = mapped;
+    hdt = shared_ptr<HDT>(mapped, mapped->hdt.get());
+  }
+  else {
+    hdt.reset(mapped->hdt.release());
+    mapped->statistics.release();
+    mapped->literalIndex.release();
+  }
   // Determine supported features
   if (hdt->getDictionary()->getType() == HDTVocabulary::DICTIONARY_TYPE_LITERAL)
     features |= LiteralSearch;
 }
 
 // Deletes the HDT document.
-HdtDocument::~HdtDocument() { Destroy(); }
+HdtDocument::~HdtDocument() {
+  Destroy();
+  if (!shared) {
+    delete statistics.load();
+    delete literalIndex.load();
+  }
+}
 
 // Destroys the document, disabling all further operations.
+// The HDT itself is only deleted once all pending operations have released it.
 void HdtDocument::Destroy() {
-  if (hdt) {
-    delete hdt;
-    hdt = NULL;
+  // Parked iterators are deleted before the HDT they belong to can be
+  continuations.Close();
+  hdt.reset();
+  termCache.Clear();
+  pageCache.Clear();
+  prefixCache.Clear();
+  // Stop prefetching and unlock memory; the mappings remain until running workers are done.
+  // Shared memory is only released by the last of the documents that share it.
+  if (shared) {
+    memory.reset();
+    mapped.reset();
+  }
+  else if (memory) {
+    memory->Release();
+  }
+}
+
+// Returns the document's own mappings of its files, which are only created once residency is controlled
+// or reported, such that documents that do neither do not map their files twice.
+shared_ptr<HdtMemory> HdtDocument::GetMemory() {
+  if (!memory && hdt) {
+    if (shared) {
+      memory = shared_ptr<HdtMemory>(mapped, mapped->GetMemory(filename));
+    }
+    else {
+      memory.reset(new HdtMemory());
+      memory->Open(filename, hdt.get());
+    }
+  }
+  return memory;
+}
+
+// Queues the worker on the document's own threads, or on libuv's thread pool if it has none.
+void HdtDocument::QueueWorker(Nan::AsyncWorker* worker, QueryPriority priority) {
+  if (executor)
+    executor->Queue(worker, priority);
+  else
+    Nan::AsyncQueueWorker(worker);
+}
+
+// Replaces the HDT by the same HDT with its index once that has been built in the background.
+void HdtDocument::SetIndexedHDT(HDT* indexedHdt, PatternStatistics* indexedStatistics,
+                                LiteralIndex* indexedLiterals) {
+  // A closed document has no more use for the index
+  if (!hdt) {
+    delete indexedHdt;
+    delete indexedStatistics;
+    delete indexedLiterals;
+    return;
   }
+  // Workers and parked iterators that started before keep the HDT without index alive while they use it;
+  // it has the same IDs, and is deleted once they are done
+  hdt.reset(indexedHdt);
+  if (memory)
+    memory->OpenIndex(filename);
+  if (indexedStatistics && !statistics)
+    statistics = indexedStatistics;
+  else
+    delete indexedStatistics;
+  if (indexedLiterals && !literalIndex)
+    literalIndex = indexedLiterals;
+  else
+    delete indexedLiterals;
 }
 
 // Constructs a JavaScript wrapper for an HDT document.
@@ -46,8 +181,10 @@ NAN_METHOD(HdtDocument::New) {
 }
 
 // Returns the constructor of HdtDocument.
-Nan::Persistent<Function> constructor;
+// Every worker thread has a constructor of its own.
+PerIsolate<Function> constructors;
 const Nan::Persistent<Function>& HdtDocument::GetConstructor() {
+  Nan::Persistent<Function>& constructor = constructors.Get();
   if (constructor.IsEmpty()) {
     // Create constructor template
     Local<FunctionTemplate> constructorTemplate = Nan::New<FunctionTemplate>(New);
@@ -55,165 +192,1639 @@ const Nan::Persistent<Function>& HdtDocument::GetConstructor() {
     constructorTemplate->InstanceTemplate()->SetInternalFieldCount(1);
     // Create prototype
     Nan::SetPrototypeMethod(constructorTemplate, "_searchTriples", SearchTriples);
+    Nan::SetPrototypeMethod(constructorTemplate, "_searchTriplesBatch", SearchTriplesBatch);
+    Nan::SetPrototypeMethod(constructorTemplate, "_searchTriplesCursor", SearchTriplesCursor);
+    Nan::SetPrototypeMethod(constructorTemplate, "_exportTo", ExportTo);
+    Nan::SetPrototypeMethod(constructorTemplate, "_searchTripleIds", SearchTripleIds);
+    Nan::SetPrototypeMethod(constructorTemplate, "_termsToIds", TermsToIds);
+    Nan::SetPrototypeMethod(constructorTemplate, "_idsToTerms", IdsToTerms);
+    Nan::SetPrototypeMethod(constructorTemplate, "_evaluateBGP", EvaluateBGP);
     Nan::SetPrototypeMethod(constructorTemplate, "_searchLiterals", SearchLiterals);
     Nan::SetPrototypeMethod(constructorTemplate, "_searchTerms",  SearchTerms);
     Nan::SetPrototypeMethod(constructorTemplate, "_fetchDistinctTerms", FetchDistinctTerms);
     Nan::SetPrototypeMethod(constructorTemplate, "_readHeader", ReadHeader);
     Nan::SetPrototypeMethod(constructorTemplate, "_changeHeader", ChangeHeader);
+    Nan::SetPrototypeMethod(constructorTemplate, "_cancelQuery", CancelQuery);
+    Nan::SetPrototypeMethod(constructorTemplate, "_buildIndex", BuildIndex);
+    Nan::SetPrototypeMethod(constructorTemplate, "_stats", Stats);
+    Nan::SetPrototypeMethod(constructorTemplate, "_setMemoryPolicy", SetMemoryPolicy);
+    Nan::SetPrototypeMethod(constructorTemplate, "_memory", Memory);
     Nan::SetPrototypeMethod(constructorTemplate, "_close", Close);
     Nan::SetAccessor(constructorTemplate->PrototypeTemplate(),
                      Nan::New("_features").ToLocalChecked(), Features);
+    Nan::SetAccessor(constructorTemplate->PrototypeTemplate(),
+                     Nan::New("_idRanges").ToLocalChecked(), IdRanges);
+    Nan::SetAccessor(constructorTemplate->PrototypeTemplate(),
+                     Nan::New("termCacheStats").ToLocalChecked(), TermCacheStats);
+    Nan::SetAccessor(constructorTemplate->PrototypeTemplate(),
+                     Nan::New("pageCacheStats").ToLocalChecked(), PageCacheStats);
     Nan::SetAccessor(constructorTemplate->PrototypeTemplate(),
                      Nan::New("closed").ToLocalChecked(), Closed);
     // Set constructor
     constructor.Reset(Nan::GetFunction(constructorTemplate).ToLocalChecked());
   }
-  return constructor;
+  return constructor;
+}
+
+
+
+/******** createHdtDocument ********/
+
+// Reads a nonnegative numeric option, or returns the default value if it is not set
+static size_t getSizeOption(const Local<Object>& options, const char* name, size_t defaultValue) {
+  Local<Value> value = Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+  if (!value->IsNumber())
+    return defaultValue;
+  double size = Nan::To<double>(value).FromJust();
+  return size > 0 ? (size_t)size : 0;
+}
+
+// Reads a boolean option, which is false if it is not set
+static bool getBooleanOption(const Local<Object>& options, const char* name) {
+  Local<Value> value = Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+  return Nan::To<bool>(value).FromJust();
+}
+
+// Reads a function option, or returns NULL if it is not set
+static Nan::Callback* getCallbackOption(const Local<Object>& options, const char* name) {
+  Local<Value> value = Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+  return value->IsFunction() ? new Nan::Callback(value.As<Function>()) : NULL;
+}
+
+// A step in opening a document or building its index, as reported by libhdt
+struct IndexProgress {
+  float level;
+  char stage[64];
+};
+typedef Nan::AsyncProgressQueueWorker<IndexProgress> IndexProgressWorker;
+
+// Passes the progress reported by libhdt to the JavaScript thread,
+// skipping reports that do not change the stage or the whole percentage
+class IndexProgressListener : public ProgressListener {
+  const IndexProgressWorker::ExecutionProgress& progress;
+  IndexProgress last;
+
+public:
+  IndexProgressListener(const IndexProgressWorker::ExecutionProgress& progress) : progress(progress) {
+    last.level = -1;
+    last.stage[0] = '\0';
+  }
+
+  void notifyProgress(float level, const char* section) {
+    IndexProgress current;
+    current.level = std::floor(level);
+    strncpy(current.stage, section ? section : "", sizeof(current.stage) - 1);
+    current.stage[sizeof(current.stage) - 1] = '\0';
+    if (current.level != last.level || strcmp(current.stage, last.stage)) {
+      last = current;
+      progress.Send(&current, 1);
+    }
+  }
+
+  void notifyProgress(float task, float level, const char* section) { notifyProgress(level, section); }
+};
+
+// Sends the progress reports to the callback as objects with a stage and a percentage
+static void sendProgress(Nan::Callback* progressCallback, const IndexProgress* reports, size_t count,
+                         Nan::AsyncResource* async_resource) {
+  for (size_t i = 0; i < count; i++) {
+    Local<Object> report = Nan::New<Object>();
+    Nan::Set(report, Nan::New("stage").ToLocalChecked(), Nan::New(reports[i].stage).ToLocalChecked());
+    Nan::Set(report, Nan::New("level").ToLocalChecked(), Nan::New<Number>(reports[i].level));
+    Local<Value> argv[] = { report };
+    progressCallback->Call(1, argv, async_resource);
+  }
+}
+
+// Loads data derived from the HDT, such as statistics or a literal index, from its sidecar file,
+// or computes and stores it if the file is missing or outdated and building is allowed
+template <class Sidecar>
+static Sidecar* loadSidecar(const string& filename, const char* extension, HDT* hdt, bool build) {
+  Sidecar* sidecar = new Sidecar();
+  const string sidecarFilename = filename + extension;
+  const SourceFingerprint source = SourceFingerprint::Of(filename);
+  if (!sidecar->Load(sidecarFilename, hdt, source)) {
+    if (!build) {
+      delete sidecar;
+      return NULL;
+    }
+    sidecar->Build(hdt);
+    // An unwritable sidecar only means the data is computed again next time
+    sidecar->Save(sidecarFilename, source);
+  }
+  return sidecar;
+}
+
+class CreateWorker : public IndexProgressWorker {
+  string filename;
+  shared_ptr<MappedHdt> mapped;
+  bool useStatistics, useLiteralIndex, backgroundIndex, shared;
+  size_t termCacheSize, pageCacheSize, threadCount;
+  Nan::Callback* progressCallback;
+
+public:
+  CreateWorker(const char* filename, bool useStatistics, bool useLiteralIndex, bool backgroundIndex, bool shared,
+               size_t termCacheSize, size_t pageCacheSize, size_t threadCount,
+               Nan::Callback* progressCallback, Nan::Callback *callback)
+    : IndexProgressWorker(callback), filename(filename), useStatistics(useStatistics),
+      useLiteralIndex(useLiteralIndex), backgroundIndex(backgroundIndex && !shared), shared(shared),
+      termCacheSize(termCacheSize), pageCacheSize(pageCacheSize), threadCount(threadCount),
+      progressCallback(progressCallback) { };
+
+  ~CreateWorker() { delete progressCallback; }
+
+  void Execute(const ExecutionProgress& progress) {
+    IndexProgressListener listener(progress);
+    ProgressListener* listenerOrNull = progressCallback ? &listener : NULL;
+    try {
+      // Shared documents use the mapping that a document in any thread of the process already opened
+      if (shared)
+        mapped = HdtRegistry::Acquire(GetSharedKey(), [this, listenerOrNull]() { return Open(listenerOrNull); });
+      else
+        mapped.reset(Open(listenerOrNull));
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+  }
+
+  // Maps the HDT file and loads the data derived from it
+  MappedHdt* Open(ProgressListener* listener) {
+    unique_ptr<MappedHdt> mapped(new MappedHdt());
+    // Without index, the document can be opened right away and only serves subject-based patterns quickly
+    if (backgroundIndex)
+      mapped->hdt.reset(HDTManager::mapHDT(filename.c_str(), listener));
+    else
+      mapped->hdt.reset(HDTManager::mapIndexedHDT(filename.c_str(), listener));
+    HDT* hdt = mapped->hdt.get();
+    // Statistics need the index to be computed, so they are only read if the document has none yet
+    if (useStatistics)
+      mapped->statistics.reset(loadSidecar<PatternStatistics>(filename, ".stats", hdt, !backgroundIndex));
+    // The literal index is built together with the triple index, so opening stays quick in the background
+    if (useLiteralIndex)
+      mapped->literalIndex.reset(loadSidecar<LiteralIndex>(filename, ".literals", hdt, !backgroundIndex));
+    return mapped.release();
+  }
+
+  // Returns the key of the shared mapping, which identifies the file and the data derived from it
+  string GetSharedKey() {
+    char* path = realpath(filename.c_str(), NULL);
+    string key(path ? path : filename);
+    free(path);
+    return key + (useStatistics ? "\nstatistics" : "") + (useLiteralIndex ? "\nliteralIndex" : "");
+  }
+
+  void HandleProgressCallback(const IndexProgress* reports, size_t count) {
+    Nan::HandleScope scope;
+    sendProgress(progressCallback, reports, count, async_resource);
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    // Create a new HdtDocument
+    Local<Object> newDocument = Nan::NewInstance(Nan::New(HdtDocument::GetConstructor())).ToLocalChecked();
+    new HdtDocument(newDocument, filename, mapped, shared, termCacheSize, pageCacheSize, threadCount);
+    // Send the new HdtDocument through the callback
+    const unsigned argc = 2;
+    Local<Value> argv[argc] = { Nan::Null(), newDocument };
+    callback->Call(argc, argv, async_resource);
+  }
+};
+
+// Creates a new instance of HdtDocument.
+// JavaScript signature: createHdtDocument(filename, options, callback)
+NAN_METHOD(HdtDocument::Create) {
+  assert(info.Length() == 3);
+  const Local<Object> options = Nan::To<Object>(info[1]).ToLocalChecked();
+  Nan::AsyncQueueWorker(new CreateWorker(*Nan::Utf8String(info[0]),
+    getBooleanOption(options, "statistics"),
+    getBooleanOption(options, "literalIndex"),
+    getBooleanOption(options, "backgroundIndex"),
+    getBooleanOption(options, "shared"),
+    getSizeOption(options, "termCacheSize", DEFAULT_TERM_CACHE_SIZE),
+    getSizeOption(options, "pageCacheSize", DEFAULT_PAGE_CACHE_SIZE),
+    std::min(getSizeOption(options, "threads", DEFAULT_THREAD_COUNT), MAX_THREAD_COUNT),
+    getCallbackOption(options, "onProgress"),
+    new Nan::Callback(info[2].As<Function>())));
+}
+
+
+
+/******** generateHdtDocument ********/
+
+class GenerateWorker : public IndexProgressWorker {
+  string inputFile, outputFile, baseIri;
+  bool lowMemory;
+  Nan::Callback* progressCallback;
+
+public:
+  GenerateWorker(const char* inputFile, const char* outputFile, const char* baseIri, bool lowMemory,
+                 Nan::Callback* progressCallback, Nan::Callback* callback)
+    : IndexProgressWorker(callback), inputFile(inputFile), outputFile(outputFile), baseIri(baseIri),
+      lowMemory(lowMemory), progressCallback(progressCallback) { };
+
+  ~GenerateWorker() { delete progressCallback; }
+
+  void Execute(const ExecutionProgress& progress) {
+    IndexProgressListener listener(progress);
+    ProgressListener* listenerOrNull = progressCallback ? &listener : NULL;
+    HDT* hdt = NULL;
+    try {
+      HDTSpecification spec;
+      // The two-pass loader reads the input twice, such that it does not keep all triples in memory
+      if (lowMemory)
+        spec.setOptions("loader.type=two-pass");
+      hdt = HDTManager::generateHDT(inputFile.c_str(), baseIri.c_str(), NTRIPLES, spec, listenerOrNull);
+      hdt->saveToHDT(outputFile.c_str(), listenerOrNull);
+    }
+    // Parse errors are not runtime errors
+    catch (const exception& error) { SetErrorMessage(error.what()); }
+    delete hdt;
+  }
+
+  void HandleProgressCallback(const IndexProgress* reports, size_t count) {
+    Nan::HandleScope scope;
+    sendProgress(progressCallback, reports, count, async_resource);
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    const unsigned argc = 1;
+    Local<Value> argv[argc] = { Nan::Null() };
+    callback->Call(argc, argv, async_resource);
+  }
+};
+
+// Generates an HDT file from an N-Triples file.
+// JavaScript signature: generateHdtDocument(inputFile, outputFile, baseIri, lowMemory, progressCallback, callback)
+NAN_METHOD(HdtDocument::Generate) {
+  assert(info.Length() == 6);
+  Nan::AsyncQueueWorker(new GenerateWorker(*Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]),
+    *Nan::Utf8String(info[2]), Nan::To<bool>(info[3]).FromJust(),
+    info[4]->IsFunction() ? new Nan::Callback(info[4].As<Function>()) : NULL,
+    new Nan::Callback(info[5].As<Function>())));
+}
+
+
+
+/******** HdtDocument#_buildIndex ********/
+
+class BuildIndexWorker : public IndexProgressWorker {
+  HdtDocument* document;
+  // JavaScript function arguments
+  string filename;
+  bool useStatistics, useLiteralIndex;
+  Nan::Callback* progressCallback;
+  // Callback return values
+  HDT* hdt;
+  PatternStatistics* statistics;
+  LiteralIndex* literalIndex;
+
+public:
+  BuildIndexWorker(HdtDocument* document, const char* filename, bool useStatistics, bool useLiteralIndex,
+                   Nan::Callback* progressCallback, Nan::Callback* callback, Local<Object> self)
+    : IndexProgressWorker(callback), document(document), filename(filename),
+      useStatistics(useStatistics), useLiteralIndex(useLiteralIndex),
+      progressCallback(progressCallback), hdt(NULL), statistics(NULL), literalIndex(NULL) {
+    SaveToPersistent(SELF, self);
+  };
+
+  ~BuildIndexWorker() { delete progressCallback; }
+
+  void Execute(const ExecutionProgress& progress) {
+    IndexProgressListener listener(progress);
+    try {
+      // Map the file again, this time with an index, which libhdt either loads or generates and saves
+      hdt = HDTManager::mapIndexedHDT(filename.c_str(), progressCallback ? &listener : NULL);
+      if (useStatistics)
+        statistics = loadSidecar<PatternStatistics>(filename, ".stats", hdt, true);
+      if (useLiteralIndex)
+        literalIndex = loadSidecar<LiteralIndex>(filename, ".literals", hdt, true);
+    }
+    catch (const runtime_error error) {
+      delete hdt, hdt = NULL;
+      delete statistics, statistics = NULL;
+      delete literalIndex, literalIndex = NULL;
+      SetErrorMessage(error.what());
+    }
+  }
+
+  void HandleProgressCallback(const IndexProgress* reports, size_t count) {
+    Nan::HandleScope scope;
+    sendProgress(progressCallback, reports, count, async_resource);
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    // Serve all further queries from the indexed HDT
+    document->SetIndexedHDT(hdt, statistics, literalIndex);
+    const unsigned argc = 1;
+    Local<Value> argv[argc] = { Nan::Null() };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Builds or loads the index of the document on a separate thread,
+// and replaces the document's HDT by the indexed one when done.
+// JavaScript signature: HdtDocument#_buildIndex(filename, statistics, literalIndex, progressCallback, callback)
+NAN_METHOD(HdtDocument::BuildIndex) {
+  assert(info.Length() == 5);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  // Documents that already have statistics or a literal index do not need new ones
+  bool useStatistics = Nan::To<bool>(info[1]).FromJust() && !document->GetStatistics();
+  bool useLiteralIndex = Nan::To<bool>(info[2]).FromJust() && !document->GetLiteralIndex();
+  Nan::Callback* progressCallback = info[3]->IsFunction() ? new Nan::Callback(info[3].As<Function>()) : NULL;
+  if (!document->indexer)
+    document->indexer.reset(new QueryExecutor(1));
+  document->indexer->Queue(new BuildIndexWorker(document, *Nan::Utf8String(info[0]), useStatistics,
+    useLiteralIndex, progressCallback, new Nan::Callback(info[4].As<Function>()), info.This()), LowPriority);
+}
+
+
+
+/******** HdtDocument#_searchTriples ********/
+
+// Converts a JavaScript number into a 64-bit count, offset, or limit
+static uint64_t toUint64(const Local<Value>& value) {
+  return (uint64_t)std::min(9007199254740991.0, std::max(0.0, Nan::To<double>(value).FromJust()));
+}
+
+// Returns the priority of a search for the given number of triples,
+// such that counts go first and small pages go before long scans
+static QueryPriority toPagePriority(uint64_t limit) {
+  return !limit ? HighPriority : limit <= SMALL_PAGE_SIZE ? NormalPriority : LowPriority;
+}
+
+// Returns the highest ID of the dictionary in the given position
+static size_t getMaxId(Dictionary* dict, TripleComponentRole position) {
+  switch (position) {
+  case SUBJECT:   return dict->getMaxSubjectID();
+  case PREDICATE: return dict->getMaxPredicateID();
+  default:        return dict->getMaxObjectID();
+  }
+}
+
+static Local<Array> toStringArray(const vector<string>& strings);
+static Local<Uint32Array> toUint32Array(const vector<uint32_t>& values);
+static Local<Object> toStatsObject(const LruCacheStats& stats);
+
+// Converts the triple pattern into IDs.
+// Returns false if any of the components does not occur in the dictionary.
+static bool toTripleID(Dictionary* dict, const string& subject, const string& predicate,
+                       string& object, TripleID& tripleId) {
+  TripleString triple(subject, predicate, toHdtLiteral(object));
+  dict->tripleStringtoTripleID(triple, tripleId);
+  return !((subject[0]   && !tripleId.getSubject())   ||
+           (predicate[0] && !tripleId.getPredicate()) ||
+           (object[0]    && !tripleId.getObject()));
+}
+
+// Advances the iterator by the given offset.
+// A nonzero offset remains if the iterator ran out of triples or the query was stopped.
+static void skipTriples(IteratorTripleID* it, uint64_t& offset, QueryControl* control = NULL) {
+  if (it->canGoTo())
+    try { it->skip(offset), offset = 0; }
+    catch (const runtime_error error) { /* invalid offset */ }
+  else
+    while (offset && it->hasNext() && !(control && control->ShouldStop())) it->next(), offset--;
+}
+
+// Determines the number of matches of the iterator's pattern,
+// using the statistics for an exact count if the iterator only has an estimate
+static void countMatches(IteratorTripleID* it, const PatternStatistics* statistics, const TripleID& pattern,
+                         uint64_t& count, bool& isExact) {
+  count = it->estimatedNumResults();
+  isExact = it->numResultEstimation() == EXACT;
+  if (!isExact && statistics)
+    isExact = statistics->Count(pattern, count);
+}
+
+// Reads the page of matches of the pattern at the given offset into a new result.
+// If an iterator is passed, it is assumed to be at that offset already;
+// otherwise, a new iterator is created, which the caller must delete.
+// If the query control stops the query, the result only contains the triples read so far.
+static shared_ptr<SearchTriplesResult> readPage(HDT* hdt, TermCache* termCache,
+                                                const PatternStatistics* statistics, TripleID& tripleId,
+                                                uint64_t offset, uint64_t limit, bool columnar,
+                                                IteratorTripleID*& it, QueryControl* control,
+                                                OperationMetrics& metrics) {
+  shared_ptr<SearchTriplesResult> result(new SearchTriplesResult());
+  // Estimate the total number of triples and go to the right offset
+  if (it)
+    offset = 0;
+  else
+    it = hdt->getTriples()->search(tripleId);
+  countMatches(it, statistics, tripleId, result->totalCount, result->hasExactCount);
+  // Queries can have waited past their deadline before starting
+  if (control && control->Check())
+    return result;
+  {
+    MetricsTimer timer(metrics, SkipPhase);
+    const uint64_t skipped = offset;
+    const bool canGoTo = it->canGoTo();
+    skipTriples(it, offset, control);
+    if (!canGoTo)
+      metrics.Add(TriplesScanned, skipped - offset);
+  }
+
+  // Add matching triples to the result
+  if (!offset) {
+    MetricsTimer timer(metrics, DecodePhase);
+    if (columnar)
+      result->columns.Read(it, hdt->getDictionary(), termCache, limit, control);
+    else
+      result->page.Read(it, hdt->getDictionary(), termCache, limit, control);
+    result->hasMore = limit && it->hasNext();
+    metrics.Add(TriplesScanned, result->Size());
+    metrics.Add(TriplesReturned, result->Size());
+    metrics.Add(BytesAllocated, result->Bytes());
+  }
+  return result;
+}
+
+// Returns the key of a search in the page cache
+static string toPageKey(const TripleID& tripleId, uint64_t offset, uint64_t limit, bool columnar) {
+  const uint64_t key[] = { tripleId.getSubject(), tripleId.getPredicate(), tripleId.getObject(),
+                           offset, limit, columnar };
+  return string((const char*)key, sizeof(key));
+}
+
+class SearchTriplesWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  string subject, predicate, object;
+  uint64_t offset, limit;
+  bool columnar;
+  string continuation;
+  uint32_t queryId;
+  QueryControl control;
+  // Callback return values
+  shared_ptr<const SearchTriplesResult> result;
+  string nextContinuation;
+
+public:
+  SearchTriplesWorker(HdtDocument* document, char* subject, char* predicate, char* object,
+                      uint64_t offset, uint64_t limit, bool columnar, char* continuation,
+                      uint32_t queryId, uint32_t timeoutMs, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback),
+      document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), SearchTriplesOperation),
+      subject(subject), predicate(predicate), object(object),
+      offset(offset), limit(limit), columnar(columnar), continuation(continuation),
+      queryId(queryId), control(timeoutMs), result(new SearchTriplesResult()) {
+    SaveToPersistent(SELF, self);
+    document->GetQueries()->Register(queryId, &control);
+  };
+
+  ~SearchTriplesWorker() {
+    document->GetQueries()->Unregister(queryId);
+  }
+
+  void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    IteratorTripleID* it = NULL;
+    // The HDT that the iterator belongs to, which differs from the current one for iterators that were parked
+    // before the index was built; it is released after the iterator
+    shared_ptr<HDT> iteratorHdt(hdt);
+    try {
+      // Prepare the triple pattern
+      Dictionary* dict = hdt->getDictionary();
+      TripleID tripleId;
+      // If any of the components does not exist, there are no matches
+      {
+        MetricsTimer timer(metrics, ResolvePhase);
+        if (!toTripleID(dict, subject, predicate, object, tripleId))
+          return;
+      }
+
+      // Resume at the position of the continuation token, preferably with its parked iterator
+      ContinuationTable* continuations = document->GetContinuations();
+      if (!continuation.empty()) {
+        TripleID tokenPattern;
+        uint64_t position, parkedId;
+        if (!ContinuationTable::FromToken(continuation, tokenPattern, position, parkedId) ||
+            tokenPattern.getSubject()   != tripleId.getSubject()   ||
+            tokenPattern.getPredicate() != tripleId.getPredicate() ||
+            tokenPattern.getObject()    != tripleId.getObject()) {
+          SetErrorMessage("Invalid continuation token");
+          return;
+        }
+        offset = position;
+        it = continuations->Take(parkedId, tripleId, offset, iteratorHdt);
+      }
+      const uint64_t position = offset;
+
+      // Serve the result from the cache if possible
+      PageCache* pageCache = document->GetPageCache();
+      string key(toPageKey(tripleId, offset, limit, columnar));
+      if (!it && pageCache->Get(key, result)) {
+        if (result->hasMore)
+          nextContinuation = ContinuationTable::ToToken(tripleId, position + result->Size());
+        return;
+      }
+      // Read the page, continuing from the parked iterator if there is one
+      shared_ptr<SearchTriplesResult> newResult =
+        readPage(hdt.get(), document->GetTermCache(), document->GetStatistics(),
+                 tripleId, offset, limit, columnar, it, &control, metrics);
+      result = newResult;
+      if (control.IsCancelled())
+        throw runtime_error(ABORTED_ERROR);
+      // Only complete pages can be cached
+      if (!control.HasTimedOut())
+        pageCache->Put(key, result, key.size() + newResult->Bytes());
+
+      // Create a token for the next page; iterators that cannot jump are parked to avoid skipping
+      if (newResult->hasMore) {
+        uint64_t next = position + newResult->Size();
+        if (it->canGoTo()) {
+          nextContinuation = ContinuationTable::ToToken(tripleId, next);
+        }
+        else {
+          nextContinuation = continuations->Park(tripleId, next, it, iteratorHdt);
+          it = NULL;
+        }
+      }
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+    if (it)
+      delete it;
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Send the JavaScript triples, estimated total count, continuation token,
+    // and whether the result is incomplete because of the deadline through the callback
+    const unsigned argc = 6;
+    Local<Value> argv[argc] = { Nan::Null(),
+                                columnar ? Local<Value>(result->columns.ToObject()) : result->page.ToArray(),
+                                Nan::New<Number>((double)result->totalCount),
+                                Nan::New<Boolean>((bool)result->hasExactCount),
+                                nextContinuation.empty() ? Local<Value>(Nan::Null()) :
+                                  Local<Value>(Nan::New(nextContinuation).ToLocalChecked()),
+                                Nan::New<Boolean>(control.HasTimedOut()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Searches for a triple pattern in the document.
+// JavaScript signature: HdtDocument#_searchTriples(subject, predicate, object, offset, limit, columnar,
+//                                                  continuation, queryId, timeoutMs, callback)
+NAN_METHOD(HdtDocument::SearchTriples) {
+  assert(info.Length() == 10);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new SearchTriplesWorker(document,
+    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]), *Nan::Utf8String(info[2]),
+    toUint64(info[3]), toUint64(info[4]),
+    Nan::To<bool>(info[5]).FromJust(), *Nan::Utf8String(info[6]),
+    Nan::To<uint32_t>(info[7]).FromJust(), Nan::To<uint32_t>(info[8]).FromJust(),
+    new Nan::Callback(info[9].As<Function>()), info.This()), toPagePriority(toUint64(info[4])));
+}
+
+
+
+/******** HdtDocument#_searchTriplesBatch ********/
+
+class SearchTriplesBatchWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  vector<string> components;
+  vector<double> ranges;
+  bool columnar;
+  uint32_t threadCount;
+  // Callback return values
+  vector<shared_ptr<const SearchTriplesResult> > results;
+  // Shared state of the threads
+  std::atomic<size_t> nextPattern;
+  std::atomic<bool> failed;
+  std::mutex errorMutex;
+  string error;
+
+public:
+  SearchTriplesBatchWorker(HdtDocument* document, const vector<string>& components, const vector<double>& ranges,
+                           bool columnar, uint32_t threadCount, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), SearchTriplesBatchOperation),
+      components(components), ranges(ranges), columnar(columnar), threadCount(threadCount),
+      results(components.size() / 3), nextPattern(0), failed(false) {
+    SaveToPersistent(SELF, self);
+  };
+
+  void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    if (results.empty())
+      return;
+    // Search the patterns on this thread and, if requested, on additional threads
+    size_t extraThreads = std::min((size_t)threadCount, results.size()) - 1;
+    vector<std::thread> threads;
+    try {
+      for (size_t i = 0; i < extraThreads; i++)
+        threads.push_back(std::thread(&SearchTriplesBatchWorker::SearchPatterns, this));
+    }
+    catch (const std::system_error&) { /* continue with the threads that could be started */ }
+    SearchPatterns();
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+    if (failed)
+      SetErrorMessage(error.c_str());
+  }
+
+  // Searches patterns until none are left
+  void SearchPatterns() {
+    for (size_t i = nextPattern++; i < results.size() && !failed; i = nextPattern++) {
+      IteratorTripleID* it = NULL;
+      try {
+        // Patterns with components that do not exist have no matches
+        TripleID tripleId;
+        string object(components[3 * i + 2]);
+        if (!toTripleID(hdt->getDictionary(), components[3 * i], components[3 * i + 1], object, tripleId)) {
+          results[i].reset(new SearchTriplesResult());
+          continue;
+        }
+
+        // Serve the result from the cache if possible, or read and cache the page
+        uint64_t offset = (uint64_t)ranges[2 * i], limit = (uint64_t)ranges[2 * i + 1];
+        PageCache* pageCache = document->GetPageCache();
+        string key(toPageKey(tripleId, offset, limit, columnar));
+        if (!pageCache->Get(key, results[i])) {
+          shared_ptr<SearchTriplesResult> result =
+            readPage(hdt.get(), document->GetTermCache(), document->GetStatistics(),
+                     tripleId, offset, limit, columnar, it, NULL, metrics);
+          results[i] = result;
+          pageCache->Put(key, results[i], key.size() + result->Bytes());
+        }
+      }
+      catch (const runtime_error& exception) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!failed)
+          error = exception.what(), failed = true;
+      }
+      if (it)
+        delete it;
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Convert every result into an array of triples, estimated total count, and exactness
+    Local<Array> resultsArray = Nan::New<Array>(results.size());
+    for (uint32_t i = 0; i < results.size(); i++) {
+      const SearchTriplesResult& result = *results[i];
+      Local<Array> resultArray = Nan::New<Array>(3);
+      Nan::Set(resultArray, 0, columnar ? Local<Value>(result.columns.ToObject()) : result.page.ToArray());
+      Nan::Set(resultArray, 1, Nan::New<Number>((double)result.totalCount));
+      Nan::Set(resultArray, 2, Nan::New<Boolean>((bool)result.hasExactCount));
+      Nan::Set(resultsArray, i, resultArray);
+    }
+
+    // Send the results through the callback
+    const unsigned argc = 2;
+    Local<Value> argv[argc] = { Nan::Null(), resultsArray };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Searches for several triple patterns in the document at once.
+// JavaScript signature: HdtDocument#_searchTriplesBatch(components, ranges, columnar, threads, callback)
+NAN_METHOD(HdtDocument::SearchTriplesBatch) {
+  assert(info.Length() == 5);
+  // Copy the patterns, since the JavaScript arrays cannot be accessed from the worker
+  Local<Array> componentsArray = info[0].As<Array>();
+  vector<string> components(componentsArray->Length());
+  for (uint32_t i = 0; i < components.size(); i++)
+    components[i] = *Nan::Utf8String(Nan::Get(componentsArray, i).ToLocalChecked());
+  Nan::TypedArrayContents<double> rangesArray(info[1]);
+  vector<double> ranges(*rangesArray, *rangesArray + rangesArray.length());
+  assert(ranges.size() == components.size() / 3 * 2);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new SearchTriplesBatchWorker(document, components, ranges,
+    Nan::To<bool>(info[2]).FromJust(), std::max(1u, Nan::To<uint32_t>(info[3]).FromJust()),
+    new Nan::Callback(info[4].As<Function>()), info.This()), NormalPriority);
+}
+
+
+
+/******** searchHdtUnion ********/
+
+// A document that is searched as one shard of a union
+struct UnionShard {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // The pattern in the shard's IDs, if all of its components occur in the shard
+  TripleID tripleId;
+  bool matches;
+  // The estimated or exact number of matches
+  uint64_t count;
+  bool isExact;
+  // The part of the matches that belongs to the page
+  uint64_t offset, limit;
+  shared_ptr<SearchTriplesResult> result;
+
+  UnionShard(HdtDocument* document)
+    : document(document), hdt(document->GetHDT()), metrics(document->GetMetrics(), SearchTriplesOperation),
+      matches(false), count(0), isExact(true), offset(0), limit(0) { }
+};
+
+// The IDs in an earlier shard of terms from the shard being read, which are cached for the last subject and object,
+// since triples arrive in runs of the same subject, and for all predicates, which are few
+struct EarlierShardIds {
+  size_t lastIds[3], earlierIds[3];
+  map<size_t, size_t> predicates;
+
+  EarlierShardIds() {
+    for (int position = 0; position < 3; position++)
+      lastIds[position] = earlierIds[position] = 0;
+  }
+};
+
+class SearchUnionWorker : public Nan::AsyncWorker {
+  vector<UnionShard> shards;
+  // JavaScript function arguments
+  string subject, predicate, object;
+  uint64_t offset, limit;
+  bool deduplicate;
+  uint32_t threadCount;
+  // Callback return values
+  uint64_t totalCount;
+  bool hasExactCount;
+  // Shared state of the threads, which perform the same step on different shards
+  void (SearchUnionWorker::*step)(UnionShard& shard);
+  vector<size_t> stepShards;
+  std::atomic<size_t> nextShard;
+  std::atomic<bool> failed;
+  std::mutex errorMutex;
+  string error;
+
+public:
+  SearchUnionWorker(const vector<HdtDocument*>& documents, char* subject, char* predicate, char* object,
+                    uint64_t offset, uint64_t limit, bool deduplicate, uint32_t threadCount,
+                    Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback),
+      subject(subject), predicate(predicate), object(object), offset(offset), limit(limit),
+      deduplicate(deduplicate), threadCount(threadCount), totalCount(0), hasExactCount(true),
+      step(NULL), nextShard(0), failed(false) {
+    SaveToPersistent(SELF, self);
+    for (size_t i = 0; i < documents.size(); i++)
+      shards.push_back(UnionShard(documents[i]));
+  };
+
+  void Execute() {
+    for (size_t i = 0; i < shards.size(); i++) {
+      if (!shards[i].hdt) {
+        SetErrorMessage(CLOSED_ERROR);
+        return;
+      }
+    }
+    try {
+      // Count the matches of all shards in parallel
+      vector<size_t> all(shards.size());
+      for (size_t i = 0; i < all.size(); i++)
+        all[i] = i;
+      RunStep(&SearchUnionWorker::CountShard, all);
+      uint64_t matchingShards = 0;
+      for (size_t i = 0; i < shards.size(); i++) {
+        totalCount += shards[i].count;
+        hasExactCount = hasExactCount && shards[i].isExact;
+        matchingShards += shards[i].count > 0;
+      }
+      // Duplicates are only found while reading, so the sum of several shards is an upper bound
+      if (deduplicate && matchingShards > 1)
+        hasExactCount = false;
+
+      // Assign the page to the shards in order. Shards with exact counts can be skipped entirely
+      // or read in parallel; the others are read in order, since only reading shows where they end.
+      uint64_t remainingOffset = offset, remainingLimit = limit;
+      vector<size_t> pageShards;
+      for (size_t i = 0; i < shards.size() && remainingLimit && !failed; i++) {
+        UnionShard& shard = shards[i];
+        if (!shard.matches)
+          continue;
+        if (shard.isExact && !deduplicate) {
+          if (remainingOffset >= shard.count) {
+            remainingOffset -= shard.count;
+            continue;
+          }
+          shard.offset = remainingOffset;
+          shard.limit = std::min(remainingLimit, shard.count - remainingOffset);
+          remainingOffset = 0;
+          remainingLimit -= shard.limit;
+          pageShards.push_back(i);
+        }
+        else {
+          ReadShardInOrder(i, remainingOffset, remainingLimit);
+        }
+      }
+      RunStep(&SearchUnionWorker::ReadShard, pageShards);
+    }
+    catch (const runtime_error& exception) { Fail(exception.what()); }
+    if (failed)
+      SetErrorMessage(error.c_str());
+  }
+
+  // Performs the step for the given shards on this thread and, if requested, on additional threads
+  void RunStep(void (SearchUnionWorker::*shardStep)(UnionShard& shard), const vector<size_t>& indexes) {
+    if (indexes.empty())
+      return;
+    step = shardStep;
+    stepShards = indexes;
+    nextShard = 0;
+    size_t extraThreads = std::min((size_t)threadCount, indexes.size()) - 1;
+    vector<std::thread> threads;
+    try {
+      for (size_t i = 0; i < extraThreads; i++)
+        threads.push_back(std::thread(&SearchUnionWorker::RunShards, this));
+    }
+    catch (const std::system_error&) { /* continue with the threads that could be started */ }
+    RunShards();
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+  }
+
+  // Performs the current step on shards until none are left
+  void RunShards() {
+    for (size_t i = nextShard++; i < stepShards.size() && !failed; i = nextShard++) {
+      try { (this->*step)(shards[stepShards[i]]); }
+      catch (const runtime_error& exception) { Fail(exception.what()); }
+    }
+  }
+
+  // Records the first error of any thread
+  void Fail(const char* message) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!failed)
+      error = message, failed = true;
+  }
+
+  // Determines the number of matches of the pattern in the shard
+  void CountShard(UnionShard& shard) {
+    string shardObject(object);
+    {
+      MetricsTimer timer(shard.metrics, ResolvePhase);
+      shard.matches = toTripleID(shard.hdt->getDictionary(), subject, predicate, shardObject, shard.tripleId);
+    }
+    if (shard.matches) {
+      IteratorTripleID* it = shard.hdt->getTriples()->search(shard.tripleId);
+      countMatches(it, shard.document->GetStatistics(), shard.tripleId, shard.count, shard.isExact);
+      delete it;
+    }
+  }
+
+  // Reads the shard's assigned part of the page
+  void ReadShard(UnionShard& shard) {
+    IteratorTripleID* it = NULL;
+    try {
+      shard.result = readPage(shard.hdt.get(), shard.document->GetTermCache(), shard.document->GetStatistics(),
+                              shard.tripleId, shard.offset, shard.limit, false, it, NULL, shard.metrics);
+    }
+    catch (const runtime_error&) {
+      delete it;
+      throw;
+    }
+    delete it;
+  }
+
+  // Reads the shard's matches after the offset until the limit, counting both down,
+  // and leaving out triples that occur in earlier shards if deduplicating
+  void ReadShardInOrder(size_t index, uint64_t& remainingOffset, uint64_t& remainingLimit) {
+    UnionShard& shard = shards[index];
+    Dictionary* dict = shard.hdt->getDictionary();
+    TermCache* termCache = shard.document->GetTermCache();
+    shard.result.reset(new SearchTriplesResult());
+    TriplePage& page = shard.result->page;
+    IteratorTripleID* it = shard.hdt->getTriples()->search(shard.tripleId);
+    vector<EarlierShardIds> earlierIds(deduplicate ? index : 0);
+    try {
+      uint64_t scanned = 0;
+      // Without deduplication, every match counts towards the offset
+      if (!deduplicate) {
+        const uint64_t skipped = remainingOffset;
+        skipTriples(it, remainingOffset);
+        scanned += skipped - remainingOffset;
+      }
+      while (remainingLimit && it->hasNext()) {
+        TripleID& triple = *it->next();
+        scanned++;
+        if (deduplicate && OccursInEarlierShard(index, triple, earlierIds))
+          continue;
+        if (remainingOffset)
+          remainingOffset--;
+        else
+          page.Add(triple, dict, termCache), remainingLimit--;
+      }
+      shard.metrics.Add(TriplesScanned, scanned);
+      shard.metrics.Add(TriplesReturned, page.triples.size());
+      shard.metrics.Add(BytesAllocated, shard.result->Bytes());
+    }
+    catch (const runtime_error&) {
+      delete it;
+      throw;
+    }
+    delete it;
+  }
+
+  // Determines whether the triple of the given shard also occurs in any of the shards before it
+  bool OccursInEarlierShard(size_t index, TripleID& triple, vector<EarlierShardIds>& earlierIds) {
+    for (size_t i = 0; i < index; i++) {
+      // Shards without some component of the pattern cannot contain the triple
+      if (!shards[i].matches)
+        continue;
+      size_t ids[3];
+      bool found = true;
+      for (int position = 0; position < 3 && found; position++) {
+        ids[position] = ConvertId(shards[index], shards[i], earlierIds[i],
+                                  getComponent(triple, position), (TripleComponentRole)position);
+        found = ids[position] != 0;
+      }
+      if (found) {
+        TripleID tripleId(ids[0], ids[1], ids[2]);
+        IteratorTripleID* it = shards[i].hdt->getTriples()->search(tripleId);
+        found = it->hasNext();
+        delete it;
+        if (found)
+          return true;
+      }
+    }
+    return false;
+  }
+
+  // Converts the ID of a term in the given position of the shard into its ID in the earlier shard,
+  // returning 0 if it does not occur there
+  size_t ConvertId(UnionShard& shard, UnionShard& earlier, EarlierShardIds& earlierIds,
+                   size_t id, TripleComponentRole role) {
+    // Components of the pattern are already known in every shard
+    const size_t patternId = getComponent(earlier.tripleId, role);
+    if (patternId)
+      return patternId;
+    if (role == PREDICATE) {
+      map<size_t, size_t>::const_iterator predicate = earlierIds.predicates.find(id);
+      if (predicate != earlierIds.predicates.end())
+        return predicate->second;
+    }
+    else if (earlierIds.lastIds[role] == id) {
+      return earlierIds.earlierIds[role];
+    }
+    // Look up the term through the shard's term cache, which also decodes the triples of the page
+    string term(shard.document->GetTermCache()->Decode(shard.hdt->getDictionary(), id, role));
+    const size_t earlierId = earlier.hdt->getDictionary()->stringToId(role == OBJECT ? toHdtLiteral(term) : term,
+                                                                      role);
+    if (role == PREDICATE)
+      earlierIds.predicates[id] = earlierId;
+    else
+      earlierIds.lastIds[role] = id, earlierIds.earlierIds[role] = earlierId;
+    return earlierId;
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    // Send the JavaScript triples of every shard in order, the total count, and its exactness
+    Local<Array> pages = Nan::New<Array>();
+    for (size_t i = 0; i < shards.size(); i++) {
+      if (shards[i].result && shards[i].result->Size())
+        Nan::Set(pages, pages->Length(), shards[i].result->page.ToArray());
+    }
+    const unsigned argc = 4;
+    Local<Value> argv[argc] = { Nan::Null(), pages,
+                                Nan::New<Number>((double)totalCount), Nan::New<Boolean>(hasExactCount) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Searches for a triple pattern in the union of several documents, in the order of the documents.
+// JavaScript signature: searchHdtUnion(documents, subject, predicate, object, offset, limit,
+//                                      deduplicate, threads, callback)
+NAN_METHOD(HdtDocument::SearchUnion) {
+  assert(info.Length() == 9);
+  Local<Array> documentsArray = info[0].As<Array>();
+  vector<HdtDocument*> documents(documentsArray->Length());
+  assert(!documents.empty());
+  for (uint32_t i = 0; i < documents.size(); i++) {
+    Local<Object> document = Nan::To<Object>(Nan::Get(documentsArray, i).ToLocalChecked()).ToLocalChecked();
+    documents[i] = Unwrap<HdtDocument>(document);
+  }
+  // The search runs on the threads of the first document, and keeps all documents alive through their array
+  documents[0]->QueueWorker(new SearchUnionWorker(documents,
+    *Nan::Utf8String(info[1]), *Nan::Utf8String(info[2]), *Nan::Utf8String(info[3]),
+    toUint64(info[4]), toUint64(info[5]), Nan::To<bool>(info[6]).FromJust(),
+    std::max(1u, Nan::To<uint32_t>(info[7]).FromJust()),
+    new Nan::Callback(info[8].As<Function>()), documentsArray), toPagePriority(toUint64(info[5])));
+}
+
+
+
+/******** HdtDocument#_exportTo ********/
+
+// Appends the HDT term in the given position to the buffer in N-Triples syntax
+static void appendNTriplesTerm(string& buffer, const string& term, TripleComponentRole role) {
+  // Literals are stored with an unescaped lexical form
+  if (role == OBJECT && term.size() > 1 && term[0] == '"') {
+    size_t end = term.rfind('"');
+    buffer += '"';
+    for (size_t i = 1; i < end; i++) {
+      unsigned char c = term[i];
+      switch (c) {
+      case '"':  buffer += "\\\""; break;
+      case '\\': buffer += "\\\\"; break;
+      case '\t': buffer += "\\t"; break;
+      case '\n': buffer += "\\n"; break;
+      case '\r': buffer += "\\r"; break;
+      case '\b': buffer += "\\b"; break;
+      case '\f': buffer += "\\f"; break;
+      default:
+        if (c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04X", c);
+          buffer += escaped;
+        }
+        else {
+          buffer += c;
+        }
+      }
+    }
+    buffer.append(term, end, string::npos);
+  }
+  // Blank nodes keep their prefix, and IRIs are surrounded by angular brackets
+  else if (term.compare(0, 2, "_:") == 0) {
+    buffer += term;
+  }
+  else {
+    buffer += '<';
+    buffer += term;
+    buffer += '>';
+  }
+}
+
+// Writes the whole buffer to the file descriptor, returning false on failure
+static bool writeAll(int fd, const string& buffer) {
+  for (size_t written = 0; written < buffer.size();) {
+    ssize_t result = write(fd, buffer.data() + written, buffer.size() - written);
+    if (result < 0 && errno != EINTR)
+      return false;
+    if (result > 0)
+      written += result;
+  }
+  return true;
+}
+
+class ExportTriplesWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  string filename;
+  int fd;
+  uint32_t threadCount;
+  // Callback return values
+  uint64_t count;
+  // Shared state of the threads, which encode chunks in any order but write them in order
+  uint64_t chunkCount, nextOutput;
+  std::atomic<uint64_t> nextChunk;
+  std::atomic<bool> failed;
+  std::mutex outputMutex;
+  std::condition_variable outputReady;
+  string error;
+
+public:
+  ExportTriplesWorker(HdtDocument* document, const string& filename, int fd, uint32_t threadCount,
+                      Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), ExportOperation),
+      filename(filename), fd(fd), threadCount(threadCount), count(0),
+      chunkCount(0), nextOutput(0), nextChunk(0), failed(false) {
+    SaveToPersistent(SELF, self);
+  };
+
+  void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    // Open the file, unless a file descriptor was passed
+    if (!filename.empty() && (fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+      SetErrorMessage(strerror(errno));
+      return;
+    }
+    uint64_t tripleCount = hdt->getTriples()->getNumberOfElements();
+    chunkCount = (tripleCount + EXPORT_CHUNK_SIZE - 1) / EXPORT_CHUNK_SIZE;
+
+    // Export the chunks on this thread and, if requested, on additional threads
+    size_t extraThreads = std::max((uint64_t)1, std::min((uint64_t)threadCount, chunkCount)) - 1;
+    vector<std::thread> threads;
+    try {
+      for (size_t i = 0; i < extraThreads; i++)
+        threads.push_back(std::thread(&ExportTriplesWorker::ExportChunks, this));
+    }
+    catch (const std::system_error&) { /* continue with the threads that could be started */ }
+    ExportChunks();
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    if (!filename.empty() && close(fd) && !failed)
+      Fail(strerror(errno));
+    if (failed)
+      SetErrorMessage(error.c_str());
+  }
+
+  // Encodes chunks of triples until none are left, writing each one after the chunks before it
+  void ExportChunks() {
+    LruCache<uint64_t, string> terms(EXPORT_TERM_CACHE_SIZE, 1);
+    string buffer, term;
+    for (uint64_t chunk = nextChunk++; chunk < chunkCount && !failed; chunk = nextChunk++) {
+      uint64_t chunkTriples = 0;
+      buffer.clear();
+      IteratorTripleID* it = NULL;
+      try {
+        it = hdt->getTriples()->search(TripleID(0, 0, 0));
+        uint64_t offset = chunk * EXPORT_CHUNK_SIZE;
+        skipTriples(it, offset);
+        Dictionary* dict = hdt->getDictionary();
+        for (; chunkTriples < EXPORT_CHUNK_SIZE && it->hasNext(); chunkTriples++) {
+          TripleID* triple = it->next();
+          for (int position = 0; position < 3; position++) {
+            TripleComponentRole role = (TripleComponentRole)position;
+            size_t id = getComponent(*triple, position);
+            const uint64_t key = (uint64_t)id << 2 | role;
+            if (!terms.Get(key, term)) {
+              term.clear();
+              appendNTriplesTerm(term, dict->idToString(id, role), role);
+              terms.Put(key, term, sizeof(key) + term.capacity());
+              metrics.Add(TermsDecoded, 1);
+            }
+            buffer += term;
+            buffer += position < 2 ? " " : " .\n";
+          }
+        }
+      }
+      catch (const runtime_error& exception) { Fail(exception.what()); }
+      if (it)
+        delete it;
+
+      // Wait for the previous chunks to be written
+      std::unique_lock<std::mutex> lock(outputMutex);
+      while (nextOutput != chunk && !failed)
+        outputReady.wait(lock);
+      if (!failed && !writeAll(fd, buffer)) {
+        error = strerror(errno);
+        failed = true;
+      }
+      count += chunkTriples;
+      metrics.Add(TriplesScanned, chunkTriples);
+      metrics.Add(TriplesReturned, chunkTriples);
+      nextOutput++;
+      lock.unlock();
+      outputReady.notify_all();
+    }
+  }
+
+  // Stops the export with the given error, unless it already failed
+  void Fail(const char* message) {
+    {
+      std::lock_guard<std::mutex> lock(outputMutex);
+      if (!failed)
+        error = message, failed = true;
+    }
+    outputReady.notify_all();
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
+    const unsigned argc = 2;
+    Local<Value> argv[argc] = { Nan::Null(), Nan::New<Number>((double)count) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Writes all triples of the document to a file or file descriptor in N-Triples syntax.
+// JavaScript signature: HdtDocument#_exportTo(filenameOrFd, threads, callback)
+NAN_METHOD(HdtDocument::ExportTo) {
+  assert(info.Length() == 3);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  bool isFd = info[0]->IsNumber();
+  document->QueueWorker(new ExportTriplesWorker(document,
+    isFd ? string() : string(*Nan::Utf8String(info[0])), isFd ? Nan::To<int32_t>(info[0]).FromJust() : -1,
+    std::max(1u, Nan::To<uint32_t>(info[1]).FromJust()),
+    new Nan::Callback(info[2].As<Function>()), info.This()), LowPriority);
+}
+
+
+
+/******** HdtDocument#_searchTriplesCursor ********/
+
+class SearchTriplesCursorWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  string subject, predicate, object;
+  uint64_t offset, limit;
+  // Callback return values
+  IteratorTripleID* it;
+  uint64_t totalCount;
+  bool hasExactCount;
+
+public:
+  SearchTriplesCursorWorker(HdtDocument* document, char* subject, char* predicate, char* object,
+                            uint64_t offset, uint64_t limit, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback),
+      document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), SearchTriplesCursorOperation),
+      subject(subject), predicate(predicate), object(object),
+      offset(offset), limit(limit), it(NULL), totalCount(0), hasExactCount(true) {
+    SaveToPersistent(SELF, self);
+  };
+
+  ~SearchTriplesCursorWorker() {
+    // Delete the iterator if it was not handed over to a cursor
+    if (it)
+      delete it;
+  }
+
+  void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    try {
+      // Prepare the triple pattern; without matches, the cursor remains empty
+      TripleID tripleId;
+      if (!toTripleID(hdt->getDictionary(), subject, predicate, object, tripleId))
+        return;
+
+      // Estimate the total number of triples and go to the right offset
+      it = hdt->getTriples()->search(tripleId);
+      countMatches(it, document->GetStatistics(), tripleId, totalCount, hasExactCount);
+      skipTriples(it, offset);
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Create a new cursor that takes ownership of the iterator
+    Local<Object> self = Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked();
+    Local<Object> newCursor = Nan::NewInstance(Nan::New(HdtCursor::GetConstructor())).ToLocalChecked();
+    new HdtCursor(newCursor, self, document, hdt, offset ? NULL : it, limit);
+    if (!offset)
+      it = NULL;
+
+    // Send the new cursor and estimated total count through the callback
+    const unsigned argc = 4;
+    Local<Value> argv[argc] = { Nan::Null(), newCursor,
+                                Nan::New<Number>((double)totalCount),
+                                Nan::New<Boolean>((bool)hasExactCount) };
+    callback->Call(self, argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Opens a cursor over the matches of a triple pattern in the document.
+// JavaScript signature: HdtDocument#_searchTriplesCursor(subject, predicate, object, offset, limit, callback)
+NAN_METHOD(HdtDocument::SearchTriplesCursor) {
+  assert(info.Length() == 6);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new SearchTriplesCursorWorker(document,
+    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]), *Nan::Utf8String(info[2]),
+    toUint64(info[3]), toUint64(info[4]),
+    new Nan::Callback(info[5].As<Function>()), info.This()), NormalPriority);
+}
+
+
+
+/******** HdtDocument#_searchTripleIds ********/
+
+class SearchTripleIdsWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  TripleID pattern;
+  uint64_t offset, limit;
+  // Callback return values
+  vector<uint32_t> ids;
+  uint64_t totalCount;
+  bool hasExactCount;
+
+public:
+  SearchTripleIdsWorker(HdtDocument* document, uint32_t subject, uint32_t predicate, uint32_t object,
+                        uint64_t offset, uint64_t limit, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), SearchTripleIdsOperation),
+      pattern(subject, predicate, object), offset(offset), limit(limit), totalCount(0), hasExactCount(true) {
+    SaveToPersistent(SELF, self);
+  };
+
+  void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    IteratorTripleID* it = NULL;
+    try {
+      // IDs outside of the dictionary have no matches
+      Dictionary* dict = hdt->getDictionary();
+      if (pattern.getSubject()   > getMaxId(dict, SUBJECT)   ||
+          pattern.getPredicate() > getMaxId(dict, PREDICATE) ||
+          pattern.getObject()    > getMaxId(dict, OBJECT))
+        return;
+
+      // Estimate the total number of triples and go to the right offset
+      it = hdt->getTriples()->search(pattern);
+      countMatches(it, document->GetStatistics(), pattern, totalCount, hasExactCount);
+      skipTriples(it, offset);
+
+      // Add the IDs of matching triples to the result vector
+      if (!offset) {
+        for (uint64_t count = 0; count < limit && it->hasNext(); count++) {
+          TripleID& triple = *it->next();
+          ids.push_back(triple.getSubject());
+          ids.push_back(triple.getPredicate());
+          ids.push_back(triple.getObject());
+        }
+      }
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+    if (it)
+      delete it;
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Send the typed array and estimated total count through the callback
+    const unsigned argc = 4;
+    Local<Value> argv[argc] = { Nan::Null(), toUint32Array(ids),
+                                Nan::New<Number>((double)totalCount),
+                                Nan::New<Boolean>((bool)hasExactCount) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Searches for a triple pattern of IDs in the document.
+// JavaScript signature: HdtDocument#_searchTripleIds(subject, predicate, object, offset, limit, callback)
+NAN_METHOD(HdtDocument::SearchTripleIds) {
+  assert(info.Length() == 6);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new SearchTripleIdsWorker(document,
+    Nan::To<uint32_t>(info[0]).FromJust(), Nan::To<uint32_t>(info[1]).FromJust(),
+    Nan::To<uint32_t>(info[2]).FromJust(),
+    toUint64(info[3]), toUint64(info[4]),
+    new Nan::Callback(info[5].As<Function>()), info.This()), toPagePriority(toUint64(info[4])));
+}
+
+
+
+/******** HdtDocument#_termsToIds ********/
+
+class TermsToIdsWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  vector<string> terms;
+  TripleComponentRole position;
+  // Callback return values
+  vector<uint32_t> ids;
+
+public:
+  TermsToIdsWorker(HdtDocument* document, const vector<string>& terms, uint32_t posId,
+                   Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), TermsToIdsOperation),
+      terms(terms), position((TripleComponentRole) posId) {
+    SaveToPersistent(SELF, self);
+  };
+
+  void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    try {
+      // Look up every term, using 0 for terms that do not occur
+      Dictionary* dict = hdt->getDictionary();
+      ids.reserve(terms.size());
+      for (vector<string>::iterator term = terms.begin(); term != terms.end(); term++)
+        ids.push_back(term->empty() ? 0 :
+          dict->stringToId(position == OBJECT ? toHdtLiteral(*term) : *term, position));
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Send the typed array of IDs through the callback
+    const unsigned argc = 2;
+    Local<Value> argv[argc] = { Nan::Null(), toUint32Array(ids) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Converts terms into their dictionary IDs for the given position.
+// JavaScript signature: HdtDocument#_termsToIds(terms, position, callback)
+NAN_METHOD(HdtDocument::TermsToIds) {
+  assert(info.Length() == 3);
+  // Copy the terms, since the JavaScript array cannot be accessed from the worker
+  Local<Array> termsArray = info[0].As<Array>();
+  vector<string> terms(termsArray->Length());
+  for (uint32_t i = 0; i < terms.size(); i++)
+    terms[i] = *Nan::Utf8String(Nan::Get(termsArray, i).ToLocalChecked());
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new TermsToIdsWorker(document,
+    terms, Nan::To<uint32_t>(info[1]).FromJust(),
+    new Nan::Callback(info[2].As<Function>()), info.This()), HighPriority);
 }
 
 
 
-/******** createHdtDocument ********/
+/******** HdtDocument#_idsToTerms ********/
 
-class CreateWorker : public Nan::AsyncWorker {
-  string filename;
-  HDT* hdt;
+class IdsToTermsWorker : public Nan::AsyncWorker {
+  HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
+  // JavaScript function arguments
+  vector<uint32_t> ids;
+  TripleComponentRole position;
+  // Callback return values
+  vector<string> terms;
 
 public:
-  CreateWorker(const char* filename, Nan::Callback *callback)
-    : Nan::AsyncWorker(callback), filename(filename), hdt(NULL) { };
+  IdsToTermsWorker(HdtDocument* document, const vector<uint32_t>& ids, uint32_t posId,
+                   Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), IdsToTermsOperation),
+      ids(ids), position((TripleComponentRole) posId) {
+    SaveToPersistent(SELF, self);
+  };
 
   void Execute() {
-    try { hdt = HDTManager::mapIndexedHDT(filename.c_str()); }
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    try {
+      // Decode every ID, using the empty string for IDs outside of the dictionary
+      Dictionary* dict = hdt->getDictionary();
+      TermCache* termCache = document->GetTermCache();
+      size_t maxId = getMaxId(dict, position);
+      terms.resize(ids.size());
+      for (size_t i = 0; i < ids.size(); i++) {
+        if (ids[i] && ids[i] <= maxId)
+          terms[i] = termCache->Decode(dict, ids[i], position);
+      }
+    }
     catch (const runtime_error error) { SetErrorMessage(error.what()); }
   }
 
   void HandleOKCallback() {
     Nan::HandleScope scope;
-    // Create a new HdtDocument
-    Local<Object> newDocument = Nan::NewInstance(Nan::New(HdtDocument::GetConstructor())).ToLocalChecked();
-    new HdtDocument(newDocument, hdt);
-    // Send the new HdtDocument through the callback
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Send the JavaScript array of terms through the callback
     const unsigned argc = 2;
-    Local<Value> argv[argc] = { Nan::Null(), newDocument };
-    callback->Call(argc, argv, async_resource);
+    Local<Value> argv[argc] = { Nan::Null(), toStringArray(terms) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
   }
 };
 
-// Creates a new instance of HdtDocument.
-// JavaScript signature: createHdtDocument(filename, callback)
-NAN_METHOD(HdtDocument::Create) {
-  assert(info.Length() == 2);
-  Nan::AsyncQueueWorker(new CreateWorker(*Nan::Utf8String(info[0]),
-                                         new Nan::Callback(info[1].As<Function>())));
+// Converts dictionary IDs for the given position into terms.
+// JavaScript signature: HdtDocument#_idsToTerms(ids, position, callback)
+NAN_METHOD(HdtDocument::IdsToTerms) {
+  assert(info.Length() == 3);
+  // Copy the IDs, since the typed array cannot be accessed from the worker
+  Nan::TypedArrayContents<uint32_t> idsArray(info[0]);
+  vector<uint32_t> ids(*idsArray, *idsArray + idsArray.length());
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new IdsToTermsWorker(document,
+    ids, Nan::To<uint32_t>(info[1]).FromJust(),
+    new Nan::Callback(info[2].As<Function>()), info.This()), HighPriority);
 }
 
 
 
-/******** HdtDocument#_searchTriples ********/
+/******** HdtDocument#_evaluateBGP ********/
 
-class SearchTriplesWorker : public Nan::AsyncWorker {
+class EvaluateBGPWorker : public Nan::AsyncWorker {
   HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
   // JavaScript function arguments
-  string subject, predicate, object;
-  uint32_t offset, limit;
+  vector<string> components;
+  uint64_t offset, limit;
   // Callback return values
-  vector<TripleID> triples;
-  map<unsigned int, string> subjects, predicates, objects;
-  uint32_t totalCount;
-  bool hasExactCount;
+  vector<string> variables, bindings;
+  size_t rowCount;
 
 public:
-  SearchTriplesWorker(HdtDocument* document, char* subject, char* predicate, char* object,
-                      uint32_t offset, uint32_t limit, Nan::Callback* callback, Local<Object> self)
-    : Nan::AsyncWorker(callback),
-      document(document), subject(subject), predicate(predicate), object(object),
-      offset(offset), limit(limit), totalCount(0) {
+  EvaluateBGPWorker(HdtDocument* document, const vector<string>& components,
+                    uint64_t offset, uint64_t limit, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), EvaluateBGPOperation),
+      components(components), offset(offset), limit(limit), rowCount(0) {
     SaveToPersistent(SELF, self);
   };
 
   void Execute() {
-    IteratorTripleID* it = NULL;
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
     try {
-      // Prepare the triple pattern
-      Dictionary* dict = document->GetHDT()->getDictionary();
-      TripleString triple(subject, predicate, toHdtLiteral(object));
-      TripleID tripleId;
-      dict->tripleStringtoTripleID(triple, tripleId);
-      // If any of the components does not exist, there are no matches
-      if ((subject[0]   && !tripleId.getSubject())   ||
-          (predicate[0] && !tripleId.getPredicate()) ||
-          (object[0]    && !tripleId.getObject())) {
-        hasExactCount = true;
-        return;
-      }
-
-      // Estimate the total number of triples
-      it = document->GetHDT()->getTriples()->search(tripleId);
-      totalCount = it->estimatedNumResults();
-      hasExactCount = it->numResultEstimation() == EXACT;
-
-      // Go to the right offset
-      if (it->canGoTo())
-        try { it->skip(offset), offset = 0; }
-        catch (const runtime_error error) { /* invalid offset */ }
-      else
-        while (offset && it->hasNext()) it->next(), offset--;
-
-      // Add matching triples to the result vector
-      if (!offset) {
-        while (it->hasNext() && triples.size() < limit) {
-          TripleID& triple = *it->next();
-          triples.push_back(triple);
-          if (!subjects.count(triple.getSubject())) {
-            subjects[triple.getSubject()] = dict->idToString(triple.getSubject(), SUBJECT);
-          }
-          if (!predicates.count(triple.getPredicate())) {
-            predicates[triple.getPredicate()] = dict->idToString(triple.getPredicate(), PREDICATE);
-          }
-          if (!objects.count(triple.getObject())) {
-            string object(dict->idToString(triple.getObject(), OBJECT));
-            objects[triple.getObject()] = fromHdtLiteral(object);
-          }
-        }
-      }
+      // Join the patterns in ID space, decoding only the requested bindings
+      BasicGraphPattern pattern(hdt.get(), document->GetTermCache(), components, document->GetStatistics());
+      variables = pattern.GetVariables();
+      rowCount = pattern.Evaluate(offset, limit, bindings);
     }
     catch (const runtime_error error) { SetErrorMessage(error.what()); }
-    if (it)
-      delete it;
   }
 
   void HandleOKCallback() {
     Nan::HandleScope scope;
-    // Convert the triple components into strings
-    map<unsigned int, string>::const_iterator it;
-    map<unsigned int, Local<String> > subjectStrings, predicateStrings, objectStrings;
-    for (it = subjects.begin(); it != subjects.end(); it++)
-      subjectStrings[it->first] = Nan::New(it->second.c_str()).ToLocalChecked();
-    for (it = predicates.begin(); it != predicates.end(); it++)
-      predicateStrings[it->first] = Nan::New(it->second.c_str()).ToLocalChecked();
-    for (it = objects.begin(); it != objects.end(); it++)
-      objectStrings[it->first] = Nan::New(it->second.c_str()).ToLocalChecked();
-
-    // Convert the triples into a JavaScript object array
-    uint32_t count = 0;
-    Local<Array> triplesArray = Nan::New<Array>(triples.size());
-    const Local<String> SUBJECT   = Nan::New("subject").ToLocalChecked();
-    const Local<String> PREDICATE = Nan::New("predicate").ToLocalChecked();
-    const Local<String> OBJECT    = Nan::New("object").ToLocalChecked();
-    for (vector<TripleID>::const_iterator it = triples.begin(); it != triples.end(); it++) {
-      Local<Object> tripleObject = Nan::New<Object>();
-      Nan::Set(tripleObject, SUBJECT, subjectStrings[it->getSubject()]);
-      Nan::Set(tripleObject, PREDICATE, predicateStrings[it->getPredicate()]);
-      Nan::Set(tripleObject, OBJECT, objectStrings[it->getObject()]);
-      Nan::Set(triplesArray, count++, tripleObject);
-    }
-
-    // Send the JavaScript array and estimated total count through the callback
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Send the variables and the flat array of bindings through the callback
     const unsigned argc = 4;
-    Local<Value> argv[argc] = { Nan::Null(), triplesArray,
-                                Nan::New<Integer>((uint32_t)totalCount),
-                                Nan::New<Boolean>((bool)hasExactCount) };
+    Local<Value> argv[argc] = { Nan::Null(), toStringArray(variables), toStringArray(bindings),
+                                Nan::New<Number>((double)rowCount) };
     callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
   }
 
@@ -224,14 +1835,19 @@ public:
   }
 };
 
-// Searches for a triple pattern in the document.
-// JavaScript signature: HdtDocument#_searchTriples(subject, predicate, object, offset, limit, callback)
-NAN_METHOD(HdtDocument::SearchTriples) {
-  assert(info.Length() == 6);
-  Nan::AsyncQueueWorker(new SearchTriplesWorker(Unwrap<HdtDocument>(info.This()),
-    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]), *Nan::Utf8String(info[2]),
-    Nan::To<uint32_t>(info[3]).FromJust(), Nan::To<uint32_t>(info[4]).FromJust(),
-    new Nan::Callback(info[5].As<Function>()), info.This()));
+// Evaluates a basic graph pattern, given as a flat list of subjects, predicates, and objects.
+// JavaScript signature: HdtDocument#_evaluateBGP(components, offset, limit, callback)
+NAN_METHOD(HdtDocument::EvaluateBGP) {
+  assert(info.Length() == 4);
+  // Copy the components, since the JavaScript array cannot be accessed from the worker
+  Local<Array> componentsArray = info[0].As<Array>();
+  vector<string> components(componentsArray->Length());
+  for (uint32_t i = 0; i < components.size(); i++)
+    components[i] = *Nan::Utf8String(Nan::Get(componentsArray, i).ToLocalChecked());
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new EvaluateBGPWorker(document, components,
+    toUint64(info[1]), toUint64(info[2]),
+    new Nan::Callback(info[3].As<Function>()), info.This()), LowPriority);
 }
 
 
@@ -240,59 +1856,122 @@ NAN_METHOD(HdtDocument::SearchTriples) {
 
 class SearchLiteralsWorker : public Nan::AsyncWorker {
   HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
   // JavaScript function arguments
-  string substring;
-  uint32_t offset, limit;
+  string query;
+  LiteralSearchMode mode;
+  uint64_t offset, limit, afterId;
+  uint32_t queryId;
+  QueryControl control;
   // Callback return values
   vector<string> literals;
-  uint32_t totalCount;
+  uint64_t totalCount, lastId;
+  bool hasExactCount;
 
 public:
-  SearchLiteralsWorker(HdtDocument* document, char* substring, uint32_t offset, uint32_t limit,
-                       Nan::Callback* callback, Local<Object> self)
-    : Nan::AsyncWorker(callback), document(document),
-      substring(substring), offset(offset), limit(limit), totalCount(0) {
+  SearchLiteralsWorker(HdtDocument* document, char* query, uint32_t mode,
+                       uint64_t offset, uint64_t limit, uint64_t afterId,
+                       uint32_t queryId, uint32_t timeoutMs, Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), SearchLiteralsOperation),
+      query(query), mode((LiteralSearchMode)mode), offset(offset), limit(limit), afterId(afterId),
+      queryId(queryId), control(timeoutMs), totalCount(0), lastId(0), hasExactCount(false) {
     SaveToPersistent(SELF, self);
+    document->GetQueries()->Register(queryId, &control);
   };
 
+  ~SearchLiteralsWorker() {
+    document->GetQueries()->Unregister(queryId);
+  }
+
   void Execute() {
-    if (!document->Supports(LiteralSearch)) {
-      SetErrorMessage("The HDT document does not support literal search");
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
       return;
     }
+    try {
+      // A literal index supports all search modes and resuming after a given literal
+      const LiteralIndex* literalIndex = document->GetLiteralIndex();
+      if (literalIndex)
+        SearchIndex(literalIndex);
+      else
+        SearchDictionary();
+      if (control.IsCancelled())
+        throw runtime_error(ABORTED_ERROR);
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+  }
+
+  // Finds the matching literals through the literal index
+  void SearchIndex(const LiteralIndex* literalIndex) {
+    Dictionary* dict = hdt->getDictionary();
+    vector<uint64_t> literalIds;
+    literalIndex->Search(dict, query, mode, afterId, offset, limit, literalIds, totalCount, &control);
+    // The search stops counting at the deadline
+    hasExactCount = !control.HasTimedOut();
+
+    // Convert the literal IDs to strings
+    TermCache* termCache = document->GetTermCache();
+    for (size_t i = 0; i < literalIds.size() && !control.ShouldStop(); i++)
+      literals.push_back(termCache->Decode(dict, literalIds[i], OBJECT));
+    if (!literals.empty())
+      lastId = literalIds[literals.size() - 1];
+  }
+
+  // Finds the literals that contain the substring through a literal dictionary
+  void SearchDictionary() {
+    if (!document->Supports(LiteralSearch))
+      throw runtime_error("The HDT document does not support literal search");
+    if (mode != SubstringSearch || afterId)
+      throw runtime_error("The HDT document needs a literal index for this kind of literal search");
+    // The substring search itself cannot be interrupted, so it only starts before the deadline
+    if (control.Check())
+      return;
 
+    // Find matching literal IDs
+    LiteralDictionary *dict = (LiteralDictionary*)(hdt->getDictionary());
     uint32_t* literalIds = NULL;
+    uint32_t literalCount = 0;
+    // The literal index itself only addresses 32-bit offsets and limits
+    totalCount = dict->substringToId((unsigned char*)query.c_str(), query.length(),
+                                     (uint32_t)std::min<uint64_t>(offset, UINT32_MAX),
+                                     (uint32_t)std::min<uint64_t>(limit, UINT32_MAX),
+                                     false, &literalIds, &literalCount);
+    hasExactCount = true;
+
+    // Convert the literal IDs to strings
+    TermCache* termCache = document->GetTermCache();
     try {
-      // Find matching literal IDs
-      LiteralDictionary *dict = (LiteralDictionary*)(document->GetHDT()->getDictionary());
-      uint32_t literalCount = 0;
-      totalCount = dict->substringToId((unsigned char*)substring.c_str(), substring.length(),
-                                       offset, limit, false, &literalIds, &literalCount);
-
-      // Convert the literal IDs to strings
-      for (uint32_t *id = literalIds, *end = literalIds + literalCount; id != end; id++) {
-        string literal(dict->idToString(*id, OBJECT));
-        literals.push_back(fromHdtLiteral(literal));
-      }
+      for (uint32_t *id = literalIds, *end = literalIds + literalCount; id != end && !control.ShouldStop(); id++)
+        literals.push_back(termCache->Decode(dict, *id, OBJECT));
     }
-    catch (const runtime_error error) { SetErrorMessage(error.what()); }
-    if (literalIds)
+    catch (...) {
       delete[] literalIds;
+      throw;
+    }
+    delete[] literalIds;
   }
 
   void HandleOKCallback() {
     Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
     // Convert the literals into a JavaScript array
     uint32_t count = 0;
     Local<Array> literalsArray = Nan::New<Array>(literals.size());
     for (vector<string>::const_iterator it = literals.begin(); it != literals.end(); it++)
       Nan::Set(literalsArray, count++, Nan::New(*it).ToLocalChecked());
 
-    // Send the JavaScript array and estimated total count through the callback
-    const unsigned argc = 4;
+    // Send the JavaScript array, total count, whether that count is exact,
+    // whether the result is incomplete because of the deadline, and the ID of the last literal through the callback
+    const unsigned argc = 6;
     Local<Value> argv[argc] = { Nan::Null(), literalsArray,
-                                Nan::New<Integer>((uint32_t)totalCount),
-                                Nan::New<Boolean>(true) };
+                                Nan::New<Number>((double)totalCount),
+                                Nan::New<Boolean>(hasExactCount),
+                                Nan::New<Boolean>(control.HasTimedOut()),
+                                Nan::New<Number>((double)lastId) };
     callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
   }
 
@@ -303,53 +1982,89 @@ public:
   }
 };
 
-// Searches for a triple pattern in the document.
-// JavaScript signature: HdtDocument#_searchLiterals(substring, offset, limit, callback)
+// Searches for literals in the document.
+// JavaScript signature: HdtDocument#_searchLiterals(query, mode, offset, limit, afterId,
+//                                                   queryId, timeoutMs, callback)
 NAN_METHOD(HdtDocument::SearchLiterals) {
-  assert(info.Length() == 4);
-  Nan::AsyncQueueWorker(new SearchLiteralsWorker(Unwrap<HdtDocument>(info.This()),
-    *Nan::Utf8String(info[0]),
-    Nan::To<uint32_t>(info[1]).FromJust(), Nan::To<uint32_t>(info[2]).FromJust(),
-    new Nan::Callback(info[3].As<Function>()), info.This()));
+  assert(info.Length() == 8);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new SearchLiteralsWorker(document,
+    *Nan::Utf8String(info[0]), Nan::To<uint32_t>(info[1]).FromJust(),
+    toUint64(info[2]), toUint64(info[3]), toUint64(info[4]),
+    Nan::To<uint32_t>(info[5]).FromJust(), Nan::To<uint32_t>(info[6]).FromJust(),
+    new Nan::Callback(info[7].As<Function>()), info.This()), NormalPriority);
 }
 
 /******** HdtDocument#_searchTerms ********/
 
 class SearchTermsWorker : public Nan::AsyncWorker {
   HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
   // JavaScript function arguments
-  string base;
-  uint32_t limit;
+  string prefix;
+  uint64_t offset, limit;
   hdt::TripleComponentRole position;
   // Callback return values
-  vector<string> suggestions;
+  vector<string> terms;
+  PrefixRange range;
+
 public:
-  SearchTermsWorker(HdtDocument* document, char* base, uint32_t limit, uint32_t posId,
+  SearchTermsWorker(HdtDocument* document, char* prefix, uint64_t offset, uint64_t limit, uint32_t posId,
                     Nan::Callback* callback, Local<Object> self)
-    : Nan::AsyncWorker(callback),
-      document(document), base(base), limit(limit), position((TripleComponentRole) posId) {
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), SearchTermsOperation),
+      prefix(prefix), offset(offset), limit(limit), position((TripleComponentRole) posId) {
     SaveToPersistent(SELF, self);
   };
 
   void Execute() {
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
     try {
-      Dictionary* dict = document->GetHDT()->getDictionary();
-      dict->getSuggestions(base.c_str(), position, suggestions, limit);
+      // Find the ID ranges of the prefix, which successive keystrokes and pages often share
+      Dictionary* dict = hdt->getDictionary();
+      PrefixCache* prefixCache = document->GetPrefixCache();
+      const string key = string(1, '0' + position) + prefix;
+      if (!prefixCache->Get(key, range)) {
+        range.Find(dict, prefix, position);
+        prefixCache->Put(key, range, key.size() + sizeof(range));
+      }
+
+      // Decode only the requested slice
+      vector<uint64_t> ids;
+      range.Slice(dict, position, offset, limit, ids);
+      TermCache* termCache = document->GetTermCache();
+      for (size_t i = 0; i < ids.size(); i++)
+        terms.push_back(termCache->Decode(dict, ids[i], position));
     }
     catch (const runtime_error error) { SetErrorMessage(error.what()); }
   }
 
   void HandleOKCallback() {
     Nan::HandleScope scope;
-    // Convert the suggestions into a JavaScript array
+    MetricsTimer timer(metrics, CallbackPhase);
+    // Convert the non-empty ID ranges into a JavaScript array of [first, end) pairs
+    const IdRange ranges[] = { range.literals, range.shared, range.terms };
     uint32_t count = 0;
-    Local<Array> suggestionsArray = Nan::New<Array>(suggestions.size());
-    for (vector<string>::const_iterator it = suggestions.begin(); it != suggestions.end(); it++)
-      Nan::Set(suggestionsArray, count++, Nan::New(*it).ToLocalChecked());
+    Local<Array> rangesArray = Nan::New<Array>();
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+      if (ranges[i].Size()) {
+        Local<Array> idRange = Nan::New<Array>(2);
+        Nan::Set(idRange, 0, Nan::New<Number>((double)ranges[i].first));
+        Nan::Set(idRange, 1, Nan::New<Number>((double)ranges[i].end));
+        Nan::Set(rangesArray, count++, idRange);
+      }
+    }
 
-    // Send the JavaScript array and estimated total count through the callback
-    const unsigned argc = 2;
-    Local<Value> argv[argc] = { Nan::Null(), suggestionsArray};
+    // Send the terms, exact total count, and ID ranges through the callback
+    const unsigned argc = 4;
+    Local<Value> argv[argc] = { Nan::Null(), toStringArray(terms),
+                                Nan::New<Number>((double)range.Count()), rangesArray };
     callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
   }
 
@@ -360,32 +2075,39 @@ public:
   }
 };
 
-// Searches terms based on a given string over a specific position.
-// JavaScript signature: HdtDocument#_searchTerms(prefix, limit, position, callback)
+// Searches terms that start with a given prefix in a specific position.
+// JavaScript signature: HdtDocument#_searchTerms(prefix, offset, limit, position, callback)
 NAN_METHOD(HdtDocument::SearchTerms) {
-  assert(info.Length() == 4);
-  Nan::AsyncQueueWorker(new SearchTermsWorker(Unwrap<HdtDocument>(info.This()),
-    *Nan::Utf8String(info[0]), Nan::To<uint32_t>(info[1]).FromJust(), Nan::To<uint32_t>(info[2]).FromJust(),
-    new Nan::Callback(info[3].As<Function>()), info.This()));
+  assert(info.Length() == 5);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new SearchTermsWorker(document,
+    *Nan::Utf8String(info[0]), toUint64(info[1]), toUint64(info[2]),
+    Nan::To<uint32_t>(info[3]).FromJust(),
+    new Nan::Callback(info[4].As<Function>()), info.This()), NormalPriority);
 }
 
 /******** HdtDocument#_readHeader ********/
 
 class ReadHeaderWorker : public Nan::AsyncWorker {
   HdtDocument* document;
+  shared_ptr<HDT> hdt;
   // Callback return values
   string headerString;
 
 public:
   ReadHeaderWorker(HdtDocument* document, Nan::Callback* callback, Local<Object> self)
-    : Nan::AsyncWorker(callback), document(document), headerString("") {
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()), headerString("") {
     SaveToPersistent(SELF, self);
   };
 
   void Execute() {
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
     IteratorTripleString *it = NULL;
     try {
-      Header *header = document->GetHDT()->getHeader();
+      Header *header = hdt->getHeader();
       IteratorTripleString *it = header->search("","","");
 
       // Create header string.
@@ -427,43 +2149,165 @@ public:
 // JavaScript signature: HdtDocument#_readHeader(callback)
 NAN_METHOD(HdtDocument::ReadHeader) {
   assert(info.Length() == 1);
-  Nan::AsyncQueueWorker(new ReadHeaderWorker(Unwrap<HdtDocument>(info.This()),
-    new Nan::Callback(info[0].As<Function>()), info.This()));
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new ReadHeaderWorker(document,
+    new Nan::Callback(info[0].As<Function>()), info.This()), HighPriority);
 }
 
 /******** HdtDocument#_changeHeader ********/
 
+// Copies length bytes at the offset of the input file to the current position of the output file,
+// inside the kernel where possible, which lets file systems with reflinks share the blocks
+static bool copyFileRange(int input, int output, uint64_t offset, uint64_t length) {
+  off_t inputOffset = (off_t)offset;
+#ifdef __linux__
+  while (length) {
+    ssize_t copied = copy_file_range(input, &inputOffset, output, NULL,
+                                     (size_t)std::min(length, COPY_CHUNK_SIZE), 0);
+    if (copied < 0 && errno == EINTR)
+      continue;
+    if (copied <= 0)
+      break;
+    length -= copied;
+  }
+  // Older kernels cannot copy between file systems, but can still avoid copying to user space
+  while (length) {
+    ssize_t copied = sendfile(output, input, &inputOffset, (size_t)std::min(length, COPY_CHUNK_SIZE));
+    if (copied < 0 && errno == EINTR)
+      continue;
+    if (copied <= 0)
+      break;
+    length -= copied;
+  }
+#endif
+  // Otherwise, copy through a buffer
+  string buffer;
+  while (length) {
+    buffer.resize((size_t)std::min(length, COPY_CHUNK_SIZE));
+    ssize_t read = pread(input, &buffer[0], buffer.size(), inputOffset);
+    if (read < 0 && errno == EINTR)
+      continue;
+    if (read <= 0)
+      return false;
+    buffer.resize(read);
+    if (!writeAll(output, buffer))
+      return false;
+    inputOffset += read;
+    length -= read;
+  }
+  return true;
+}
+
+// Copies the range of the input file to a new output file
+static void copyFile(const string& inputFile, const string& outputFile, uint64_t offset, uint64_t length,
+                     const string& prefix = "") {
+  int input = open(inputFile.c_str(), O_RDONLY);
+  if (input < 0)
+    throw runtime_error(strerror(errno));
+  int output = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  bool copied = output >= 0 && writeAll(output, prefix) && copyFileRange(input, output, offset, length);
+  const int error = errno;
+  close(input);
+  if (output >= 0 && close(output))
+    copied = false;
+  if (!copied)
+    throw runtime_error(string("Could not write ") + outputFile + ": " + strerror(error));
+}
+
 class ChangeHeaderWorker : public Nan::AsyncWorker {
   HdtDocument* document;
+  shared_ptr<HDT> hdt;
   // JavaScript function arguments
   string headerString;
   string outputFile;
+  bool copyIndex;
 
 public:
-  ChangeHeaderWorker(HdtDocument* document, string headerString, string outputFile,
-                    Nan::Callback* callback, Local<Object> self)
-    : Nan::AsyncWorker(callback), document(document),
-      headerString(headerString), outputFile(outputFile) {
+  ChangeHeaderWorker(HdtDocument* document, string headerString, string outputFile, bool copyIndex,
+                     Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      headerString(headerString), outputFile(outputFile), copyIndex(copyIndex) {
       SaveToPersistent(SELF, self);
     };
 
   void Execute() {
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
     try {
-      // Get and clear current header.
-      Header *header = document->GetHDT()->getHeader();
-      header->clear();
+      // Overwriting the mapped file would corrupt the document while it is being read
+      const string& filename = document->GetFilename();
+      struct stat source, target;
+      if (!stat(filename.c_str(), &source) && !stat(outputFile.c_str(), &target) &&
+          source.st_dev == target.st_dev && source.st_ino == target.st_ino)
+        throw runtime_error("The output file must differ from the HDT file");
+
+      // Only the header changes, so write it between copies of the other sections of the file;
+      // files with another layout are written anew from a separate instance,
+      // such that the document keeps its header while other threads read it
+      uint64_t headerStart, dictionaryStart;
+      if (!locateHeader(filename, headerStart, dictionaryStart)) {
+        unique_ptr<HDT> copy(HDTManager::mapHDT(filename.c_str()));
+        copy->getHeader()->clear();
+        LoadHeader(copy->getHeader());
+        copy->saveToHDT(outputFile.c_str());
+        return;
+      }
+      PlainHeader header;
+      LoadHeader(&header);
+      ostringstream headerSection(ios::binary);
+      ControlInformation headerInformation;
+      headerInformation.setType(HEADER);
+      header.save(headerSection, headerInformation);
+      const string prefix(readBytes(filename, 0, headerStart) + headerSection.str());
+      const uint64_t fileSize = fileUtil::getSize(filename.c_str());
+      copyFile(filename, outputFile, dictionaryStart, fileSize - dictionaryStart, prefix);
+
+      // The triples do not change, so neither does their index
+      const string indexFile = filename + ".index.v1-1";
+      if (copyIndex && !access(indexFile.c_str(), R_OK))
+        copyFile(indexFile, outputFile + ".index.v1-1", 0, fileUtil::getSize(indexFile.c_str()));
+    }
+    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+  }
 
-      // Replace header.
-      istringstream in(headerString, ios::binary);
-      ControlInformation ci;
-      ci.setFormat(HDTVocabulary::HEADER_NTRIPLES);
-      ci.setUint("length", fileUtil::getSize(in));
-      header->load(in, ci);
+  // Parses the new header from its N-Triples into the given header
+  void LoadHeader(Header* header) {
+    istringstream in(headerString, ios::binary);
+    ControlInformation ci;
+    ci.setFormat(HDTVocabulary::HEADER_NTRIPLES);
+    ci.setUint("length", fileUtil::getSize(in));
+    header->load(in, ci);
+  }
 
-      // Save
-      document->GetHDT()->saveToHDT(outputFile.c_str());
+  // Finds where the header section of the HDT file starts, after the global control information,
+  // and where the dictionary section starts after it, returning false if the file has another layout
+  static bool locateHeader(const string& filename, uint64_t& headerStart, uint64_t& dictionaryStart) {
+    ifstream in(filename.c_str(), ios::binary);
+    ControlInformation ci;
+    try {
+      ci.load(in);
+      if (ci.getType() != GLOBAL)
+        return false;
+      headerStart = in.tellg();
+      ci.clear();
+      ci.load(in);
+      if (ci.getType() != HEADER)
+        return false;
+      dictionaryStart = (uint64_t)in.tellg() + ci.getUint("length");
     }
-    catch (const runtime_error error) { SetErrorMessage(error.what()); }
+    catch (const runtime_error error) { return false; }
+    return in.good() && dictionaryStart <= fileUtil::getSize(filename.c_str());
+  }
+
+  // Reads the given range of the file
+  static string readBytes(const string& filename, uint64_t offset, uint64_t length) {
+    ifstream in(filename.c_str(), ios::binary);
+    string bytes((size_t)length, '\0');
+    if (!in.seekg(offset) || !in.read(&bytes[0], length))
+      throw runtime_error("Could not read " + filename);
+    return bytes;
   }
 
   void HandleOKCallback() {
@@ -480,68 +2324,104 @@ public:
   }
 };
 
-// Replaces the current header with a new one and saves result to a new file.
-// JavaScript signature: HdtDocument#_changeHeader(header, outputFile, callback)
+// Saves the document with a new header to a new file, leaving the header of the document itself unchanged,
+// optionally together with a copy of the index.
+// JavaScript signature: HdtDocument#_changeHeader(header, outputFile, copyIndex, callback)
 NAN_METHOD(HdtDocument::ChangeHeader) {
-  assert(info.Length() == 3);
-
-  Nan::AsyncQueueWorker(new ChangeHeaderWorker(Unwrap<HdtDocument>(info.This()),
-    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]),
-    new Nan::Callback(info[2].As<Function>()), info.This()));
+  assert(info.Length() == 4);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new ChangeHeaderWorker(document,
+    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]), Nan::To<bool>(info[2]).FromJust(),
+    new Nan::Callback(info[3].As<Function>()), info.This()), LowPriority);
 }
 
 /******** HdtDocument#_fetchDistinctTerms ********/
 
 class FetchDistinctTermsWorker : public Nan::AsyncWorker {
   HdtDocument* document;
+  shared_ptr<HDT> hdt;
+  OperationMetrics metrics;
   // JavaScript function arguments
   string subject;
   string object;
-  uint32_t limit;
+  uint64_t limit;
+  TripleComponentRole position;
+  uint32_t queryId;
+  QueryControl control;
   // Callback return values
   vector<string> distinctTerms;
 public:
-  FetchDistinctTermsWorker(HdtDocument* document, char* subject, char* object, uint32_t limit,
-                           uint32_t posId, Nan::Callback* callback, Local<Object> self)
-    : Nan::AsyncWorker(callback), document(document), subject(subject), object(object), limit(limit) {
-    assert(posId == hdt::PREDICATE); // only predicate is supported currently
+  FetchDistinctTermsWorker(HdtDocument* document, char* subject, char* object, uint64_t limit,
+                           uint32_t posId, uint32_t queryId, uint32_t timeoutMs,
+                           Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), document(document), hdt(document->GetHDT()),
+      metrics(document->GetMetrics(), FetchDistinctTermsOperation), subject(subject), object(object),
+      limit(limit), position((TripleComponentRole) posId), queryId(queryId), control(timeoutMs) {
     SaveToPersistent(SELF, self);
+    document->GetQueries()->Register(queryId, &control);
   };
 
+  ~FetchDistinctTermsWorker() {
+    document->GetQueries()->Unregister(queryId);
+  }
+
   void Execute() {
-    hdt::IteratorUCharString *terms = NULL;
+    metrics.Started();
+    MetricsTimer timer(metrics, ExecutePhase);
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    IteratorTripleID* it = NULL;
     try {
-      Dictionary* dict = document->GetHDT()->getDictionary();
-      terms = dict->getPredicates();
-
-      // Iterate over all predicates
-      while (distinctTerms.size() < limit && terms->hasNext()) {
-        const char* predicate = reinterpret_cast<char*>(terms->next());
+      // If the subject or object does not exist, there are no terms
+      Dictionary* dict = hdt->getDictionary();
+      TripleID pattern;
+      if (!toTripleID(dict, subject, "", object, pattern))
+        return;
 
-        // Check whether a triple with this predicate and subject or object exists
-        hdt::IteratorTripleString *it = document->GetHDT()->search(subject.c_str(), predicate, object.c_str());
-        if (it->hasNext())
-          distinctTerms.push_back(predicate);
-        delete it;
-        delete[] predicate;
+      // Collect the smallest distinct IDs in the position from the adjacency list of the subject or object,
+      // keeping no more than the limit and stopping at the first larger ID if the IDs arrive in order;
+      // if the query stops early, only the IDs found so far are decoded
+      set<size_t> ids;
+      it = hdt->getTriples()->search(pattern);
+      const bool sorted = it->isSorted(position);
+      control.Check();
+      while (it->hasNext() && !control.ShouldStop()) {
+        const size_t id = getComponent(*it->next(), position);
+        if (ids.size() >= limit && (ids.empty() || id > *ids.rbegin())) {
+          if (sorted)
+            break;
+        }
+        else if (ids.insert(id).second && ids.size() > limit) {
+          ids.erase(--ids.end());
+        }
       }
+      if (control.IsCancelled())
+        throw runtime_error(ABORTED_ERROR);
+
+      // Decode the first IDs in dictionary order
+      TermCache* termCache = document->GetTermCache();
+      for (set<size_t>::const_iterator id = ids.begin(); id != ids.end() && distinctTerms.size() < limit; id++)
+        distinctTerms.push_back(termCache->Decode(dict, *id, position));
     }
     catch (const runtime_error error) { SetErrorMessage(error.what()); }
-    if (terms)
-      delete terms;
+    if (it)
+      delete it;
   }
 
   void HandleOKCallback() {
     Nan::HandleScope scope;
+    MetricsTimer timer(metrics, CallbackPhase);
     // Convert the distinctTerms into a JavaScript array
     uint32_t count = 0;
     Local<Array> distinctTermsArray = Nan::New<Array>(distinctTerms.size());
     for (vector<string>::const_iterator it = distinctTerms.begin(); it != distinctTerms.end(); it++)
       Nan::Set(distinctTermsArray, count++, Nan::New(*it).ToLocalChecked());
 
-    // Send the JavaScript array through the callback
-    const unsigned argc = 2;
-    Local<Value> argv[argc] = { Nan::Null(), distinctTermsArray};
+    // Send the JavaScript array, and whether it is incomplete because of the deadline, through the callback
+    const unsigned argc = 3;
+    Local<Value> argv[argc] = { Nan::Null(), distinctTermsArray, Nan::New<Boolean>(control.HasTimedOut()) };
     callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
   }
 
@@ -552,13 +2432,28 @@ public:
   }
 };
 
-// Fetches distinct list of predicates given an object.
-// JavaScript signature: HdtDocument#_fetchDistinctTerms(object, limit, position, callback)
+// Fetches the distinct terms in the given position of triples with the given subject and/or object.
+// JavaScript signature: HdtDocument#_fetchDistinctTerms(subject, object, limit, position, queryId, timeoutMs, callback)
 NAN_METHOD(HdtDocument::FetchDistinctTerms) {
-  assert(info.Length() == 5);
-  Nan::AsyncQueueWorker(new FetchDistinctTermsWorker(Unwrap<HdtDocument>(info.This()),
-    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]), Nan::To<uint32_t>(info[2]).FromJust(), Nan::To<uint32_t>(info[3]).FromJust(),
-    new Nan::Callback(info[4].As<Function>()), info.This()));
+  assert(info.Length() == 7);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->QueueWorker(new FetchDistinctTermsWorker(document,
+    *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]), toUint64(info[2]), Nan::To<uint32_t>(info[3]).FromJust(),
+    Nan::To<uint32_t>(info[4]).FromJust(), Nan::To<uint32_t>(info[5]).FromJust(),
+    new Nan::Callback(info[6].As<Function>()), info.This()), NormalPriority);
+}
+
+
+
+/******** HdtDocument#_cancelQuery ********/
+
+
+// Cancels the running query with the given ID, which then stops at its next check.
+// JavaScript signature: HdtDocument#_cancelQuery(queryId)
+NAN_METHOD(HdtDocument::CancelQuery) {
+  assert(info.Length() == 1);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  document->queries.Cancel(Nan::To<uint32_t>(info[0]).FromJust());
 }
 
 /******** HdtDocument#features ********/
@@ -567,7 +2462,221 @@ NAN_METHOD(HdtDocument::FetchDistinctTerms) {
 // Gets a bitvector indicating the supported features.
 NAN_PROPERTY_GETTER(HdtDocument::Features) {
   HdtDocument* hdtDocument = Unwrap<HdtDocument>(info.This());
-  info.GetReturnValue().Set(Nan::New<Integer>(hdtDocument->features));
+  // A literal index adds literal search to any dictionary
+  int features = hdtDocument->features | (hdtDocument->GetLiteralIndex() ? LiteralSearch : 0);
+  info.GetReturnValue().Set(Nan::New<Integer>(features));
+}
+
+
+
+/******** HdtDocument#_idRanges ********/
+
+
+// Gets the number of shared subject/objects and the highest subject, predicate, and object IDs.
+NAN_PROPERTY_GETTER(HdtDocument::IdRanges) {
+  HdtDocument* hdtDocument = Unwrap<HdtDocument>(info.This());
+  if (!hdtDocument->hdt)
+    return;
+  Dictionary* dict = hdtDocument->hdt->getDictionary();
+  Local<Object> idRanges = Nan::New<Object>();
+  Nan::Set(idRanges, Nan::New("shared").ToLocalChecked(), Nan::New<Number>((double)dict->getNshared()));
+  Nan::Set(idRanges, Nan::New("subject").ToLocalChecked(), Nan::New<Number>((double)dict->getMaxSubjectID()));
+  Nan::Set(idRanges, Nan::New("predicate").ToLocalChecked(), Nan::New<Number>((double)dict->getMaxPredicateID()));
+  Nan::Set(idRanges, Nan::New("object").ToLocalChecked(), Nan::New<Number>((double)dict->getMaxObjectID()));
+  info.GetReturnValue().Set(idRanges);
+}
+
+
+
+/******** HdtDocument#termCacheStats ********/
+
+
+// Gets the statistics of the cache of decoded terms.
+NAN_PROPERTY_GETTER(HdtDocument::TermCacheStats) {
+  HdtDocument* hdtDocument = Unwrap<HdtDocument>(info.This());
+  info.GetReturnValue().Set(toStatsObject(hdtDocument->termCache.GetStats()));
+}
+
+
+
+/******** HdtDocument#pageCacheStats ********/
+
+
+// Gets the statistics of the cache of search results.
+NAN_PROPERTY_GETTER(HdtDocument::PageCacheStats) {
+  HdtDocument* hdtDocument = Unwrap<HdtDocument>(info.This());
+  info.GetReturnValue().Set(toStatsObject(hdtDocument->pageCache.GetStats()));
+}
+
+
+
+/******** HdtDocument#_stats ********/
+
+// Names of the operations, phases, and counters in JavaScript
+static const char* const OPERATION_NAMES[METRICS_OPERATION_COUNT] = {
+  "searchTriples", "searchTriplesBatch", "exportTo", "searchTriplesCursor", "searchTripleIds",
+  "termsToIds", "idsToTerms", "evaluateBGP", "searchLiterals", "searchTerms", "fetchDistinctTerms",
+};
+static const char* const PHASE_NAMES[METRICS_PHASE_COUNT] = {
+  "queue", "resolve", "skip", "decode", "execute", "callback",
+};
+static const char* const COUNTER_NAMES[METRICS_COUNTER_COUNT] = {
+  "triplesScanned", "triplesReturned", "termsDecoded", "bytesAllocated",
+};
+
+// Converts the histogram into a JavaScript object with its count and latencies in microseconds
+static Local<Object> toLatencyObject(const LatencyHistogram& histogram) {
+  Local<Object> latencies = Nan::New<Object>();
+  const uint64_t count = histogram.Count();
+  Nan::Set(latencies, Nan::New("count").ToLocalChecked(), Nan::New<Number>((double)count));
+  Nan::Set(latencies, Nan::New("mean").ToLocalChecked(), Nan::New<Number>((double)histogram.Sum() / count));
+  Nan::Set(latencies, Nan::New("p50").ToLocalChecked(), Nan::New<Number>((double)histogram.Percentile(0.5)));
+  Nan::Set(latencies, Nan::New("p90").ToLocalChecked(), Nan::New<Number>((double)histogram.Percentile(0.9)));
+  Nan::Set(latencies, Nan::New("p99").ToLocalChecked(), Nan::New<Number>((double)histogram.Percentile(0.99)));
+  Nan::Set(latencies, Nan::New("max").ToLocalChecked(), Nan::New<Number>((double)histogram.Max()));
+  return latencies;
+}
+
+// Gets the latencies of the phases of all operations that ran and the counters of the document,
+// and clears them afterwards if requested.
+// JavaScript signature: HdtDocument#_stats(reset)
+NAN_METHOD(HdtDocument::Stats) {
+  assert(info.Length() == 1);
+  HdtDocument* hdtDocument = Unwrap<HdtDocument>(info.This());
+  const DocumentMetrics& metrics = hdtDocument->metrics;
+
+  // Only list operations and phases that occurred
+  Local<Object> operations = Nan::New<Object>();
+  for (int operation = 0; operation < METRICS_OPERATION_COUNT; operation++) {
+    Local<Object> phases = Nan::New<Object>();
+    bool hasPhases = false;
+    for (int phase = 0; phase < METRICS_PHASE_COUNT; phase++) {
+      const LatencyHistogram& histogram = metrics.GetLatencies((MetricsOperation)operation, (MetricsPhase)phase);
+      if (histogram.Count()) {
+        Nan::Set(phases, Nan::New(PHASE_NAMES[phase]).ToLocalChecked(), toLatencyObject(histogram));
+        hasPhases = true;
+      }
+    }
+    if (hasPhases)
+      Nan::Set(operations, Nan::New(OPERATION_NAMES[operation]).ToLocalChecked(), phases);
+  }
+  Local<Object> counters = Nan::New<Object>();
+  for (int counter = 0; counter < METRICS_COUNTER_COUNT; counter++)
+    Nan::Set(counters, Nan::New(COUNTER_NAMES[counter]).ToLocalChecked(),
+             Nan::New<Number>((double)metrics.GetCounter((MetricsCounter)counter)));
+
+  Local<Object> stats = Nan::New<Object>();
+  Nan::Set(stats, Nan::New("operations").ToLocalChecked(), operations);
+  Nan::Set(stats, Nan::New("counters").ToLocalChecked(), counters);
+  if (Nan::To<bool>(info[0]).FromJust())
+    hdtDocument->metrics.Reset();
+  info.GetReturnValue().Set(stats);
+}
+
+
+
+/******** HdtDocument#_setMemoryPolicy ********/
+
+class MemoryPolicyWorker : public Nan::AsyncWorker {
+  shared_ptr<HDT> hdt;
+  shared_ptr<HdtMemory> memory;
+  // JavaScript function arguments
+  vector<int> advice;
+  bool hugePages;
+  vector<int> lockSections, prefetchSections;
+  // Callback return values
+  bool prefetched;
+
+public:
+  MemoryPolicyWorker(HdtDocument* document, const vector<int>& advice, bool hugePages,
+                     const vector<int>& lockSections, const vector<int>& prefetchSections,
+                     Nan::Callback* callback, Local<Object> self)
+    : Nan::AsyncWorker(callback), hdt(document->GetHDT()), memory(document->GetMemory()),
+      advice(advice), hugePages(hugePages), lockSections(lockSections), prefetchSections(prefetchSections),
+      prefetched(true) {
+    SaveToPersistent(SELF, self);
+  };
+
+  void Execute() {
+    if (!hdt) {
+      SetErrorMessage(CLOSED_ERROR);
+      return;
+    }
+    // The HDT is held while advising, such that libhdt's mappings cannot disappear in the meantime
+    for (size_t section = 0; section < advice.size(); section++) {
+      if (advice[section] >= 0)
+        memory->Advise((MemorySection)section, (MemoryAdvice)advice[section], hugePages);
+    }
+    // Sections that cannot be locked are reported as unlocked
+    for (size_t i = 0; i < lockSections.size(); i++)
+      memory->Lock((MemorySection)lockSections[i]);
+    for (size_t i = 0; i < prefetchSections.size() && prefetched; i++)
+      prefetched = memory->Prefetch((MemorySection)prefetchSections[i]);
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    // Send whether all sections were prefetched before the document was closed
+    const unsigned argc = 2;
+    Local<Value> argv[argc] = { Nan::Null(), Nan::New<Boolean>(prefetched) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), argc, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+    Local<Value> argv[] = { Exception::Error(Nan::New(ErrorMessage()).ToLocalChecked()) };
+    callback->Call(Nan::To<v8::Object>(GetFromPersistent(SELF)).ToLocalChecked(), 1, argv, async_resource);
+  }
+};
+
+// Converts a JavaScript array of numbers into a vector of integers
+static vector<int> toIntVector(const Local<Value>& value) {
+  Local<Array> array = value.As<Array>();
+  vector<int> values(array->Length());
+  for (uint32_t i = 0; i < values.size(); i++)
+    values[i] = Nan::To<int32_t>(Nan::Get(array, i).ToLocalChecked()).FromJust();
+  return values;
+}
+
+// Applies access patterns to the sections of the document's files, locks sections in memory,
+// and reads sections into memory in the given order, on a thread of the document's own.
+// JavaScript signature: HdtDocument#_setMemoryPolicy(advice, hugePages, lock, prefetch, callback)
+NAN_METHOD(HdtDocument::SetMemoryPolicy) {
+  assert(info.Length() == 5);
+  HdtDocument* document = Unwrap<HdtDocument>(info.This());
+  if (!document->prefetcher)
+    document->prefetcher.reset(new QueryExecutor(1));
+  document->prefetcher->Queue(new MemoryPolicyWorker(document, toIntVector(info[0]),
+    Nan::To<bool>(info[1]).FromJust(), toIntVector(info[2]), toIntVector(info[3]),
+    new Nan::Callback(info[4].As<Function>()), info.This()), LowPriority);
+}
+
+
+
+/******** HdtDocument#_memory ********/
+
+// Names of the sections in JavaScript
+static const char* const MEMORY_SECTION_NAMES[MEMORY_SECTION_COUNT] = {
+  "header", "dictionary", "triples", "index",
+};
+
+// Gets the number of mapped and resident bytes of every section of the document's files.
+// JavaScript signature: HdtDocument#_memory()
+NAN_METHOD(HdtDocument::Memory) {
+  HdtDocument* hdtDocument = Unwrap<HdtDocument>(info.This());
+  // Closed documents that did not map their files, or shared their mappings, no longer map anything
+  const shared_ptr<HdtMemory> memory = hdtDocument->GetMemory();
+  const MemorySectionStats unmapped = { 0, 0, false };
+  Local<Object> sections = Nan::New<Object>();
+  for (int section = 0; section < MEMORY_SECTION_COUNT; section++) {
+    const MemorySectionStats stats = memory ? memory->GetStats((MemorySection)section) : unmapped;
+    Local<Object> sectionObject = Nan::New<Object>();
+    Nan::Set(sectionObject, Nan::New("mapped").ToLocalChecked(), Nan::New<Number>((double)stats.mapped));
+    Nan::Set(sectionObject, Nan::New("resident").ToLocalChecked(), Nan::New<Number>((double)stats.resident));
+    Nan::Set(sectionObject, Nan::New("locked").ToLocalChecked(), Nan::New<Boolean>(stats.locked));
+    Nan::Set(sections, Nan::New(MEMORY_SECTION_NAMES[section]).ToLocalChecked(), sectionObject);
+  }
+  info.GetReturnValue().Set(sections);
 }
 
 
@@ -606,6 +2715,159 @@ NAN_PROPERTY_GETTER(HdtDocument::Closed) {
 /******** Utility functions ********/
 
 
+// Decodes the term with the given ID in the given position,
+// converting objects into JavaScript literals
+string TermCache::Decode(Dictionary* dict, size_t id, TripleComponentRole role) {
+  // Terms are cached per position, since positions have different ID spaces
+  const uint64_t key = (uint64_t)id << 2 | role;
+  string term;
+  if (!Get(key, term)) {
+    term = dict->idToString(id, role);
+    if (role == OBJECT)
+      fromHdtLiteral(term);
+    Put(key, term, sizeof(key) + term.capacity());
+    if (metrics) {
+      metrics->Add(TermsDecoded, 1);
+      metrics->Add(BytesAllocated, term.capacity());
+    }
+  }
+  return term;
+}
+
+// Reads at most limit triples from the iterator and decodes their components,
+// stopping early if the query control says so
+void TriplePage::Read(IteratorTripleID* it, Dictionary* dict, TermCache* termCache, uint64_t limit,
+                      QueryControl* control) {
+  while (it->hasNext() && triples.size() < limit && !(control && control->ShouldStop()))
+    Add(*it->next(), dict, termCache);
+}
+
+// Adds the triple to the page and decodes its components
+void TriplePage::Add(TripleID& triple, Dictionary* dict, TermCache* termCache) {
+  triples.push_back(triple);
+  if (!subjects.count(triple.getSubject())) {
+    subjects[triple.getSubject()] = termCache->Decode(dict, triple.getSubject(), SUBJECT);
+  }
+  if (!predicates.count(triple.getPredicate())) {
+    predicates[triple.getPredicate()] = termCache->Decode(dict, triple.getPredicate(), PREDICATE);
+  }
+  if (!objects.count(triple.getObject())) {
+    objects[triple.getObject()] = termCache->Decode(dict, triple.getObject(), OBJECT);
+  }
+}
+
+// Converts the triples into a JavaScript array of triple objects
+Local<Array> TriplePage::ToArray() const {
+  // Convert the triple components into strings
+  map<size_t, string>::const_iterator it;
+  map<size_t, Local<String> > subjectStrings, predicateStrings, objectStrings;
+  for (it = subjects.begin(); it != subjects.end(); it++)
+    subjectStrings[it->first] = Nan::New(it->second.c_str()).ToLocalChecked();
+  for (it = predicates.begin(); it != predicates.end(); it++)
+    predicateStrings[it->first] = Nan::New(it->second.c_str()).ToLocalChecked();
+  for (it = objects.begin(); it != objects.end(); it++)
+    objectStrings[it->first] = Nan::New(it->second.c_str()).ToLocalChecked();
+
+  // Convert the triples into a JavaScript object array
+  uint32_t count = 0;
+  Local<Array> triplesArray = Nan::New<Array>(triples.size());
+  const Local<String> SUBJECT   = Nan::New("subject").ToLocalChecked();
+  const Local<String> PREDICATE = Nan::New("predicate").ToLocalChecked();
+  const Local<String> OBJECT    = Nan::New("object").ToLocalChecked();
+  for (vector<TripleID>::const_iterator it = triples.begin(); it != triples.end(); it++) {
+    Local<Object> tripleObject = Nan::New<Object>();
+    Nan::Set(tripleObject, SUBJECT, subjectStrings[it->getSubject()]);
+    Nan::Set(tripleObject, PREDICATE, predicateStrings[it->getPredicate()]);
+    Nan::Set(tripleObject, OBJECT, objectStrings[it->getObject()]);
+    Nan::Set(triplesArray, count++, tripleObject);
+  }
+  return triplesArray;
+}
+
+
+// Returns the position of the term with the given ID in the column,
+// decoding and appending the term if it does not occur yet
+static uint32_t toColumnIndex(unordered_map<size_t, uint32_t>& positions, vector<string>& column,
+                              Dictionary* dict, TermCache* termCache, size_t id, TripleComponentRole role) {
+  unordered_map<size_t, uint32_t>::const_iterator position = positions.find(id);
+  if (position != positions.end())
+    return position->second;
+  column.push_back(termCache->Decode(dict, id, role));
+  return positions[id] = column.size() - 1;
+}
+
+// Reads at most limit triples from the iterator and decodes their components,
+// stopping early if the query control says so
+void TripleColumns::Read(IteratorTripleID* it, Dictionary* dict, TermCache* termCache, uint64_t limit,
+                         QueryControl* control) {
+  unordered_map<size_t, uint32_t> subjectPositions, predicatePositions, objectPositions;
+  for (uint64_t count = 0; count < limit && it->hasNext() && !(control && control->ShouldStop()); count++) {
+    TripleID& triple = *it->next();
+    ids.push_back(toColumnIndex(subjectPositions, subjects, dict, termCache, triple.getSubject(), SUBJECT));
+    ids.push_back(toColumnIndex(predicatePositions, predicates, dict, termCache, triple.getPredicate(), PREDICATE));
+    ids.push_back(toColumnIndex(objectPositions, objects, dict, termCache, triple.getObject(), OBJECT));
+  }
+}
+
+// Converts a vector of strings into a JavaScript array
+static Local<Array> toStringArray(const vector<string>& strings) {
+  uint32_t count = 0;
+  Local<Array> stringsArray = Nan::New<Array>(strings.size());
+  for (vector<string>::const_iterator it = strings.begin(); it != strings.end(); it++)
+    Nan::Set(stringsArray, count++, Nan::New(*it).ToLocalChecked());
+  return stringsArray;
+}
+
+// Copies a vector of unsigned integers into a JavaScript typed array
+static Local<Uint32Array> toUint32Array(const vector<uint32_t>& values) {
+  // Nan cannot create typed arrays, but it does provide access to their contents
+  size_t byteLength = values.size() * sizeof(uint32_t);
+  Local<Uint32Array> array = Uint32Array::New(ArrayBuffer::New(Isolate::GetCurrent(), byteLength), 0, values.size());
+  Nan::TypedArrayContents<uint32_t> contents(array);
+  if (byteLength)
+    memcpy(*contents, values.data(), byteLength);
+  return array;
+}
+
+// Returns the approximate number of bytes the result takes up
+size_t SearchTriplesResult::Bytes() const {
+  // Count the strings and an estimate of the per-entry overhead of their containers
+  size_t bytes = sizeof(*this) + page.triples.size() * sizeof(TripleID) + columns.ids.size() * sizeof(uint32_t);
+  const map<size_t, string>* maps[] = { &page.subjects, &page.predicates, &page.objects };
+  for (int i = 0; i < 3; i++)
+    for (map<size_t, string>::const_iterator it = maps[i]->begin(); it != maps[i]->end(); it++)
+      bytes += 64 + it->second.capacity();
+  const vector<string>* columnsStrings[] = { &columns.subjects, &columns.predicates, &columns.objects };
+  for (int i = 0; i < 3; i++)
+    for (vector<string>::const_iterator it = columnsStrings[i]->begin(); it != columnsStrings[i]->end(); it++)
+      bytes += sizeof(string) + it->capacity();
+  return bytes;
+}
+
+// Converts cache statistics into a JavaScript object
+static Local<Object> toStatsObject(const LruCacheStats& stats) {
+  Local<Object> statsObject = Nan::New<Object>();
+  Nan::Set(statsObject, Nan::New("hits").ToLocalChecked(), Nan::New<Number>((double)stats.hits));
+  Nan::Set(statsObject, Nan::New("misses").ToLocalChecked(), Nan::New<Number>((double)stats.misses));
+  Nan::Set(statsObject, Nan::New("evictions").ToLocalChecked(), Nan::New<Number>((double)stats.evictions));
+  Nan::Set(statsObject, Nan::New("oversized").ToLocalChecked(), Nan::New<Number>((double)stats.oversized));
+  Nan::Set(statsObject, Nan::New("entries").ToLocalChecked(), Nan::New<Number>((double)stats.entries));
+  Nan::Set(statsObject, Nan::New("bytes").ToLocalChecked(), Nan::New<Number>((double)stats.bytes));
+  Nan::Set(statsObject, Nan::New("capacity").ToLocalChecked(), Nan::New<Number>((double)stats.capacity));
+  return statsObject;
+}
+
+// Converts the columns into a JavaScript object with a Uint32Array and string tables
+Local<Object> TripleColumns::ToObject() const {
+  Local<Object> columnsObject = Nan::New<Object>();
+  Nan::Set(columnsObject, Nan::New("ids").ToLocalChecked(), toUint32Array(ids));
+  Nan::Set(columnsObject, Nan::New("subjects").ToLocalChecked(), toStringArray(subjects));
+  Nan::Set(columnsObject, Nan::New("predicates").ToLocalChecked(), toStringArray(predicates));
+  Nan::Set(columnsObject, Nan::New("objects").ToLocalChecked(), toStringArray(objects));
+  return columnsObject;
+}
+
+
 // The JavaScript representation for a literal with a datatype is
 //   "literal"^^http://example.org/datatype
 // whereas the HDT representation is
@@ -3,53 +3,218 @@
 
 #include <node.h>
 #include <nan.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 #include <HDTManager.hpp>
+#include "LruCache.h"
+#include "Metrics.h"
+#include "HdtMemory.h"
+#include "HdtRegistry.h"
+#include "PatternStatistics.h"
+#include "LiteralIndex.h"
+#include "PrefixRange.h"
+#include "ContinuationTable.h"
+#include "QueryControl.h"
+#include "QueryExecutor.h"
 
 enum HdtDocumentFeatures {
-  LiteralSearch = 1, // The document supports substring search for literals
+  LiteralSearch = 1, // The document supports search for literals, through its dictionary or a literal index
 };
 
+// A cache of decoded dictionary terms, shared by all operations on a document
+class TermCache : public LruCache<uint64_t, std::string> {
+ public:
+  TermCache(size_t capacity, DocumentMetrics* metrics = NULL)
+    : LruCache<uint64_t, std::string>(capacity), metrics(metrics) { }
+
+  // Decodes the term with the given ID in the given position,
+  // converting objects into JavaScript literals
+  std::string Decode(hdt::Dictionary* dict, size_t id, hdt::TripleComponentRole role);
+
+ private:
+  // Counts the terms that are decoded from the dictionary
+  DocumentMetrics* metrics;
+};
+
+// A page of matching triples, together with the strings of their components
+struct TriplePage {
+  std::vector<hdt::TripleID> triples;
+  std::map<size_t, std::string> subjects, predicates, objects;
+
+  // Reads at most limit triples from the iterator and decodes their components,
+  // stopping early if the query control says so
+  void Read(hdt::IteratorTripleID* it, hdt::Dictionary* dict, TermCache* termCache, uint64_t limit,
+            QueryControl* control = NULL);
+  // Adds the triple to the page and decodes its components
+  void Add(hdt::TripleID& triple, hdt::Dictionary* dict, TermCache* termCache);
+  // Converts the triples into a JavaScript array of triple objects
+  v8::Local<v8::Array> ToArray() const;
+};
+
+// A page of matching triples in columnar form, which lists for every triple
+// the positions of its components in a deduplicated string table per role
+struct TripleColumns {
+  std::vector<uint32_t> ids;
+  std::vector<std::string> subjects, predicates, objects;
+
+  // Reads at most limit triples from the iterator and decodes their components,
+  // stopping early if the query control says so
+  void Read(hdt::IteratorTripleID* it, hdt::Dictionary* dict, TermCache* termCache, uint64_t limit,
+            QueryControl* control = NULL);
+  // Converts the columns into a JavaScript object with a Uint32Array and string tables
+  v8::Local<v8::Object> ToObject() const;
+};
+
+// The result of a triple pattern search, which can be shared through a page cache
+struct SearchTriplesResult {
+  TriplePage page;
+  TripleColumns columns;
+  uint64_t totalCount;
+  bool hasExactCount, hasMore;
+
+  SearchTriplesResult() : totalCount(0), hasExactCount(true), hasMore(false) { }
+  // Returns the number of triples in the result
+  size_t Size() const { return page.triples.size() + columns.ids.size() / 3; }
+  // Returns the approximate number of bytes the result takes up
+  size_t Bytes() const;
+};
+
+// A cache of search results by triple pattern, offset, limit, and format
+typedef LruCache<std::string, std::shared_ptr<const SearchTriplesResult> > PageCache;
+
+// A cache of the ID ranges of recently searched term prefixes, by position and prefix
+typedef LruCache<std::string, PrefixRange> PrefixCache;
+
 class HdtDocument : public node::ObjectWrap {
  public:
-  HdtDocument(const v8::Local<v8::Object>& handle, hdt::HDT* hdt);
+  HdtDocument(const v8::Local<v8::Object>& handle, const std::string& filename,
+              const std::shared_ptr<MappedHdt>& mapped, bool shared,
+              size_t termCacheSize, size_t pageCacheSize, size_t threadCount);
 
-  // createHdtDocument(filename, callback)
+  // createHdtDocument(filename, options, callback)
   static NAN_METHOD(Create);
+  // generateHdtDocument(inputFile, outputFile, baseIri, lowMemory, progressCallback, callback)
+  static NAN_METHOD(Generate);
+  // searchHdtUnion(documents, subject, predicate, object, offset, limit, deduplicate, threads, callback)
+  static NAN_METHOD(SearchUnion);
   static const Nan::Persistent<v8::Function>& GetConstructor();
 
   // Accessors
-  hdt::HDT* GetHDT() { return hdt; }
+  const std::string& GetFilename() { return filename; }
+  std::shared_ptr<hdt::HDT> GetHDT() { return hdt; }
+  TermCache* GetTermCache() { return &termCache; }
+  PageCache* GetPageCache() { return &pageCache; }
+  PrefixCache* GetPrefixCache() { return &prefixCache; }
+  DocumentMetrics* GetMetrics() { return &metrics; }
+  // Returns the mappings that control the residency of the document's files, creating them if needed;
+  // must be called from the JavaScript thread
+  std::shared_ptr<HdtMemory> GetMemory();
+  ContinuationTable* GetContinuations() { return &continuations; }
+  QueryRegistry* GetQueries() { return &queries; }
+  const PatternStatistics* GetStatistics() { return statistics; }
+  const LiteralIndex* GetLiteralIndex() { return literalIndex; }
   bool Supports(HdtDocumentFeatures feature) { return features & (int)feature; }
 
+  // Queues the worker on the document's own threads, or on libuv's thread pool if it has none
+  void QueueWorker(Nan::AsyncWorker* worker, QueryPriority priority);
+  // Replaces the HDT by the same HDT with its index once that has been built in the background,
+  // together with statistics and a literal index if the document has none yet; takes ownership of all
+  void SetIndexedHDT(hdt::HDT* indexedHdt, PatternStatistics* indexedStatistics, LiteralIndex* indexedLiterals);
+
  private:
-  hdt::HDT* hdt;
+  // The file the document was opened from
+  const std::string filename;
+  std::shared_ptr<hdt::HDT> hdt;
+  DocumentMetrics metrics;
+  TermCache termCache;
+  PageCache pageCache;
+  PrefixCache prefixCache;
+  ContinuationTable continuations;
+  QueryRegistry queries;
+  std::unique_ptr<QueryExecutor> executor;
+  // Builds the index in the background, without taking up a thread of libuv's pool
+  std::unique_ptr<QueryExecutor> indexer;
+  // The document's own mappings of its files, created once needed, and the thread that reads them into memory
+  std::shared_ptr<HdtMemory> memory;
+  std::unique_ptr<QueryExecutor> prefetcher;
+  // Kept until the document is deleted, since running workers can still read them after closing;
+  // set at most once, possibly while workers are running
+  std::atomic<const PatternStatistics*> statistics;
+  std::atomic<const LiteralIndex*> literalIndex;
   int features;
+  // Whether the HDT and the data derived from it are shared with documents in other threads,
+  // which own them together instead of this document alone
+  bool shared;
+  std::shared_ptr<MappedHdt> mapped;
 
   // Construction and destruction
   ~HdtDocument();
   void Destroy();
   static NAN_METHOD(New);
 
-  // HdtDocument#_searchTriples(subject, predicate, object, offset, limit, callback, self)
+  // HdtDocument#_searchTriples(subject, predicate, object, offset, limit, columnar, continuation,
+  //                            queryId, timeoutMs, callback, self)
   static NAN_METHOD(SearchTriples);
-  // HdtDocument#_searchLiterals(substring, offset, limit, callback, self)
+  // HdtDocument#_searchTriplesBatch(components, ranges, columnar, threads, callback, self)
+  static NAN_METHOD(SearchTriplesBatch);
+  // HdtDocument#_exportTo(filenameOrFd, threads, callback, self)
+  static NAN_METHOD(ExportTo);
+  // HdtDocument#_searchTriplesCursor(subject, predicate, object, offset, limit, callback, self)
+  static NAN_METHOD(SearchTriplesCursor);
+  // HdtDocument#_searchTripleIds(subject, predicate, object, offset, limit, callback, self)
+  static NAN_METHOD(SearchTripleIds);
+  // HdtDocument#_termsToIds(terms, position, callback, self)
+  static NAN_METHOD(TermsToIds);
+  // HdtDocument#_idsToTerms(ids, position, callback, self)
+  static NAN_METHOD(IdsToTerms);
+  // HdtDocument#_evaluateBGP(components, offset, limit, callback, self)
+  static NAN_METHOD(EvaluateBGP);
+  // HdtDocument#_searchLiterals(query, mode, offset, limit, afterId, queryId, timeoutMs, callback, self)
   static NAN_METHOD(SearchLiterals);
-  // HdtDocument#_searchTerms(prefix, limit, position, callback)
+  // HdtDocument#_searchTerms(prefix, offset, limit, position, callback, self)
   static NAN_METHOD(SearchTerms);
-  // HdtDocument#_fetchDistinctTerms(subject, object, limit, position, callback)
+  // HdtDocument#_fetchDistinctTerms(subject, object, limit, position, queryId, timeoutMs, callback)
   static NAN_METHOD(FetchDistinctTerms);
+  // HdtDocument#_cancelQuery(queryId)
+  static NAN_METHOD(CancelQuery);
+  // HdtDocument#_buildIndex(filename, statistics, literalIndex, progressCallback, callback, self)
+  static NAN_METHOD(BuildIndex);
   // HdtDocument#_readHeader(callback, self)
   static NAN_METHOD(ReadHeader);
-  // HdtDocument#_changeHeader(headerString, outputFile, callback, self)
+  // HdtDocument#_changeHeader(headerString, outputFile, copyIndex, callback, self)
   static NAN_METHOD(ChangeHeader);
   // HdtDocument#_features
   static NAN_PROPERTY_GETTER(Features);
+  // HdtDocument#_idRanges
+  static NAN_PROPERTY_GETTER(IdRanges);
+  // HdtDocument#termCacheStats
+  static NAN_PROPERTY_GETTER(TermCacheStats);
+  // HdtDocument#pageCacheStats
+  static NAN_PROPERTY_GETTER(PageCacheStats);
+  // HdtDocument#_stats(reset)
+  static NAN_METHOD(Stats);
+  // HdtDocument#_setMemoryPolicy(advice, hugePages, lock, prefetch, callback, self)
+  static NAN_METHOD(SetMemoryPolicy);
+  // HdtDocument#_memory()
+  static NAN_METHOD(Memory);
   // HdtDocument#close([callback], [self])
   static NAN_METHOD(Close);
   // HdtDocument#closed
   static NAN_PROPERTY_GETTER(Closed);
 };
 
+// Returns the component of the triple in the given position
+inline size_t getComponent(hdt::TripleID& triple, int position) {
+  switch (position) {
+  case hdt::SUBJECT:   return triple.getSubject();
+  case hdt::PREDICATE: return triple.getPredicate();
+  default:             return triple.getObject();
+  }
+}
+
 // Converts a JavaScript literal to an HDT literal
 std::string& toHdtLiteral(std::string& literal);
 // Converts an HDT literal to a JavaScript literal
@@ -0,0 +1,288 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+#include <algorithm>
+#include <vector>
+#include <HDTManager.hpp>
+#include "HdtMemory.h"
+
+using namespace std;
+using namespace hdt;
+
+// Types of control information in HDT files
+const char GLOBAL_CONTROL_INFORMATION = 1;
+const char HEADER_CONTROL_INFORMATION = 2;
+// Start of the control information of the triples section, including its format
+const char TRIPLES_COOKIE[] = "$HDT\x04<http://purl.org/HDT/hdt#triples";
+// Number of bytes around the estimated start of the triples section that are searched
+const size_t TRIPLES_SEARCH_WINDOW = 1024 * 1024;
+// Number of bytes after which prefetching checks whether it should stop
+const size_t PREFETCH_CHUNK_SIZE = 16 * 1024 * 1024;
+
+#ifdef __APPLE__
+typedef char ResidencyFlag;
+#else
+typedef unsigned char ResidencyFlag;
+#endif
+
+static size_t getPageSize() {
+  static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  return pageSize;
+}
+
+// Extends the range to whole pages, as required by memory calls
+static void alignToPages(char*& start, size_t& length) {
+  char* alignedStart = (char*)((uintptr_t)start & ~(uintptr_t)(getPageSize() - 1));
+  length += start - alignedStart;
+  start = alignedStart;
+}
+
+// Gives the system an access pattern for the range; failures are ignored, since these are only hints
+static void adviseRange(char* start, size_t length, int advice, bool hugePages) {
+  alignToPages(start, length);
+  madvise(start, length, advice);
+#ifdef MADV_HUGEPAGE
+  if (hugePages)
+    madvise(start, length, MADV_HUGEPAGE);
+#endif
+}
+
+// Reads the control information of the given type at the offset, which consists of a cookie, the type,
+// the format and properties as strings, and a checksum; returns the offset after it, or 0 if there is none
+static size_t readControlInformation(const char* data, size_t length, size_t offset, char type,
+                                     string& properties) {
+  if (offset + 5 > length || memcmp(data + offset, "$HDT", 4) || data[offset + 4] != type)
+    return 0;
+  const char* end = data + length;
+  const char* format = data + offset + 5;
+  const char* formatEnd = (const char*)memchr(format, '\0', end - format);
+  if (!formatEnd)
+    return 0;
+  const char* propertiesEnd = (const char*)memchr(formatEnd + 1, '\0', end - formatEnd - 1);
+  if (!propertiesEnd || propertiesEnd + 3 > end)
+    return 0;
+  properties.assign(formatEnd + 1, propertiesEnd);
+  return propertiesEnd + 3 - data;
+}
+
+
+
+/******** Construction and destruction ********/
+
+
+HdtMemory::HdtMemory() : released(false) {
+  for (int section = 0; section < MEMORY_SECTION_COUNT; section++)
+    locked[section] = false;
+}
+
+HdtMemory::~HdtMemory() {
+  Release();
+  if (file.data)
+    munmap(file.data, file.length);
+  if (index.data)
+    munmap(index.data, index.length);
+}
+
+// Maps the HDT file and, if it exists, its index, and locates the sections of the HDT file.
+void HdtMemory::Open(const string& filename, HDT* hdt) {
+  if (Map(filename, file)) {
+    // The header follows the global control information, and its length is one of its properties
+    string properties;
+    size_t dictionaryStart = 0;
+    size_t headerStart = readControlInformation(file.data, file.length, 0, GLOBAL_CONTROL_INFORMATION, properties);
+    size_t headerDataStart = !headerStart ? 0 :
+      readControlInformation(file.data, file.length, headerStart, HEADER_CONTROL_INFORMATION, properties);
+    size_t lengthProperty = properties.find("length=");
+    if (headerDataStart && lengthProperty != string::npos) {
+      dictionaryStart = headerDataStart + strtoull(properties.c_str() + lengthProperty + 7, NULL, 10);
+      dictionaryStart = std::min(dictionaryStart, file.length);
+    }
+    // The triples section is last, so its start follows from its size if its cookie cannot be found
+    const uint64_t triplesSize = hdt->getTriples()->size();
+    size_t triplesStart = FindTriples(file, dictionaryStart, triplesSize);
+    if (!triplesStart)
+      triplesStart = std::max(dictionaryStart, file.length - (size_t)std::min((uint64_t)file.length, triplesSize));
+
+    sections[HeaderSection].mapping = &file;
+    sections[HeaderSection].length = dictionaryStart;
+    sections[DictionarySection].mapping = &file;
+    sections[DictionarySection].offset = dictionaryStart;
+    sections[DictionarySection].length = triplesStart - dictionaryStart;
+    sections[TriplesSection].mapping = &file;
+    sections[TriplesSection].offset = triplesStart;
+    sections[TriplesSection].length = file.length - triplesStart;
+  }
+  OpenIndex(filename);
+}
+
+// Maps the index file once it has been built.
+void HdtMemory::OpenIndex(const string& filename) {
+  Mapping newIndex;
+  if (index.data || !Map(filename + ".index.v1-1", newIndex))
+    return;
+  std::lock_guard<std::mutex> lock(sectionsMutex);
+  index = newIndex;
+  sections[IndexSection].mapping = &index;
+  sections[IndexSection].length = index.length;
+}
+
+// Maps the whole file, returning false if that fails
+bool HdtMemory::Map(const string& filename, Mapping& mapping) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat status;
+  void* data = MAP_FAILED;
+  if (!fstat(fd, &status) && status.st_size > 0)
+    data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  mapping.data = (char*)data;
+  mapping.length = (size_t)status.st_size;
+  mapping.device = status.st_dev;
+  mapping.inode = status.st_ino;
+  return true;
+}
+
+// Returns the offset at which the triples section of the mapped HDT file starts, or 0 if it is not found.
+// The cookie is only searched for around the estimated start, such that the dictionary is never read entirely.
+size_t HdtMemory::FindTriples(const Mapping& mapping, size_t dictionaryStart, uint64_t triplesSize) {
+  const char* cookieEnd = TRIPLES_COOKIE + sizeof(TRIPLES_COOKIE) - 1;
+  const size_t estimate = mapping.length - (size_t)std::min((uint64_t)mapping.length, triplesSize);
+  const char* start = mapping.data +
+    std::max(dictionaryStart, estimate > TRIPLES_SEARCH_WINDOW ? estimate - TRIPLES_SEARCH_WINDOW : 0);
+  const char* end = mapping.data + std::min(mapping.length, estimate + TRIPLES_SEARCH_WINDOW);
+  const char* cookie = start < end ? std::search(start, end, TRIPLES_COOKIE, cookieEnd) : end;
+  return cookie != end ? cookie - mapping.data : 0;
+}
+
+
+
+/******** Residency control ********/
+
+
+// Returns the range of the section
+HdtMemory::Range HdtMemory::GetRange(MemorySection section) {
+  std::lock_guard<std::mutex> lock(sectionsMutex);
+  return sections[section];
+}
+
+// Applies the access pattern, and optionally huge pages, to the section in all of the process's mappings.
+void HdtMemory::Advise(MemorySection section, MemoryAdvice advice, bool hugePages) {
+  const Range range = GetRange(section);
+  if (!range.length)
+    return;
+  const int flag = advice == RandomAdvice ? MADV_RANDOM : advice == SequentialAdvice ? MADV_SEQUENTIAL : MADV_NORMAL;
+  adviseRange(range.mapping->data + range.offset, range.length, flag, hugePages);
+
+#ifdef __linux__
+  // Find libhdt's mappings of the same file, and advise the part of each that overlaps with the section
+  FILE* maps = fopen("/proc/self/maps", "r");
+  if (!maps)
+    return;
+  char line[4096];
+  while (fgets(line, sizeof(line), maps)) {
+    unsigned long start, end, offset, inode;
+    unsigned int deviceMajor, deviceMinor;
+    char permissions[5];
+    if (sscanf(line, "%lx-%lx %4s %lx %x:%x %lu", &start, &end, permissions, &offset,
+               &deviceMajor, &deviceMinor, &inode) != 7 ||
+        inode != range.mapping->inode || deviceMajor != major(range.mapping->device) ||
+        deviceMinor != minor(range.mapping->device) || start == (unsigned long)range.mapping->data)
+      continue;
+    const size_t overlapStart = std::max((size_t)offset, range.offset);
+    const size_t overlapEnd = std::min((size_t)(offset + (end - start)), range.offset + range.length);
+    if (overlapStart < overlapEnd)
+      adviseRange((char*)start + (overlapStart - offset), overlapEnd - overlapStart, flag, hugePages);
+  }
+  fclose(maps);
+#endif
+}
+
+// Reads every page of the section into memory, returning false if released before done.
+bool HdtMemory::Prefetch(MemorySection section) {
+  const Range range = GetRange(section);
+  if (!range.length)
+    return !released;
+  // Let the system read ahead, and touch every page to wait until it is resident
+  char* start = range.mapping->data + range.offset;
+  adviseRange(start, range.length, MADV_WILLNEED, false);
+  volatile char touched = 0;
+  for (size_t position = 0; position < range.length; position += getPageSize()) {
+    if (position % PREFETCH_CHUNK_SIZE < getPageSize() && released)
+      return false;
+    touched = touched ^ start[position];
+  }
+  touched = touched ^ start[range.length - 1];
+  return !released;
+}
+
+// Locks the section in memory, returning false if the system does not allow it.
+bool HdtMemory::Lock(MemorySection section) {
+  Range range = GetRange(section);
+  if (!range.length || released)
+    return false;
+  // Locking reads the entire section, so it happens without holding the mutex
+  char* start = range.mapping->data + range.offset;
+  size_t length = range.length;
+  alignToPages(start, length);
+  if (mlock(start, length))
+    return false;
+  std::lock_guard<std::mutex> lock(sectionsMutex);
+  // Sections that were released in the meantime stay unlocked
+  if (released)
+    munlock(start, length);
+  else
+    locked[section] = true;
+  return !released;
+}
+
+// Unlocks all sections and stops prefetching.
+void HdtMemory::Release() {
+  std::lock_guard<std::mutex> lock(sectionsMutex);
+  released = true;
+  for (int section = 0; section < MEMORY_SECTION_COUNT; section++) {
+    if (locked[section]) {
+      char* start = sections[section].mapping->data + sections[section].offset;
+      size_t length = sections[section].length;
+      alignToPages(start, length);
+      munlock(start, length);
+      locked[section] = false;
+    }
+  }
+}
+
+// Returns the number of mapped and resident bytes of the section.
+// For files that the process neither owns nor can write, some systems only report
+// the pages that were read through the process's own mappings.
+MemorySectionStats HdtMemory::GetStats(MemorySection section) {
+  MemorySectionStats stats = { 0, 0, false };
+  Range range;
+  {
+    std::lock_guard<std::mutex> lock(sectionsMutex);
+    range = sections[section];
+    stats.locked = locked[section];
+  }
+  if (!range.length)
+    return stats;
+  stats.mapped = range.length;
+
+  char* start = range.mapping->data + range.offset;
+  size_t length = range.length;
+  alignToPages(start, length);
+  vector<ResidencyFlag> residency((length + getPageSize() - 1) / getPageSize());
+  if (!mincore(start, length, residency.data())) {
+    uint64_t resident = 0;
+    for (size_t page = 0; page < residency.size(); page++)
+      resident += (residency[page] & 1) ? getPageSize() : 0;
+    stats.resident = std::min(resident, stats.mapped);
+  }
+  return stats;
+}
@@ -0,0 +1,93 @@
+#ifndef HDTMEMORY_H
+#define HDTMEMORY_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <HDTManager.hpp>
+
+// Parts of a document's files whose residency in memory can be controlled
+enum MemorySection {
+  HeaderSection,     // The control information and header of the HDT file
+  DictionarySection, // The dictionary of the HDT file
+  TriplesSection,    // The triples of the HDT file
+  IndexSection,      // The index file, if it has been built
+  MEMORY_SECTION_COUNT,
+};
+
+// Expected access patterns of a section
+enum MemoryAdvice {
+  NormalAdvice,
+  RandomAdvice,      // Read only the accessed pages, such as for lookups
+  SequentialAdvice,  // Read ahead aggressively, such as for scans
+};
+
+// The size and residency of a section
+struct MemorySectionStats {
+  uint64_t mapped, resident;
+  bool locked;
+};
+
+// Controls which parts of a document's memory-mapped files stay in memory.
+// It maps the files a second time, which shares the page cache with the mappings of libhdt:
+// pages that are read or locked through this mapping are thus also resident for libhdt.
+// Access patterns are applied to libhdt's mappings as well, where the system lists them.
+class HdtMemory {
+ public:
+  HdtMemory();
+  ~HdtMemory();
+
+  // Maps the HDT file and, if it exists, its index, and locates the sections of the HDT file;
+  // files that cannot be mapped are reported as empty
+  void Open(const std::string& filename, hdt::HDT* hdt);
+  // Maps the index file once it has been built
+  void OpenIndex(const std::string& filename);
+
+  // Applies the access pattern, and optionally huge pages, to the section in all of the process's mappings
+  void Advise(MemorySection section, MemoryAdvice advice, bool hugePages);
+  // Reads every page of the section into memory, returning false if released before done
+  bool Prefetch(MemorySection section);
+  // Locks the section in memory, returning false if the system does not allow it
+  bool Lock(MemorySection section);
+  // Unlocks all sections and stops prefetching
+  void Release();
+
+  // Returns the number of mapped and resident bytes of the section
+  MemorySectionStats GetStats(MemorySection section);
+
+ private:
+  // A read-only mapping of a whole file
+  struct Mapping {
+    char* data;
+    size_t length;
+    dev_t device;
+    ino_t inode;
+
+    Mapping() : data(NULL), length(0), device(0), inode(0) { }
+  };
+  // A part of a mapped file
+  struct Range {
+    const Mapping* mapping;
+    size_t offset, length;
+
+    Range() : mapping(NULL), offset(0), length(0) { }
+  };
+
+  Mapping file, index;
+  Range sections[MEMORY_SECTION_COUNT];
+  bool locked[MEMORY_SECTION_COUNT];
+  std::atomic<bool> released;
+  // Guards the sections and their locks, which can change while other threads read them
+  std::mutex sectionsMutex;
+
+  // Returns the range of the section
+  Range GetRange(MemorySection section);
+  // Maps the whole file, returning false if that fails
+  static bool Map(const std::string& filename, Mapping& mapping);
+  // Returns the offset at which the triples section of the mapped HDT file starts, or 0 if it is not found
+  static size_t FindTriples(const Mapping& mapping, size_t dictionaryStart, uint64_t triplesSize);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "HdtRegistry.h"
+
+using namespace std;
+
+mutex HdtRegistry::entriesMutex;
+map<string, shared_ptr<HdtRegistry::Entry> > HdtRegistry::entries;
+
+// Returns the mappings that control the residency of the HDT's files, creating them on first use.
+HdtMemory* MappedHdt::GetMemory(const string& filename) {
+  lock_guard<mutex> lock(memoryMutex);
+  if (!memory) {
+    memory.reset(new HdtMemory());
+    memory->Open(filename, hdt.get());
+  }
+  return memory.get();
+}
+
+// Returns the mapping with the given key, calling open to create it if none is in use.
+shared_ptr<MappedHdt> HdtRegistry::Acquire(const string& key, const function<MappedHdt*()>& open) {
+  shared_ptr<Entry> entry;
+  {
+    lock_guard<mutex> lock(entriesMutex);
+    shared_ptr<Entry>& existing = entries[key];
+    if (!existing)
+      existing.reset(new Entry());
+    entry = existing;
+  }
+  // Opening can take long, so it only blocks callers with the same key
+  shared_ptr<MappedHdt> mapped;
+  try {
+    lock_guard<mutex> lock(entry->openMutex);
+    mapped = entry->mapped.lock();
+    if (!mapped) {
+      // The last document to release the mapping deletes it, and with it the entry
+      mapped.reset(open(), [key](MappedHdt* mapped) {
+        delete mapped;
+        Remove(key);
+      });
+      entry->mapped = mapped;
+    }
+  }
+  catch (...) {
+    entry.reset();
+    Remove(key);
+    throw;
+  }
+  return mapped;
+}
+
+// Removes the entry if its mapping is no longer in use and nobody is opening it.
+void HdtRegistry::Remove(const string& key) {
+  lock_guard<mutex> lock(entriesMutex);
+  map<string, shared_ptr<Entry> >::iterator entry = entries.find(key);
+  // Other callers only obtain the entry under the lock, so a single owner means that nobody else has it
+  if (entry != entries.end() && entry->second.use_count() == 1 && entry->second->mapped.expired())
+    entries.erase(entry);
+}
@@ -0,0 +1,50 @@
+#ifndef HDTREGISTRY_H
+#define HDTREGISTRY_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <HDTManager.hpp>
+#include "HdtMemory.h"
+#include "LiteralIndex.h"
+#include "PatternStatistics.h"
+
+// An HDT with the data derived from it, which documents in several threads can share
+struct MappedHdt {
+  std::unique_ptr<hdt::HDT> hdt;
+  std::unique_ptr<PatternStatistics> statistics;
+  std::unique_ptr<LiteralIndex> literalIndex;
+
+  // Returns the mappings that control the residency of the HDT's files, creating them on first use
+  HdtMemory* GetMemory(const std::string& filename);
+
+ private:
+  std::mutex memoryMutex;
+  std::unique_ptr<HdtMemory> memory;
+};
+
+// A process-wide registry of mapped HDTs by key, through which documents in all worker threads
+// use the same mapping of a file. A mapping is deleted once no document uses it anymore.
+class HdtRegistry {
+ public:
+  // Returns the mapping with the given key, calling open to create it if none is in use;
+  // callers with the same key wait for a single mapping to be opened
+  static std::shared_ptr<MappedHdt> Acquire(const std::string& key, const std::function<MappedHdt*()>& open);
+
+ private:
+  // A mapping that is in use, and the lock under which it is opened
+  struct Entry {
+    std::mutex openMutex;
+    std::weak_ptr<MappedHdt> mapped;
+  };
+
+  static std::mutex entriesMutex;
+  static std::map<std::string, std::shared_ptr<Entry> > entries;
+
+  // Removes the entry if its mapping is no longer in use and nobody is opening it
+  static void Remove(const std::string& key);
+};
+
+#endif
@@ -0,0 +1,447 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <regex>
+#include <stdexcept>
+#include <HDTManager.hpp>
+#include "LiteralIndex.h"
+
+using namespace std;
+using namespace hdt;
+
+// Identifies literal index files and the version of their format
+const char LITERAL_INDEX_MAGIC[8] = { 'H', 'D', 'T', 'L', 'I', 'T', 'X', '2' };
+
+// Folded forms of the characters U+00C0 to U+017F: lowercase and without diacritics
+const uint16_t FOLDED_LATIN[] = {
+  0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x00E6, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065,
+  0x0069, 0x0069, 0x0069, 0x0069, 0x00F0, 0x006E, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x00D7,
+  0x00F8, 0x0075, 0x0075, 0x0075, 0x0075, 0x0079, 0x00FE, 0x00DF, 0x0061, 0x0061, 0x0061, 0x0061,
+  0x0061, 0x0061, 0x00E6, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065, 0x0069, 0x0069, 0x0069, 0x0069,
+  0x00F0, 0x006E, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x00F7, 0x00F8, 0x0075, 0x0075, 0x0075,
+  0x0075, 0x0079, 0x00FE, 0x0079, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0063, 0x0063,
+  0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0064, 0x0064, 0x0111, 0x0111, 0x0065, 0x0065,
+  0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0067, 0x0067, 0x0067, 0x0067,
+  0x0067, 0x0067, 0x0067, 0x0067, 0x0068, 0x0068, 0x0127, 0x0127, 0x0069, 0x0069, 0x0069, 0x0069,
+  0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0133, 0x0133, 0x006A, 0x006A, 0x006B, 0x006B,
+  0x0138, 0x006C, 0x006C, 0x006C, 0x006C, 0x006C, 0x006C, 0x0140, 0x0140, 0x0142, 0x0142, 0x006E,
+  0x006E, 0x006E, 0x006E, 0x006E, 0x006E, 0x0149, 0x014B, 0x014B, 0x006F, 0x006F, 0x006F, 0x006F,
+  0x006F, 0x006F, 0x0153, 0x0153, 0x0072, 0x0072, 0x0072, 0x0072, 0x0072, 0x0072, 0x0073, 0x0073,
+  0x0073, 0x0073, 0x0073, 0x0073, 0x0073, 0x0073, 0x0074, 0x0074, 0x0074, 0x0074, 0x0167, 0x0167,
+  0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075,
+  0x0077, 0x0077, 0x0079, 0x0079, 0x0079, 0x007A, 0x007A, 0x007A, 0x007A, 0x007A, 0x007A, 0x0073,
+};
+
+
+
+/******** Text processing ********/
+
+
+// Appends the lowercase form of the UTF-8 text without diacritics to folded.
+// Only the Latin blocks up to U+017F are folded; other characters are copied as they are.
+void LiteralIndex::Fold(const char* text, size_t length, string& folded) {
+  const unsigned char *c = (const unsigned char*)text, *end = c + length;
+  while (c < end) {
+    if (*c < 0x80) {
+      folded += (char)(*c >= 'A' && *c <= 'Z' ? *c + ('a' - 'A') : *c);
+      c++;
+    }
+    // Lead bytes 0xC3 to 0xC5 start the characters U+00C0 to U+017F
+    else if (*c >= 0xC3 && *c <= 0xC5 && c + 1 < end && (c[1] & 0xC0) == 0x80) {
+      uint16_t character = FOLDED_LATIN[((c[0] & 0x1F) << 6 | (c[1] & 0x3F)) - 0xC0];
+      if (character < 0x80) {
+        folded += (char)character;
+      }
+      else {
+        folded += (char)(0xC0 | character >> 6);
+        folded += (char)(0x80 | (character & 0x3F));
+      }
+      c += 2;
+    }
+    else {
+      folded += (char)*c++;
+    }
+  }
+}
+
+// Returns whether the byte of folded text is part of a word
+static inline bool isWordByte(unsigned char c) {
+  return c >= 0x80 || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+}
+
+// Appends the words of the folded text to words
+static void splitWords(const char* text, size_t length, vector<string>& words) {
+  for (size_t start = 0, end = 0; start < length; start = end) {
+    while (start < length && !isWordByte(text[start])) start++;
+    for (end = start; end < length && isWordByte(text[end]); end++);
+    if (end > start)
+      words.push_back(string(text + start, end - start));
+  }
+}
+
+// Returns the trigram that starts at the given byte of folded text
+static inline uint32_t toTrigram(const char* text) {
+  return (uint32_t)(unsigned char)text[0] << 16 | (uint32_t)(unsigned char)text[1] << 8 | (unsigned char)text[2];
+}
+
+// Returns the number of bytes of the UTF-8 character that starts with the given byte,
+// or 0 if the byte cannot start a character
+static inline size_t getCharacterLength(unsigned char c) {
+  return c < 0x80 ? 1 : c < 0xC0 ? 0 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : c < 0xF8 ? 4 : 0;
+}
+
+// Returns the position after the escape sequence that starts with the backslash at the given position,
+// or string::npos if the sequence is not understood
+static size_t skipEscape(const string& regex, size_t i) {
+  if (++i >= regex.size())
+    return string::npos;
+  const char c = regex[i++];
+  // Hexadecimal and Unicode escapes, control characters, and back references by number or name
+  if (c == 'x' || c == 'u') {
+    const size_t end = i + (c == 'x' ? 2 : 4);
+    for (; i < end; i++)
+      if (i >= regex.size() || !isxdigit((unsigned char)regex[i]))
+        return string::npos;
+    return end;
+  }
+  if (c == 'c')
+    return i < regex.size() ? i + 1 : string::npos;
+  if (c == 'k')
+    return regex[i] == '<' && regex.find('>', i) != string::npos ? regex.find('>', i) + 1 : string::npos;
+  if (c >= '0' && c <= '9') {
+    while (i < regex.size() && regex[i] >= '0' && regex[i] <= '9') i++;
+    return i;
+  }
+  // Other escapes consist of a single ASCII character
+  return (unsigned char)c < 0x80 ? i : string::npos;
+}
+
+// Returns the position after the quantifier that starts with the brace at the given position,
+// or string::npos if the braces do not contain a quantifier
+static size_t skipQuantifier(const string& regex, size_t i) {
+  const size_t end = regex.find('}', i);
+  if (end == string::npos || end == i + 1 || regex.find_first_not_of("0123456789,", i + 1) != end)
+    return string::npos;
+  return end + 1;
+}
+
+// Returns the longest run of plain characters that every match of the regular expression contains,
+// or an empty string if that is not obvious from the expression
+static string getRequiredText(const string& regex) {
+  if (regex.find('|') != string::npos)
+    return string();
+  string longest, current;
+  size_t lastCharacter = 0;
+  int depth = 0;
+  for (size_t i = 0; i < regex.size();) {
+    const char c = regex[i];
+    // Characters outside of groups are required, unless a quantifier makes them optional
+    if (!depth && c && !strchr("\\^$.?*+()[]{}", c)) {
+      const size_t length = getCharacterLength(c);
+      if (!length || i + length > regex.size())
+        return string();
+      lastCharacter = current.size();
+      current.append(regex, i, length);
+      i += length;
+      continue;
+    }
+    if ((c == '?' || c == '*' || c == '{') && !current.empty())
+      current.erase(lastCharacter);
+    if (current.size() > longest.size())
+      longest = current;
+    current.clear();
+    // Skip escape sequences, quantifier bodies, and character classes, and track the depth of groups
+    if (c == '\\') {
+      i = skipEscape(regex, i);
+    }
+    else if (c == '{') {
+      i = skipQuantifier(regex, i);
+    }
+    else if (c == '[') {
+      for (i++; i < regex.size() && regex[i] != ']';)
+        i = regex[i] == '\\' ? skipEscape(regex, i) : i + 1;
+      i = i < regex.size() ? i + 1 : string::npos;
+    }
+    else {
+      if (c == '(')
+        depth++;
+      else if (c == ')' && depth)
+        depth--;
+      i++;
+    }
+    if (i == string::npos)
+      return string();
+  }
+  return current.size() > longest.size() ? current : longest;
+}
+
+
+
+/******** Construction ********/
+
+
+// Computes the index from the literals in the dictionary of the HDT.
+void LiteralIndex::Build(HDT* hdt) {
+  Dictionary* dict = hdt->getDictionary();
+  objectCount = dict->getMaxObjectID();
+  ids.clear(), textOffsets.assign(1, 0), texts.clear();
+
+  // Fold the lexical forms of all literals; shared terms are subjects, so they are never literals
+  for (size_t id = dict->getNshared() + 1; id <= objectCount; id++) {
+    string object(dict->idToString(id, OBJECT));
+    if (object.empty() || object[0] != '"')
+      continue;
+    if (ids.size() == UINT32_MAX)
+      throw runtime_error("The document has too many literals to index");
+    size_t end = object.rfind('"');
+    Fold(object.data() + 1, end > 1 ? end - 1 : 0, texts);
+    ids.push_back(id);
+    textOffsets.push_back(texts.size());
+  }
+
+  // Collect the trigrams and words of every literal
+  vector<pair<uint32_t, uint32_t> > occurrences;
+  vector<uint32_t> literalTrigrams;
+  map<string, vector<uint32_t> > words;
+  vector<string> literalWords;
+  for (uint32_t literal = 0; literal < ids.size(); literal++) {
+    const char* text = texts.data() + textOffsets[literal];
+    const size_t length = textOffsets[literal + 1] - textOffsets[literal];
+    literalTrigrams.clear();
+    for (size_t i = 0; i + 3 <= length; i++)
+      literalTrigrams.push_back(toTrigram(text + i));
+    sort(literalTrigrams.begin(), literalTrigrams.end());
+    literalTrigrams.erase(unique(literalTrigrams.begin(), literalTrigrams.end()), literalTrigrams.end());
+    for (size_t i = 0; i < literalTrigrams.size(); i++)
+      occurrences.push_back(make_pair(literalTrigrams[i], literal));
+
+    literalWords.clear();
+    splitWords(text, length, literalWords);
+    for (size_t i = 0; i < literalWords.size(); i++) {
+      vector<uint32_t>& postings = words[literalWords[i]];
+      if (postings.empty() || postings.back() != literal)
+        postings.push_back(literal);
+    }
+  }
+
+  // Store the literals of every trigram
+  sort(occurrences.begin(), occurrences.end());
+  trigrams.clear(), trigramOffsets.clear(), trigramPostings.clear();
+  for (size_t i = 0; i < occurrences.size(); i++) {
+    if (trigrams.empty() || trigrams.back() != occurrences[i].first) {
+      trigrams.push_back(occurrences[i].first);
+      trigramOffsets.push_back(i);
+    }
+    trigramPostings.push_back(occurrences[i].second);
+  }
+  trigramOffsets.push_back(trigramPostings.size());
+
+  // Store the literals of every word, in the sorted order of the words
+  tokens.clear(), tokenOffsets.assign(1, 0), tokenPostings.clear(), tokenPostingOffsets.assign(1, 0);
+  for (map<string, vector<uint32_t> >::const_iterator word = words.begin(); word != words.end(); word++) {
+    tokens += word->first;
+    tokenOffsets.push_back(tokens.size());
+    tokenPostings.insert(tokenPostings.end(), word->second.begin(), word->second.end());
+    tokenPostingOffsets.push_back(tokenPostings.size());
+  }
+}
+
+
+
+/******** Storage ********/
+
+
+// Writes the number of values and the values to the file
+template <typename T>
+static bool writeValues(FILE* file, const T* values, uint64_t count) {
+  return fwrite(&count, sizeof(count), 1, file) == 1 && (!count || fwrite(values, sizeof(T), count, file) == count);
+}
+
+// Reads a number of values, which cannot exceed the size of the file, and the values from the file
+template <typename Container>
+static bool readValues(FILE* file, Container& values, uint64_t fileSize) {
+  uint64_t count = 0;
+  if (fread(&count, sizeof(count), 1, file) != 1 || count > fileSize / sizeof(values[0]))
+    return false;
+  values.resize(count);
+  return !count || fread(&values[0], sizeof(values[0]), count, file) == count;
+}
+
+// Reads the index from the file, returning false if it does not exist or does not match the HDT.
+bool LiteralIndex::Load(const string& filename, HDT* hdt, const SourceFingerprint& source) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file)
+    return false;
+  fseek(file, 0, SEEK_END);
+  const uint64_t fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char magic[sizeof(LITERAL_INDEX_MAGIC)];
+  SourceFingerprint fingerprint;
+  bool valid = fread(magic, sizeof(magic), 1, file) == 1 && !memcmp(magic, LITERAL_INDEX_MAGIC, sizeof(magic)) &&
+               fread(&fingerprint, sizeof(fingerprint), 1, file) == 1 &&
+               fread(&objectCount, sizeof(objectCount), 1, file) == 1 &&
+               // An index of another version of the HDT is outdated
+               fingerprint == source && objectCount == hdt->getDictionary()->getMaxObjectID() &&
+               readValues(file, ids, fileSize) && readValues(file, textOffsets, fileSize) &&
+               readValues(file, texts, fileSize) && readValues(file, trigrams, fileSize) &&
+               readValues(file, trigramOffsets, fileSize) && readValues(file, trigramPostings, fileSize) &&
+               readValues(file, tokenOffsets, fileSize) && readValues(file, tokens, fileSize) &&
+               readValues(file, tokenPostingOffsets, fileSize) && readValues(file, tokenPostings, fileSize);
+  fclose(file);
+  // Verify that the parts fit together
+  return valid && textOffsets.size() == ids.size() + 1 && textOffsets.back() == texts.size() &&
+         trigramOffsets.size() == trigrams.size() + 1 && trigramOffsets.back() == trigramPostings.size() &&
+         tokenOffsets.size() == tokenPostingOffsets.size() && tokenOffsets.back() == tokens.size() &&
+         tokenPostingOffsets.back() == tokenPostings.size();
+}
+
+// Writes the index to the file, returning false on failure.
+// The file is written under a temporary name first, such that readers never see a partial file.
+bool LiteralIndex::Save(const string& filename, const SourceFingerprint& source) const {
+  string temporaryFilename = filename + ".tmp";
+  FILE* file = fopen(temporaryFilename.c_str(), "wb");
+  if (!file)
+    return false;
+  bool valid = fwrite(LITERAL_INDEX_MAGIC, sizeof(LITERAL_INDEX_MAGIC), 1, file) == 1 &&
+               fwrite(&source, sizeof(source), 1, file) == 1 &&
+               fwrite(&objectCount, sizeof(objectCount), 1, file) == 1 &&
+               writeValues(file, ids.data(), ids.size()) &&
+               writeValues(file, textOffsets.data(), textOffsets.size()) &&
+               writeValues(file, texts.data(), texts.size()) &&
+               writeValues(file, trigrams.data(), trigrams.size()) &&
+               writeValues(file, trigramOffsets.data(), trigramOffsets.size()) &&
+               writeValues(file, trigramPostings.data(), trigramPostings.size()) &&
+               writeValues(file, tokenOffsets.data(), tokenOffsets.size()) &&
+               writeValues(file, tokens.data(), tokens.size()) &&
+               writeValues(file, tokenPostingOffsets.data(), tokenPostingOffsets.size()) &&
+               writeValues(file, tokenPostings.data(), tokenPostings.size());
+  valid = fclose(file) == 0 && valid;
+  if (valid)
+    valid = rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+  if (!valid)
+    remove(temporaryFilename.c_str());
+  return valid;
+}
+
+
+
+/******** Search ********/
+
+
+// Finds the object IDs of literals after afterId that match the query.
+void LiteralIndex::Search(Dictionary* dict, const string& query, LiteralSearchMode mode,
+                          uint64_t afterId, uint64_t offset, uint64_t limit,
+                          vector<uint64_t>& matches, uint64_t& count, QueryControl* control) const {
+  // Determine the literals that can match, and the folded text they need to contain
+  const bool isRegex = mode == RegexSearch || mode == CaseInsensitiveRegexSearch;
+  string required;
+  vector<uint32_t> candidates;
+  bool hasCandidates = true;
+  regex pattern;
+  if (mode == TokenSearch) {
+    string folded;
+    vector<string> words;
+    Fold(query.data(), query.size(), folded);
+    splitWords(folded.data(), folded.size(), words);
+    FindTokens(words, candidates);
+  }
+  else {
+    if (!isRegex) {
+      Fold(query.data(), query.size(), required);
+    }
+    else {
+      pattern.assign(query, mode == RegexSearch ? regex::ECMAScript : regex::ECMAScript | regex::icase);
+      string text = getRequiredText(query);
+      Fold(text.data(), text.size(), required);
+    }
+    hasCandidates = FindCandidates(required, candidates);
+  }
+
+  // Verify the candidates after the given ID in ascending order
+  const size_t first = upper_bound(ids.begin(), ids.end(), afterId) - ids.begin();
+  const size_t end = hasCandidates ? candidates.size() : ids.size();
+  size_t next = hasCandidates ? lower_bound(candidates.begin(), candidates.end(), first) - candidates.begin() : first;
+  for (count = 0; next < end && !(control && control->ShouldStop()); next++) {
+    const size_t literal = hasCandidates ? candidates[next] : next;
+    if (!required.empty()) {
+      const char *text = texts.data() + textOffsets[literal], *textEnd = texts.data() + textOffsets[literal + 1];
+      if (std::search(text, textEnd, required.begin(), required.end()) == textEnd)
+        continue;
+    }
+    // Regular expressions are matched against the original lexical form
+    if (isRegex) {
+      string literalString(dict->idToString(ids[literal], OBJECT));
+      size_t lexicalEnd = std::max((size_t)1, literalString.rfind('"'));
+      if (!regex_search(literalString.begin() + 1, literalString.begin() + lexicalEnd, pattern))
+        continue;
+    }
+    if (count++ >= offset && matches.size() < limit)
+      matches.push_back(ids[literal]);
+  }
+}
+
+// Sets candidates to the positions of the literals that can contain the folded substring,
+// returning false if that could be any literal.
+bool LiteralIndex::FindCandidates(const string& substring, vector<uint32_t>& candidates) const {
+  if (substring.size() < 3)
+    return false;
+  // Only the literals with the rarest trigram of the substring need to be verified
+  size_t rarest = 0, rarestCount = SIZE_MAX;
+  for (size_t i = 0; i + 3 <= substring.size(); i++) {
+    const uint32_t trigram = toTrigram(substring.data() + i);
+    vector<uint32_t>::const_iterator position = lower_bound(trigrams.begin(), trigrams.end(), trigram);
+    if (position == trigrams.end() || *position != trigram) {
+      candidates.clear();
+      return true;
+    }
+    const size_t index = position - trigrams.begin(), count = trigramOffsets[index + 1] - trigramOffsets[index];
+    if (count < rarestCount)
+      rarest = index, rarestCount = count;
+  }
+  candidates.assign(trigramPostings.begin() + trigramOffsets[rarest],
+                    trigramPostings.begin() + trigramOffsets[rarest + 1]);
+  return true;
+}
+
+// Sets candidates to the positions of the literals with words that start with all of the folded words.
+void LiteralIndex::FindTokens(const vector<string>& words, vector<uint32_t>& candidates) const {
+  candidates.clear();
+  vector<uint32_t> matches, intersection;
+  const size_t tokenCount = tokenOffsets.size() - 1;
+  for (size_t w = 0; w < words.size(); w++) {
+    // The words that start with the query word form a range of the sorted words
+    const string& word = words[w];
+    size_t low = 0, high = tokenCount;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (tokens.compare(tokenOffsets[middle], tokenOffsets[middle + 1] - tokenOffsets[middle], word) < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    matches.clear();
+    for (size_t token = low; token < tokenCount &&
+         tokenOffsets[token + 1] - tokenOffsets[token] >= word.size() &&
+         !tokens.compare(tokenOffsets[token], word.size(), word); token++)
+      matches.insert(matches.end(), tokenPostings.begin() + tokenPostingOffsets[token],
+                                    tokenPostings.begin() + tokenPostingOffsets[token + 1]);
+    sort(matches.begin(), matches.end());
+    matches.erase(unique(matches.begin(), matches.end()), matches.end());
+
+    // Keep the literals that contain all words so far
+    if (w == 0) {
+      candidates.swap(matches);
+    }
+    else {
+      intersection.clear();
+      set_intersection(candidates.begin(), candidates.end(), matches.begin(), matches.end(),
+                       back_inserter(intersection));
+      candidates.swap(intersection);
+    }
+    if (candidates.empty())
+      break;
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef LITERALINDEX_H
+#define LITERALINDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <HDTManager.hpp>
+#include "SourceFingerprint.h"
+#include "QueryControl.h"
+
+// Ways of matching a query against literals
+enum LiteralSearchMode {
+  SubstringSearch,       // The literal contains the query, ignoring case and diacritics
+  TokenSearch,           // Every word of the query starts a word of the literal, ignoring case and diacritics
+  RegexSearch,           // The literal matches the regular expression
+  CaseInsensitiveRegexSearch,
+};
+
+// A full-text index over the lexical forms of a document's object literals,
+// which is computed once and stored in a sidecar file.
+// It contains the case- and diacritic-folded lexical forms, the literals in which every trigram occurs,
+// and a sorted list of words with the literals in which they occur.
+// Matches are always returned in ascending ID order, such that searches can resume after the last match.
+class LiteralIndex {
+ public:
+  LiteralIndex() : objectCount(0) { }
+
+  // Computes the index from the literals in the dictionary of the HDT
+  void Build(hdt::HDT* hdt);
+  // Reads the index from the file, returning false if it does not exist or does not match the HDT
+  // or the version of its file
+  bool Load(const std::string& filename, hdt::HDT* hdt, const SourceFingerprint& source);
+  // Writes the index to the file together with the fingerprint of the HDT file, returning false on failure
+  bool Save(const std::string& filename, const SourceFingerprint& source) const;
+
+  // Finds the object IDs of literals after afterId that match the query,
+  // skipping offset matches and returning at most limit of them in ascending order.
+  // Sets count to the total number of matches after afterId, unless the query control stops the search.
+  void Search(hdt::Dictionary* dict, const std::string& query, LiteralSearchMode mode,
+              uint64_t afterId, uint64_t offset, uint64_t limit,
+              std::vector<uint64_t>& matches, uint64_t& count, QueryControl* control) const;
+
+  // Appends the lowercase form of the UTF-8 text without diacritics to folded
+  static void Fold(const char* text, size_t length, std::string& folded);
+
+ private:
+  uint64_t objectCount;
+  // Object IDs of the literals in ascending order, and their folded lexical forms
+  std::vector<uint64_t> ids;
+  std::vector<uint64_t> textOffsets;
+  std::string texts;
+  // Sorted trigrams, with the positions of the literals that contain them
+  std::vector<uint32_t> trigrams;
+  std::vector<uint64_t> trigramOffsets;
+  std::vector<uint32_t> trigramPostings;
+  // Sorted words, with the positions of the literals that contain them
+  std::vector<uint64_t> tokenOffsets;
+  std::string tokens;
+  std::vector<uint64_t> tokenPostingOffsets;
+  std::vector<uint32_t> tokenPostings;
+
+  // Sets candidates to the positions of the literals that can contain the folded substring,
+  // returning false if that could be any literal
+  bool FindCandidates(const std::string& substring, std::vector<uint32_t>& candidates) const;
+  // Sets candidates to the positions of the literals with words that start with all of the folded words
+  void FindTokens(const std::vector<std::string>& words, std::vector<uint32_t>& candidates) const;
+};
+
+#endif
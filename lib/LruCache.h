@@ -0,0 +1,133 @@
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Approximate number of bytes an entry needs besides its key and value
+const size_t LRU_ENTRY_OVERHEAD = 64;
+
+// Statistics of a cache
+struct LruCacheStats {
+  uint64_t hits, misses, evictions, oversized;
+  size_t entries, bytes, capacity;
+};
+
+// A thread-safe cache that evicts the least recently used entries once its size exceeds a number of bytes.
+// The keys are divided over independently locked shards, such that concurrent workers rarely wait on each other.
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class LruCache {
+ public:
+  // Creates a cache of at most capacity bytes; a capacity of 0 disables the cache.
+  // Every shard holds an equal part of the capacity, which limits the size of a single entry.
+  LruCache(size_t capacity, size_t shardCount = 16)
+    : capacity(capacity), shards(capacity ? shardCount : 0), hits(0), misses(0), evictions(0), oversized(0) {
+    for (size_t i = 0; i < shards.size(); i++)
+      shards[i].capacity = capacity / shardCount;
+  }
+
+  // Copies the value of the key into value, returning false if the key is not cached
+  bool Get(const Key& key, Value& value) {
+    if (shards.empty())
+      return false;
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    typename Shard::Index::iterator position = shard.index.find(key);
+    if (position == shard.index.end()) {
+      misses++;
+      return false;
+    }
+    // Move the entry to the front of the recency list
+    shard.entries.splice(shard.entries.begin(), shard.entries, position->second);
+    value = position->second->value;
+    hits++;
+    return true;
+  }
+
+  // Caches the value of the key, which takes up the given number of bytes
+  void Put(const Key& key, const Value& value, size_t bytes) {
+    if (shards.empty())
+      return;
+    Shard& shard = GetShard(key);
+    bytes += LRU_ENTRY_OVERHEAD;
+    if (bytes > shard.capacity) {
+      oversized++;
+      return;
+    }
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Replace an existing entry
+    typename Shard::Index::iterator position = shard.index.find(key);
+    if (position != shard.index.end()) {
+      shard.bytes -= position->second->bytes;
+      shard.entries.erase(position->second);
+      shard.index.erase(position);
+    }
+    // Evict the least recently used entries until the new entry fits
+    while (shard.bytes + bytes > shard.capacity) {
+      Entry& last = shard.entries.back();
+      shard.bytes -= last.bytes;
+      shard.index.erase(last.key);
+      shard.entries.pop_back();
+      evictions++;
+    }
+    shard.entries.push_front(Entry(key, value, bytes));
+    shard.index[key] = shard.entries.begin();
+    shard.bytes += bytes;
+  }
+
+  // Removes all entries
+  void Clear() {
+    for (size_t i = 0; i < shards.size(); i++) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      shards[i].entries.clear();
+      shards[i].index.clear();
+      shards[i].bytes = 0;
+    }
+  }
+
+  // Returns the statistics of the cache
+  LruCacheStats GetStats() {
+    LruCacheStats stats = { hits, misses, evictions, oversized, 0, 0, capacity };
+    for (size_t i = 0; i < shards.size(); i++) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      stats.entries += shards[i].index.size();
+      stats.bytes += shards[i].bytes;
+    }
+    return stats;
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    Value value;
+    size_t bytes;
+    Entry(const Key& key, const Value& value, size_t bytes) : key(key), value(value), bytes(bytes) { }
+  };
+  struct Shard {
+    typedef std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> Index;
+    std::mutex mutex;
+    std::list<Entry> entries;
+    Index index;
+    size_t bytes, capacity;
+    Shard() : bytes(0), capacity(0) { }
+  };
+
+  const size_t capacity;
+  std::vector<Shard> shards;
+  std::atomic<uint64_t> hits, misses, evictions, oversized;
+
+  // Returns the shard of the key, mixing the hash since integer hashes are often the identity
+  Shard& GetShard(const Key& key) {
+    size_t hash = Hash()(key);
+    hash = (hash ^ (hash >> 16)) * 0x45d9f3b;
+    return shards[(hash ^ (hash >> 16)) % shards.size()];
+  }
+};
+
+#endif
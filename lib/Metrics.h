@@ -0,0 +1,190 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+// Operations of a document whose latencies are measured
+enum MetricsOperation {
+  SearchTriplesOperation,
+  SearchTriplesBatchOperation,
+  ExportOperation,
+  SearchTriplesCursorOperation,
+  SearchTripleIdsOperation,
+  TermsToIdsOperation,
+  IdsToTermsOperation,
+  EvaluateBGPOperation,
+  SearchLiteralsOperation,
+  SearchTermsOperation,
+  FetchDistinctTermsOperation,
+  METRICS_OPERATION_COUNT,
+};
+
+// Phases of an operation
+enum MetricsPhase {
+  QueuePhase,    // Waiting for a thread after being queued
+  ResolvePhase,  // Converting the terms of the query into IDs
+  SkipPhase,     // Skipping matches before the offset
+  DecodePhase,   // Reading matches and decoding their IDs into terms
+  ExecutePhase,  // All work on the worker thread, including the phases above
+  CallbackPhase, // Converting the result into JavaScript values on the main thread
+  METRICS_PHASE_COUNT,
+};
+
+// Amounts of work of all operations of a document
+enum MetricsCounter {
+  TriplesScanned,  // Triples that were read or skipped one by one
+  TriplesReturned, // Triples in results
+  TermsDecoded,    // Terms that were looked up in the dictionary rather than the term cache
+  BytesAllocated,  // Bytes of decoded terms and new search results
+  METRICS_COUNTER_COUNT,
+};
+
+// Number of linear sub-buckets per power of two, which bounds the relative error of percentiles to 25%
+const unsigned HISTOGRAM_SUB_BUCKETS = 4;
+// Latencies from 2^40 microseconds, almost two weeks, fall into the last bucket
+const unsigned HISTOGRAM_BUCKETS = 40 * HISTOGRAM_SUB_BUCKETS;
+
+// A lock-free histogram of latencies in microseconds, with buckets whose width grows with their values.
+// Recording only increments a few atomic counters, so it can stay enabled in production.
+class LatencyHistogram {
+ public:
+  LatencyHistogram() { Reset(); }
+
+  // Adds a latency to the histogram; can be called from any thread
+  void Record(uint64_t micros) {
+    buckets[GetBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(micros, std::memory_order_relaxed);
+    uint64_t previous = max.load(std::memory_order_relaxed);
+    while (micros > previous && !max.compare_exchange_weak(previous, micros, std::memory_order_relaxed));
+  }
+
+  // Removes all latencies
+  void Reset() {
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++)
+      buckets[i].store(0, std::memory_order_relaxed);
+    count = 0, sum = 0, max = 0;
+  }
+
+  uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+  uint64_t Sum() const { return sum.load(std::memory_order_relaxed); }
+  uint64_t Max() const { return max.load(std::memory_order_relaxed); }
+
+  // Returns an upper bound of the latency below which the given fraction of latencies lies
+  uint64_t Percentile(double fraction) const {
+    const uint64_t total = Count();
+    uint64_t seen = 0;
+    for (unsigned bucket = 0; bucket < HISTOGRAM_BUCKETS && total; bucket++) {
+      seen += buckets[bucket].load(std::memory_order_relaxed);
+      if (seen >= fraction * total) {
+        const uint64_t bound = GetUpperBound(bucket);
+        return bound < Max() ? bound : Max();
+      }
+    }
+    return Max();
+  }
+
+ private:
+  std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+  std::atomic<uint64_t> count, sum, max;
+
+  // Returns the bucket of the latency: the first buckets hold single values,
+  // and every power of two after them is split into equally wide sub-buckets
+  static unsigned GetBucket(uint64_t micros) {
+    if (micros < HISTOGRAM_SUB_BUCKETS)
+      return (unsigned)micros;
+    unsigned exponent = 63 - __builtin_clzll(micros);
+    unsigned bucket = (exponent - 1) * HISTOGRAM_SUB_BUCKETS +
+                      (unsigned)((micros >> (exponent - 2)) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+  }
+
+  // Returns the highest latency that falls into the bucket
+  static uint64_t GetUpperBound(unsigned bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+      return bucket;
+    const unsigned exponent = bucket / HISTOGRAM_SUB_BUCKETS + 1;
+    const uint64_t width = (uint64_t)1 << (exponent - 2);
+    return (HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) * width + width - 1;
+  }
+};
+
+// Latencies and amounts of work of the operations on a document
+class DocumentMetrics {
+ public:
+  DocumentMetrics() { Reset(); }
+
+  // Adds the latency of a phase of an operation
+  void Record(MetricsOperation operation, MetricsPhase phase, uint64_t micros) {
+    latencies[operation][phase].Record(micros);
+  }
+  // Adds to a counter; can be called from any thread
+  void Add(MetricsCounter counter, uint64_t amount) {
+    counters[counter].fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  // Clears all latencies and counters
+  void Reset() {
+    for (int operation = 0; operation < METRICS_OPERATION_COUNT; operation++)
+      for (int phase = 0; phase < METRICS_PHASE_COUNT; phase++)
+        latencies[operation][phase].Reset();
+    for (int counter = 0; counter < METRICS_COUNTER_COUNT; counter++)
+      counters[counter].store(0, std::memory_order_relaxed);
+  }
+
+  const LatencyHistogram& GetLatencies(MetricsOperation operation, MetricsPhase phase) const {
+    return latencies[operation][phase];
+  }
+  uint64_t GetCounter(MetricsCounter counter) const { return counters[counter].load(std::memory_order_relaxed); }
+
+ private:
+  LatencyHistogram latencies[METRICS_OPERATION_COUNT][METRICS_PHASE_COUNT];
+  std::atomic<uint64_t> counters[METRICS_COUNTER_COUNT];
+};
+
+// Measures the phases of a single operation, from the moment it is queued
+class OperationMetrics {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  OperationMetrics(DocumentMetrics* metrics, MetricsOperation operation)
+    : metrics(metrics), operation(operation), queued(Clock::now()) { }
+
+  // Records the time since the operation was queued
+  void Started() { Record(QueuePhase, queued); }
+  // Records the time since the start of a phase
+  void Record(MetricsPhase phase, Clock::time_point start) {
+    if (metrics) {
+      const Clock::duration duration = Clock::now() - start;
+      metrics->Record(operation, phase,
+                      (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+  }
+  // Adds to a counter of the document
+  void Add(MetricsCounter counter, uint64_t amount) {
+    if (metrics)
+      metrics->Add(counter, amount);
+  }
+
+ private:
+  DocumentMetrics* metrics;
+  MetricsOperation operation;
+  Clock::time_point queued;
+};
+
+// Records the time from its creation until it goes out of scope as a phase of the operation
+class MetricsTimer {
+ public:
+  MetricsTimer(OperationMetrics& metrics, MetricsPhase phase)
+    : metrics(metrics), phase(phase), start(OperationMetrics::Clock::now()) { }
+  ~MetricsTimer() { metrics.Record(phase, start); }
+
+ private:
+  OperationMetrics& metrics;
+  MetricsPhase phase;
+  OperationMetrics::Clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <string.h>
+#include <HDTManager.hpp>
+#include "PatternStatistics.h"
+
+using namespace std;
+using namespace hdt;
+
+// Identifies statistics files and the version of their format
+const char STATISTICS_MAGIC[8] = { 'H', 'D', 'T', 'S', 'T', 'A', 'T', '2' };
+
+
+
+/******** Construction ********/
+
+
+// Computes the statistics of the HDT by scanning all of its triples,
+// once in subject order and once in object order.
+void PatternStatistics::Build(HDT* hdt) {
+  Dictionary* dict = hdt->getDictionary();
+  const size_t predicateCount = dict->getMaxPredicateID() + 1;
+  triples = hdt->getTriples()->getNumberOfElements();
+  predicates.assign(predicateCount, Predicate());
+  hasPairs.assign(predicateCount, true);
+  pairs.clear();
+
+  // Count the triples and distinct subjects of every predicate
+  vector<size_t> lastSubjects(predicateCount, 0);
+  IteratorTripleID* it = hdt->getTriples()->search(TripleID(0, 0, 0));
+  while (it->hasNext()) {
+    TripleID* triple = it->next();
+    size_t predicate = triple->getPredicate();
+    predicates[predicate].triples++;
+    if (lastSubjects[predicate] != triple->getSubject()) {
+      lastSubjects[predicate] = triple->getSubject();
+      predicates[predicate].subjects++;
+    }
+  }
+  delete it;
+
+  // Count the distinct objects of every predicate, and the pairs of predicates with few of them
+  vector<size_t> objectCounts(predicateCount, 0), objectPredicates;
+  vector<vector<pair<uint64_t, uint64_t> > > predicatePairs(predicateCount);
+  for (size_t object = 1; object <= dict->getMaxObjectID(); object++) {
+    it = hdt->getTriples()->search(TripleID(0, 0, object));
+    while (it->hasNext()) {
+      size_t predicate = it->next()->getPredicate();
+      if (!objectCounts[predicate]++)
+        objectPredicates.push_back(predicate);
+    }
+    delete it;
+
+    for (size_t i = 0; i < objectPredicates.size(); i++) {
+      size_t predicate = objectPredicates[i];
+      predicates[predicate].objects++;
+      if (hasPairs[predicate]) {
+        if (predicatePairs[predicate].size() < MAX_COUNTED_OBJECTS) {
+          predicatePairs[predicate].push_back(make_pair(object, objectCounts[predicate]));
+        }
+        else {
+          hasPairs[predicate] = false;
+          vector<pair<uint64_t, uint64_t> >().swap(predicatePairs[predicate]);
+        }
+      }
+      objectCounts[predicate] = 0;
+    }
+    objectPredicates.clear();
+  }
+  for (size_t predicate = 1; predicate < predicateCount; predicate++)
+    for (size_t i = 0; i < predicatePairs[predicate].size(); i++)
+      pairs[make_pair(predicate, predicatePairs[predicate][i].first)] = predicatePairs[predicate][i].second;
+}
+
+
+
+/******** Storage ********/
+
+
+// Reads the statistics from the file, returning false if it does not exist or does not match the HDT.
+bool PatternStatistics::Load(const string& filename, HDT* hdt, const SourceFingerprint& source) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file)
+    return false;
+  char magic[sizeof(STATISTICS_MAGIC)];
+  uint64_t predicateCount = 0, pairCount = 0;
+  SourceFingerprint fingerprint;
+  bool valid = fread(magic, sizeof(magic), 1, file) == 1 && !memcmp(magic, STATISTICS_MAGIC, sizeof(magic)) &&
+               fread(&fingerprint, sizeof(fingerprint), 1, file) == 1 &&
+               fread(&triples, sizeof(triples), 1, file) == 1 &&
+               fread(&predicateCount, sizeof(predicateCount), 1, file) == 1 &&
+               // Statistics of another version of the HDT are outdated
+               fingerprint == source && triples == hdt->getTriples()->getNumberOfElements() &&
+               predicateCount == hdt->getDictionary()->getMaxPredicateID() + 1;
+
+  // Read the statistics of every predicate
+  if (valid) {
+    predicates.resize(predicateCount);
+    hasPairs.resize(predicateCount);
+    for (size_t i = 0; valid && i < predicateCount; i++) {
+      uint8_t hasPredicatePairs = 0;
+      valid = fread(&predicates[i], sizeof(Predicate), 1, file) == 1 &&
+              fread(&hasPredicatePairs, sizeof(hasPredicatePairs), 1, file) == 1;
+      hasPairs[i] = hasPredicatePairs;
+    }
+  }
+  // Read the counts of predicate–object pairs
+  valid = valid && fread(&pairCount, sizeof(pairCount), 1, file) == 1;
+  pairs.clear();
+  for (size_t i = 0; valid && i < pairCount; i++) {
+    uint64_t values[3];
+    valid = fread(values, sizeof(values), 1, file) == 1;
+    pairs[make_pair(values[0], values[1])] = values[2];
+  }
+  fclose(file);
+  return valid;
+}
+
+// Writes the statistics to the file, returning false on failure.
+// The file is written under a temporary name first, such that readers never see a partial file.
+bool PatternStatistics::Save(const string& filename, const SourceFingerprint& source) const {
+  string temporaryFilename = filename + ".tmp";
+  FILE* file = fopen(temporaryFilename.c_str(), "wb");
+  if (!file)
+    return false;
+  uint64_t predicateCount = predicates.size(), pairCount = pairs.size();
+  bool valid = fwrite(STATISTICS_MAGIC, sizeof(STATISTICS_MAGIC), 1, file) == 1 &&
+               fwrite(&source, sizeof(source), 1, file) == 1 &&
+               fwrite(&triples, sizeof(triples), 1, file) == 1 &&
+               fwrite(&predicateCount, sizeof(predicateCount), 1, file) == 1;
+  for (size_t i = 0; valid && i < predicateCount; i++) {
+    uint8_t hasPredicatePairs = hasPairs[i];
+    valid = fwrite(&predicates[i], sizeof(Predicate), 1, file) == 1 &&
+            fwrite(&hasPredicatePairs, sizeof(hasPredicatePairs), 1, file) == 1;
+  }
+  valid = valid && fwrite(&pairCount, sizeof(pairCount), 1, file) == 1;
+  map<pair<uint64_t, uint64_t>, uint64_t>::const_iterator it;
+  for (it = pairs.begin(); valid && it != pairs.end(); it++) {
+    const uint64_t values[3] = { it->first.first, it->first.second, it->second };
+    valid = fwrite(values, sizeof(values), 1, file) == 1;
+  }
+  valid = fclose(file) == 0 && valid;
+  if (valid)
+    valid = rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+  if (!valid)
+    remove(temporaryFilename.c_str());
+  return valid;
+}
+
+
+
+/******** Lookup ********/
+
+
+// Sets count to the exact number of matches of the pattern, returning false if that is unknown.
+bool PatternStatistics::Count(const TripleID& pattern, uint64_t& count) const {
+  const size_t subject = pattern.getSubject(), predicate = pattern.getPredicate(), object = pattern.getObject();
+  if (!subject && !predicate && !object) {
+    count = triples;
+    return true;
+  }
+  // Only patterns with a predicate and no subject are counted
+  if (subject || !predicate || predicate >= predicates.size())
+    return false;
+  if (!object) {
+    count = predicates[predicate].triples;
+    return true;
+  }
+  if (!hasPairs[predicate])
+    return false;
+  map<pair<uint64_t, uint64_t>, uint64_t>::const_iterator entry = pairs.find(make_pair(predicate, object));
+  count = entry == pairs.end() ? 0 : entry->second;
+  return true;
+}
+
+// Returns the statistics of the predicate with the given ID, or NULL if it does not exist.
+const PatternStatistics::Predicate* PatternStatistics::GetPredicate(size_t predicate) const {
+  return predicate && predicate < predicates.size() ? &predicates[predicate] : NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef PATTERNSTATISTICS_H
+#define PATTERNSTATISTICS_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <HDTManager.hpp>
+#include "SourceFingerprint.h"
+
+// Predicates with at most this many distinct objects have exact counts for every predicate–object pair
+const size_t MAX_COUNTED_OBJECTS = 4096;
+
+// Exact cardinalities of a document's triple patterns, which are computed once and stored in a sidecar file.
+// They contain the number of triples and distinct subjects and objects of every predicate,
+// and the number of triples of every predicate–object pair of predicates with few distinct objects.
+class PatternStatistics {
+ public:
+  // Statistics of a single predicate
+  struct Predicate {
+    uint64_t triples, subjects, objects;
+  };
+
+  PatternStatistics() : triples(0) { }
+
+  // Computes the statistics of the HDT by scanning all of its triples
+  void Build(hdt::HDT* hdt);
+  // Reads the statistics from the file, returning false if it does not exist or does not match the HDT
+  // or the version of its file
+  bool Load(const std::string& filename, hdt::HDT* hdt, const SourceFingerprint& source);
+  // Writes the statistics to the file together with the fingerprint of the HDT file, returning false on failure
+  bool Save(const std::string& filename, const SourceFingerprint& source) const;
+
+  // Sets count to the exact number of matches of the pattern, returning false if that is unknown
+  bool Count(const hdt::TripleID& pattern, uint64_t& count) const;
+  // Returns the statistics of the predicate with the given ID, or NULL if it does not exist
+  const Predicate* GetPredicate(size_t predicate) const;
+
+ private:
+  uint64_t triples;
+  std::vector<Predicate> predicates;
+  // Counts of predicate–object pairs, for predicates whose pairs were all counted
+  std::map<std::pair<uint64_t, uint64_t>, uint64_t> pairs;
+  std::vector<bool> hasPairs;
+};
+
+#endif
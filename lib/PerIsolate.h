@@ -0,0 +1,60 @@
+#ifndef PERISOLATE_H
+#define PERISOLATE_H
+
+#include <nan.h>
+#include <mutex>
+#include <unordered_map>
+
+// A persistent handle of which every JavaScript environment, such as the main thread and each worker thread,
+// has its own copy, since handles cannot be used across isolates. A copy is reset when its environment exits.
+template <typename T>
+class PerIsolate {
+ public:
+  PerIsolate() { }
+
+  // Returns the handle of the current isolate, which is empty until it is set
+  Nan::Persistent<T>& Get() {
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    std::lock_guard<std::mutex> lock(mutex);
+    Nan::Persistent<T>*& handle = handles[isolate];
+    if (!handle) {
+      handle = new Nan::Persistent<T>();
+#if NODE_MODULE_VERSION >= NODE_10_0_MODULE_VERSION
+      node::AddEnvironmentCleanupHook(isolate, Remove, new Owner(this, isolate));
+#endif
+    }
+    // Only the isolate itself removes its handle, so the reference remains valid without the lock
+    return *handle;
+  }
+
+ private:
+  // Identifies the handle of an isolate when its environment exits
+  struct Owner {
+    PerIsolate* handles;
+    v8::Isolate* isolate;
+
+    Owner(PerIsolate* handles, v8::Isolate* isolate) : handles(handles), isolate(isolate) { }
+  };
+
+  std::mutex mutex;
+  std::unordered_map<v8::Isolate*, Nan::Persistent<T>*> handles;
+
+  // Resets and removes the handle of an exiting environment, whose isolate can be reused afterwards
+  static void Remove(void* data) {
+    Owner* owner = (Owner*)data;
+    Nan::Persistent<T>* handle;
+    {
+      std::lock_guard<std::mutex> lock(owner->handles->mutex);
+      handle = owner->handles->handles[owner->isolate];
+      owner->handles->handles.erase(owner->isolate);
+    }
+    handle->Reset();
+    delete handle;
+    delete owner;
+  }
+
+  PerIsolate(const PerIsolate&);
+  PerIsolate& operator=(const PerIsolate&);
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <HDTManager.hpp>
+#include "PrefixRange.h"
+
+using namespace std;
+using namespace hdt;
+
+
+
+/******** Binary search ********/
+
+
+// Returns whether the term with the given ID is a literal
+static bool isLiteral(Dictionary* dict, uint64_t id, TripleComponentRole position) {
+  string term(dict->idToString(id, position));
+  return !term.empty() && term[0] == '"';
+}
+
+// Returns the first ID of the sorted range whose term does not sort before the prefix,
+// or, if past is set, whose term sorts after all terms that start with the prefix
+static uint64_t findBound(Dictionary* dict, TripleComponentRole position, const string& prefix,
+                          uint64_t first, uint64_t end, bool past) {
+  while (first < end) {
+    const uint64_t middle = first + (end - first) / 2;
+    const int comparison = string(dict->idToString(middle, position)).compare(0, prefix.size(), prefix);
+    if (comparison < 0 || (past && comparison == 0))
+      first = middle + 1;
+    else
+      end = middle;
+  }
+  return first;
+}
+
+// Narrows the sorted range to the terms that start with the prefix
+static IdRange findPrefix(Dictionary* dict, TripleComponentRole position, const string& prefix,
+                          const IdRange& range) {
+  if (prefix.empty() || !range.Size())
+    return range;
+  const uint64_t first = findBound(dict, position, prefix, range.first, range.end, false);
+  return IdRange(first, findBound(dict, position, prefix, first, range.end, true));
+}
+
+// Returns the first ID of the range whose term is of another kind than the first one,
+// for ranges with literals and other terms in two sorted blocks
+static uint64_t findKindBoundary(Dictionary* dict, TripleComponentRole position, const IdRange& range) {
+  const bool firstIsLiteral = isLiteral(dict, range.first, position);
+  uint64_t first = range.first + 1, end = range.end;
+  while (first < end) {
+    const uint64_t middle = first + (end - first) / 2;
+    if (isLiteral(dict, middle, position) != firstIsLiteral)
+      end = middle;
+    else
+      first = middle + 1;
+  }
+  return first;
+}
+
+
+
+/******** Lookup ********/
+
+
+// Finds the ranges of the terms with the prefix through binary search in the dictionary.
+void PrefixRange::Find(Dictionary* dict, const string& prefix, TripleComponentRole position) {
+  // Predicates are a single sorted section, subjects and objects also include the shared section
+  const uint64_t sharedCount = position == PREDICATE ? 0 : dict->getNshared();
+  const uint64_t maxId = position == SUBJECT ? dict->getMaxSubjectID() :
+                         position == PREDICATE ? dict->getMaxPredicateID() : dict->getMaxObjectID();
+  IdRange others(sharedCount + 1, maxId + 1), literalIds;
+  // Some dictionaries store object literals apart from other objects, so split them by kind
+  if (position == OBJECT && others.Size()) {
+    const uint64_t boundary = findKindBoundary(dict, position, others);
+    if (isLiteral(dict, others.first, position))
+      literalIds = IdRange(others.first, boundary), others.first = boundary;
+    else
+      literalIds = IdRange(boundary, others.end), others.end = boundary;
+  }
+
+  // Only literals start with a quote, and literals are never shared
+  const bool literalPrefix = !prefix.empty() && prefix[0] == '"';
+  literals = prefix.empty() || literalPrefix ? findPrefix(dict, position, prefix, literalIds) : IdRange();
+  shared = literalPrefix ? IdRange() : findPrefix(dict, position, prefix, IdRange(1, sharedCount + 1));
+  terms  = literalPrefix ? IdRange() : findPrefix(dict, position, prefix, others);
+}
+
+// Appends the IDs of at most limit terms after the offset to ids, in the sorted order of the terms.
+void PrefixRange::Slice(Dictionary* dict, TripleComponentRole position, uint64_t offset, uint64_t limit,
+                        vector<uint64_t>& ids) const {
+  // Literals come first
+  for (uint64_t id = literals.first + offset; id < literals.end && limit; id++, limit--)
+    ids.push_back(id);
+  offset = offset > literals.Size() ? offset - literals.Size() : 0;
+  if (!limit || offset >= shared.Size() + terms.Size())
+    return;
+
+  // Find how many shared terms precede the offset in the merged order, which is the smallest number
+  // of shared terms such that the next shared term sorts after the last preceding other term
+  uint64_t low = offset > terms.Size() ? offset - terms.Size() : 0, high = std::min(offset, shared.Size());
+  while (low < high) {
+    const uint64_t count = low + (high - low) / 2;
+    if (string(dict->idToString(shared.first + count, position)) <
+        string(dict->idToString(terms.first + offset - count - 1, position)))
+      low = count + 1;
+    else
+      high = count;
+  }
+
+  // Merge both ranges from there on
+  uint64_t sharedId = shared.first + low, termId = terms.first + offset - low;
+  string sharedTerm, term;
+  if (sharedId < shared.end)
+    sharedTerm = dict->idToString(sharedId, position);
+  if (termId < terms.end)
+    term = dict->idToString(termId, position);
+  for (; limit && (sharedId < shared.end || termId < terms.end); limit--) {
+    if (termId >= terms.end || (sharedId < shared.end && sharedTerm < term)) {
+      ids.push_back(sharedId++);
+      if (sharedId < shared.end)
+        sharedTerm = dict->idToString(sharedId, position);
+    }
+    else {
+      ids.push_back(termId++);
+      if (termId < terms.end)
+        term = dict->idToString(termId, position);
+    }
+  }
+}
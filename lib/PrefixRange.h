@@ -0,0 +1,34 @@
+#ifndef PREFIXRANGE_H
+#define PREFIXRANGE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <HDTManager.hpp>
+
+// A range [first, end) of dictionary IDs
+struct IdRange {
+  uint64_t first, end;
+
+  IdRange(uint64_t first = 0, uint64_t end = 0) : first(first), end(end) { }
+  uint64_t Size() const { return end - first; }
+};
+
+// The IDs of the terms in a position that start with a prefix.
+// The dictionary stores terms in sorted sections, so these form a few ID ranges:
+// literals, which sort before all other terms, followed by shared subject–objects
+// interleaved with the other terms of the position.
+struct PrefixRange {
+  IdRange literals, shared, terms;
+
+  // Finds the ranges of the terms with the prefix through binary search in the dictionary
+  void Find(hdt::Dictionary* dict, const std::string& prefix, hdt::TripleComponentRole position);
+  // Returns the exact number of terms with the prefix
+  uint64_t Count() const { return literals.Size() + shared.Size() + terms.Size(); }
+  // Appends the IDs of at most limit terms after the offset to ids, in the sorted order of the terms,
+  // decoding only the terms around the offset and within the slice
+  void Slice(hdt::Dictionary* dict, hdt::TripleComponentRole position, uint64_t offset, uint64_t limit,
+             std::vector<uint64_t>& ids) const;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef QUERYCONTROL_H
+#define QUERYCONTROL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+
+// Number of iterations after which a running query checks whether it should stop
+const uint32_t QUERY_CHECK_INTERVAL = 1024;
+
+// Lets a query that runs on a worker thread stop early,
+// either because it was cancelled from the JavaScript thread or because its deadline passed
+class QueryControl {
+ public:
+  // Creates a control with a deadline after the given number of milliseconds; 0 means no deadline
+  QueryControl(uint32_t timeoutMs)
+    : cancelled(false), stopped(false), timedOut(false), hasDeadline(timeoutMs > 0), iterations(0),
+      deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs)) { }
+
+  // Requests the query to stop; can be called from any thread
+  void Cancel() { cancelled = true; }
+
+  // Returns whether the query should stop, which is only checked every QUERY_CHECK_INTERVAL calls
+  // such that iteration loops can call this for every element
+  bool ShouldStop() {
+    return stopped || (++iterations % QUERY_CHECK_INTERVAL == 0 && Check());
+  }
+
+  // Checks right away whether the query should stop
+  bool Check() {
+    if (!stopped) {
+      timedOut = hasDeadline && std::chrono::steady_clock::now() >= deadline;
+      stopped = cancelled || timedOut;
+    }
+    return stopped;
+  }
+
+  // Returns whether the query stopped because it was cancelled
+  bool IsCancelled() const { return stopped && !timedOut; }
+  // Returns whether the query stopped because its deadline passed
+  bool HasTimedOut() const { return stopped && timedOut; }
+
+ private:
+  std::atomic<bool> cancelled;
+  bool stopped, timedOut, hasDeadline;
+  uint32_t iterations;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+// The running queries of a document by ID, such that they can be cancelled.
+// Queries are registered and cancelled on the JavaScript thread only.
+class QueryRegistry {
+ public:
+  // Registers the control of a query under the given ID, unless the ID is 0
+  void Register(uint32_t queryId, QueryControl* control) {
+    if (queryId)
+      queries[queryId] = control;
+  }
+
+  // Removes the query with the given ID
+  void Unregister(uint32_t queryId) { queries.erase(queryId); }
+
+  // Cancels the query with the given ID, if it is still running
+  void Cancel(uint32_t queryId) {
+    std::map<uint32_t, QueryControl*>::iterator query = queries.find(queryId);
+    if (query != queries.end())
+      query->second->Cancel();
+  }
+
+ private:
+  std::map<uint32_t, QueryControl*> queries;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <system_error>
+#include "QueryExecutor.h"
+
+using namespace std;
+
+
+
+/******** Construction and destruction ********/
+
+
+// Creates an executor with the given number of threads.
+QueryExecutor::QueryExecutor(size_t threadCount)
+  : queues(std::max((size_t)1, threadCount)), nextQueue(0), unclaimed(0), stopping(false), pending(0),
+    isolate(v8::Isolate::GetCurrent()) {
+  // The completion handle only keeps the event loop alive while workers are pending
+  completion = new uv_async_t;
+  completion->data = this;
+  uv_async_init(Nan::GetCurrentEventLoop(), completion, Complete);
+  uv_unref((uv_handle_t*)completion);
+  try {
+    for (size_t i = 0; i < queues.size(); i++)
+      threads.push_back(thread(&QueryExecutor::Run, this, i));
+  }
+  catch (const system_error&) { /* continue with the threads that could be started */ }
+#if NODE_MODULE_VERSION >= NODE_10_0_MODULE_VERSION
+  node::AddEnvironmentCleanupHook(isolate, StopOnExit, this);
+#endif
+}
+
+// Frees the completion handle once libuv has closed it.
+static void deleteHandle(uv_handle_t* handle) {
+  delete (uv_async_t*)handle;
+}
+
+// Stops the threads; no workers can be pending at this point.
+QueryExecutor::~QueryExecutor() {
+#if NODE_MODULE_VERSION >= NODE_10_0_MODULE_VERSION
+  node::RemoveEnvironmentCleanupHook(isolate, StopOnExit, this);
+#endif
+  Stop();
+}
+
+// Stops the threads once they have executed the queued workers, and closes the completion handle.
+void QueryExecutor::Stop() {
+  if (!completion)
+    return;
+  {
+    lock_guard<mutex> lock(idleMutex);
+    stopping = true;
+  }
+  idle.notify_all();
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+  threads.clear();
+  uv_close((uv_handle_t*)completion, deleteHandle);
+  completion = NULL;
+}
+
+// Stops the executor when its JavaScript environment exits, since the event loop of a worker thread
+// cannot close while the completion handle is open; the callbacks of workers still pending are not called.
+void QueryExecutor::StopOnExit(void* executor) {
+  ((QueryExecutor*)executor)->Stop();
+}
+
+
+
+/******** Scheduling ********/
+
+
+// Queues the worker, spreading workers over the queues of all threads.
+void QueryExecutor::Queue(Nan::AsyncWorker* worker, QueryPriority priority) {
+  // Without threads, fall back to libuv's thread pool
+  if (threads.empty()) {
+    Nan::AsyncQueueWorker(worker);
+    return;
+  }
+  if (!pending++)
+    uv_ref((uv_handle_t*)completion);
+  {
+    WorkerQueue& queue = queues[nextQueue];
+    lock_guard<mutex> lock(queue.mutex);
+    queue.workers[priority].push_back(worker);
+  }
+  nextQueue = (nextQueue + 1) % queues.size();
+  {
+    lock_guard<mutex> lock(idleMutex);
+    unclaimed++;
+  }
+  idle.notify_one();
+}
+
+// Executes workers on the thread with the given index until the executor stops.
+void QueryExecutor::Run(size_t index) {
+  for (;;) {
+    // Wait until a worker can be claimed
+    {
+      unique_lock<mutex> lock(idleMutex);
+      while (!stopping && !unclaimed)
+        idle.wait(lock);
+      if (!unclaimed)
+        return;
+      unclaimed--;
+    }
+    // Execute the worker and hand it to the event loop
+    Nan::AsyncWorker* worker = Take(index);
+    worker->Execute();
+    {
+      lock_guard<mutex> lock(completedMutex);
+      completed.push_back(worker);
+    }
+    uv_async_send(completion);
+  }
+}
+
+// Removes the most urgent worker, preferring the queue of the given thread.
+// A claimed worker is always available in one of the queues.
+Nan::AsyncWorker* QueryExecutor::Take(size_t index) {
+  for (;;) {
+    for (int priority = 0; priority < QUERY_PRIORITY_COUNT; priority++) {
+      for (size_t i = 0; i < queues.size(); i++) {
+        WorkerQueue& queue = queues[(index + i) % queues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        deque<Nan::AsyncWorker*>& workers = queue.workers[priority];
+        if (!workers.empty()) {
+          Nan::AsyncWorker* worker = workers.front();
+          workers.pop_front();
+          return worker;
+        }
+      }
+    }
+  }
+}
+
+// Calls the callbacks of executed workers on the event loop.
+void QueryExecutor::Complete(uv_async_t* handle) {
+  QueryExecutor* executor = (QueryExecutor*)handle->data;
+  vector<Nan::AsyncWorker*> workers;
+  {
+    lock_guard<mutex> lock(executor->completedMutex);
+    workers.swap(executor->completed);
+  }
+  // Update the executor before the callbacks, which can release the document that owns it
+  executor->pending -= workers.size();
+  if (!executor->pending)
+    uv_unref((uv_handle_t*)handle);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i]->WorkComplete();
+    workers[i]->Destroy();
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef QUERYEXECUTOR_H
+#define QUERYEXECUTOR_H
+
+#include <nan.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Priority classes of queries, from most to least urgent
+enum QueryPriority {
+  HighPriority,   // Cheap lookups, such as counts and ID conversions
+  NormalPriority, // First pages and other bounded searches
+  LowPriority,    // Long scans, such as exports and large pages
+};
+const int QUERY_PRIORITY_COUNT = 3;
+
+// Runs asynchronous workers on a dedicated pool of threads instead of libuv's shared thread pool.
+// Every thread has its own queue per priority class, and takes work from the other threads when idle.
+// Completed workers are handed back to the event loop, which calls their JavaScript callbacks.
+class QueryExecutor {
+ public:
+  QueryExecutor(size_t threadCount);
+  ~QueryExecutor();
+
+  // Queues the worker, which the executor deletes once completed;
+  // must be called from the JavaScript thread
+  void Queue(Nan::AsyncWorker* worker, QueryPriority priority);
+
+ private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Nan::AsyncWorker*> workers[QUERY_PRIORITY_COUNT];
+  };
+
+  std::vector<std::thread> threads;
+  std::vector<WorkerQueue> queues;
+  size_t nextQueue;
+  // Number of queued workers that no thread has claimed yet
+  std::mutex idleMutex;
+  std::condition_variable idle;
+  size_t unclaimed;
+  bool stopping;
+  // Executed workers that wait for their callbacks on the event loop
+  std::mutex completedMutex;
+  std::vector<Nan::AsyncWorker*> completed;
+  uv_async_t* completion;
+  size_t pending;
+  v8::Isolate* isolate;
+
+  // Executes workers on the thread with the given index until the executor stops
+  void Run(size_t index);
+  // Removes the most urgent worker, preferring the queue of the given thread
+  Nan::AsyncWorker* Take(size_t index);
+  // Calls the callbacks of executed workers on the event loop
+  static void Complete(uv_async_t* handle);
+  // Stops the threads and closes the completion handle, which the event loop needs before it can exit
+  void Stop();
+  // Stops the executor when its JavaScript environment exits, such as at the end of a worker thread
+  static void StopOnExit(void* executor);
+};
+
+#endif
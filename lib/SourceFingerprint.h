@@ -0,0 +1,35 @@
+#ifndef SOURCEFINGERPRINT_H
+#define SOURCEFINGERPRINT_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <string>
+
+// Identifies the version of the HDT file from which a sidecar file was computed by its size and modification time,
+// such that the sidecar of a file that was regenerated or replaced is recognized as outdated
+struct SourceFingerprint {
+  uint64_t size, modified;
+
+  SourceFingerprint() : size(0), modified(0) { }
+
+  // Returns the fingerprint of the file, which is empty if the file cannot be read
+  static SourceFingerprint Of(const std::string& filename) {
+    SourceFingerprint fingerprint;
+    struct stat status;
+    if (!stat(filename.c_str(), &status)) {
+      fingerprint.size = (uint64_t)status.st_size;
+#ifdef __APPLE__
+      fingerprint.modified = (uint64_t)status.st_mtimespec.tv_sec * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+      fingerprint.modified = (uint64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+    }
+    return fingerprint;
+  }
+
+  bool operator==(const SourceFingerprint& other) const {
+    return size == other.size && modified == other.modified;
+  }
+};
+
+#endif
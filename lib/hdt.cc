@@ -1,14 +1,22 @@
 #include <node.h>
 #include <nan.h>
 #include "HdtDocument.h"
+#include "HdtCursor.h"
 
 using namespace v8;
 
 NAN_MODULE_INIT(InitHdtModule) {
   Nan::Set(target, Nan::New("HdtDocument").ToLocalChecked(),
                    Nan::New(HdtDocument::GetConstructor()));
+  Nan::Set(target, Nan::New("HdtCursor").ToLocalChecked(),
+                   Nan::New(HdtCursor::GetConstructor()));
   Nan::Set(target, Nan::New("createHdtDocument").ToLocalChecked(),
                    Nan::GetFunction(Nan::New<FunctionTemplate>(HdtDocument::Create)).ToLocalChecked());
+  Nan::Set(target, Nan::New("generateHdtDocument").ToLocalChecked(),
+                   Nan::GetFunction(Nan::New<FunctionTemplate>(HdtDocument::Generate)).ToLocalChecked());
+  Nan::Set(target, Nan::New("searchHdtUnion").ToLocalChecked(),
+                   Nan::GetFunction(Nan::New<FunctionTemplate>(HdtDocument::SearchUnion)).ToLocalChecked());
 }
 
-NODE_MODULE(hdt, InitHdtModule)
+// The module can be loaded by several worker threads, which each get their own constructors
+NAN_MODULE_WORKER_ENABLED(hdt, InitHdtModule)
@@ -1,48 +1,353 @@
 import * as RDF from "@rdfjs/types";
+import { Readable } from "stream";
 
-export interface SearchTermsOpts {
+export interface QueryOpts {
+  // Signal that stops the query and rejects its promise with an AbortError
+  signal?: AbortSignal;
+  // Number of milliseconds after which the query stops and returns what it found so far
+  timeoutMs?: number;
+}
+
+export interface SearchTermsOpts extends QueryOpts {
   limit?: number;
+  offset?: number; // only applies to prefixes
   position?: "subject" | "predicate" | "object";
   prefix?: string;
   subject?: string; // mutually exclusive with prefix and prioritized
   object?: string, // mutually exclusive with prefix and prioritized
 }
 
-export interface SearchLiteralsOpts {
-  limit?: number;
-  offset?: number;
+export interface SearchTermsByPrefixOpts {
+  limit?: number | bigint;
+  offset?: number | bigint;
+  position?: "subject" | "predicate" | "object"; // defaults to object
+}
+
+export interface SearchTermsByPrefixResult {
+  terms: RDF.Term[];
+  // Exact number of terms with the prefix
+  totalCount: number;
+  // Dictionary ID ranges [first, end) that contain the terms with the prefix
+  ranges: [number, number][];
+}
+
+export interface SearchLiteralsOpts extends QueryOpts {
+  limit?: number | bigint;
+  offset?: number | bigint;
+  // How the query matches literals; modes other than substring need a literal index
+  mode?: "substring" | "token" | "regex" | "regexIgnoreCase";
+  // Continues after the literals of a previous result
+  continuation?: string;
 }
 
 export interface SearchLiteralsResult {
   literals: RDF.Literal[];
   totalCount: number;
+  // Whether totalCount is exact, which it is not if the timeout passed while counting
+  hasExactCount: boolean;
+  // Whether the literals are incomplete because the timeout passed
+  timedOut?: boolean;
+  // Continuation for the next page, or null if there are no more matches or no literal index
+  continuation?: string | null;
 }
 
 export interface SearchTriplesOpts {
-  limit?: number;
-  offset?: number;
+  limit?: number | bigint;
+  offset?: number | bigint;
+}
+
+export interface SearchTriplesPageOpts extends SearchTriplesOpts, QueryOpts {
+  // Token of a previous result at which to continue, instead of the offset
+  continuation?: string;
+}
+
+export interface SearchTriplesColumnarOpts extends SearchTriplesPageOpts {
+  columnar: true;
 }
 
 export interface SearchResult {
   triples: RDF.Quad[];
   totalCount: number;
   hasExactCount: boolean;
+  // Token to retrieve the next page, or null if there are no more triples
+  continuation?: string | null;
+  // Whether the triples are incomplete because the timeout passed
+  timedOut?: boolean;
+}
+
+export interface TripleColumns extends Iterable<RDF.Quad> {
+  // For every triple, the positions of its subject, predicate, and object in the string tables
+  ids: Uint32Array;
+  subjects: string[];
+  predicates: string[];
+  objects: string[];
+  length: number;
+
+  subject(index: number): RDF.Term;
+  predicate(index: number): RDF.Term;
+  object(index: number): RDF.Term;
+  get(index: number): RDF.Quad;
+  toArray(): RDF.Quad[];
+}
+
+export interface ColumnarSearchResult {
+  columns: TripleColumns;
+  totalCount: number;
+  hasExactCount: boolean;
+  continuation: string | null;
+  timedOut?: boolean;
+}
+
+export interface BatchPattern extends SearchTriplesOpts {
+  subject?: RDF.Term | null;
+  predicate?: RDF.Term | null;
+  object?: RDF.Term | null;
+}
+
+export interface SearchTriplesBatchOpts {
+  // Number of threads over which the patterns are divided
+  threads?: number;
+}
+
+export interface SearchTriplesCursorOpts extends SearchTriplesOpts {
+  batchSize?: number;
+}
+
+export interface Cursor extends AsyncIterable<RDF.Quad> {
+  totalCount: number;
+  hasExactCount: boolean;
+  done: boolean;
+  closed: boolean;
+
+  next(batchSize?: number): Promise<RDF.Quad[]>;
+
+  stream(batchSize?: number): Readable;
+
+  close(): Promise<void>;
+}
+
+export interface SearchTripleIdsResult {
+  // The subject, predicate, and object ID of every matching triple
+  ids: Uint32Array;
+  totalCount: number;
+  hasExactCount: boolean;
+}
+
+export interface IdRanges {
+  // Subject and object IDs up to this number denote the same term
+  shared: number;
+  subject: number;
+  predicate: number;
+  object: number;
+}
+
+export type TriplePattern = RDF.BaseQuad | [RDF.Term | null, RDF.Term | null, RDF.Term | null];
+
+export interface EvaluateBGPOpts {
+  limit?: number;
+  offset?: number;
+}
+
+export interface BGPResult {
+  variables: string[];
+  // One object per solution, mapping variable names to terms
+  bindings: Record<string, RDF.Term>[];
+}
+
+export interface CacheStats {
+  hits: number;
+  misses: number;
+  evictions: number;
+  // Entries that were not cached because they exceed the capacity of a shard
+  oversized: number;
+  entries: number;
+  bytes: number;
+  capacity: number;
+}
+
+// Latencies in microseconds; percentiles are accurate to within 25%
+export interface LatencyStats {
+  count: number;
+  mean: number;
+  p50: number;
+  p90: number;
+  p99: number;
+  max: number;
 }
 
+export type OperationPhase = "queue" | "resolve" | "skip" | "decode" | "execute" | "callback";
+
+export interface DocumentStats {
+  // Latencies of the phases of every operation that ran, such as searchTriples
+  operations: Record<string, Partial<Record<OperationPhase, LatencyStats>>>;
+  counters: {
+    triplesScanned: number;
+    triplesReturned: number;
+    termsDecoded: number;
+    bytesAllocated: number;
+  };
+  termCache: CacheStats;
+  pageCache: CacheStats;
+}
+
+export type Position = "subject" | "predicate" | "object";
+
 export interface Document {
-  searchTriples(sub?: RDF.Term, pred?: RDF.Term, obj?: RDF.Term, opts?: SearchTriplesOpts): Promise<SearchResult>;
+  searchTriples(sub: RDF.Term | null | undefined, pred: RDF.Term | null | undefined, obj: RDF.Term | null | undefined,
+                opts: SearchTriplesColumnarOpts): Promise<ColumnarSearchResult>;
+  searchTriples(sub?: RDF.Term, pred?: RDF.Term, obj?: RDF.Term, opts?: SearchTriplesPageOpts): Promise<SearchResult>;
+
+  searchTriplesBatch(patterns: BatchPattern[], opts: SearchTriplesBatchOpts & { columnar: true }): Promise<ColumnarSearchResult[]>;
+  searchTriplesBatch(patterns: BatchPattern[], opts?: SearchTriplesBatchOpts): Promise<SearchResult[]>;
+
+  searchTriplesCursor(sub?: RDF.Term, pred?: RDF.Term, obj?: RDF.Term, opts?: SearchTriplesOpts): Promise<Cursor>;
+
+  streamTriples(sub?: RDF.Term, pred?: RDF.Term, obj?: RDF.Term, opts?: SearchTriplesCursorOpts): Readable;
+
+  // Resolves to the number of written triples
+  exportTo(target: string | number, opts?: ExportOpts): Promise<number>;
 
   countTriples(sub?: RDF.Term, pred?: RDF.Term, obj?: RDF.Term): Promise<SearchResult>;
 
-  searchLiterals(substring: string, opts?: SearchLiteralsOpts): Promise<SearchLiteralsResult>;
+  searchTripleIds(sub?: number, pred?: number, obj?: number, opts?: SearchTriplesOpts): Promise<SearchTripleIdsResult>;
+
+  termToId(term: RDF.Term, position: Position): Promise<number>;
+  termToId(terms: RDF.Term[], position: Position): Promise<Uint32Array>;
+
+  idToTerm(id: number, position: Position): Promise<RDF.Term | null>;
+  idToTerm(ids: Uint32Array | number[], position: Position): Promise<(RDF.Term | null)[]>;
+
+  idRanges: IdRanges;
+
+  termCacheStats: CacheStats;
+
+  pageCacheStats: CacheStats;
+
+  stats(opts?: { reset?: boolean }): DocumentStats;
+
+  memory(): MemoryStats;
+
+  // Resolves once the sections of the memory option are prefetched, to false if the document was closed first
+  readonly memoryReady: Promise<boolean>;
+
+  // Resolves once the document has its index, which is built in the background with the backgroundIndex option
+  indexReady: Promise<void>;
+
+  evaluateBGP(patterns: TriplePattern[], opts?: EvaluateBGPOpts): Promise<BGPResult>;
+
+  searchLiterals(query: string | RegExp, opts?: SearchLiteralsOpts): Promise<SearchLiteralsResult>;
 
   searchTerms(opts?: SearchTermsOpts): Promise<string[]>;
 
+  searchTermsByPrefix(prefix: string, opts?: SearchTermsByPrefixOpts): Promise<SearchTermsByPrefixResult>;
+
   close(): Promise<void>;
 
   readHeader(): Promise<string>;
 
-  changeHeader(triples: string, outputFile: string): Promise<Document>;
+  changeHeader(triples: string, outputFile: string, opts?: ChangeHeaderOpts): Promise<Document>;
+}
+
+export interface ChangeHeaderOpts {
+  // Copy the index of the document next to the output file (default true)
+  copyIndex?: boolean;
+}
+
+export interface ExportOpts {
+  // N-Triples (the default) or N-Quads, which are identical for HDT documents
+  format?: string;
+  // Number of threads that encode triples; defaults to the number of CPUs
+  threads?: number;
+}
+
+export type MemorySection = "header" | "dictionary" | "triples" | "index";
+export type MemoryAdvice = "normal" | "random" | "sequential";
+
+export interface MemoryOpts {
+  // Expected access pattern of all sections, or per section
+  advice?: MemoryAdvice | { [section in MemorySection]?: MemoryAdvice };
+  // Whether to back the advised sections with huge pages where the system supports it
+  hugePages?: boolean;
+  // Sections to keep in memory, as far as the system allows
+  lock?: MemorySection[];
+  // Sections to read into memory in the background, in order
+  prefetch?: MemorySection[];
+}
+
+export interface MemorySectionStats {
+  mapped: number;
+  resident: number;
+  locked: boolean;
+}
+
+export type MemoryStats = { [section in MemorySection]: MemorySectionStats };
+
+export interface FromFileOpts {
+  dataFactory?: RDF.DataFactory;
+  // Number of bytes of decoded terms to cache; 0 disables the cache
+  termCacheSize?: number;
+  // Number of bytes of search results to cache; 0 (the default) disables the cache
+  pageCacheSize?: number;
+  // Number of threads that run the document's queries; 0 (the default) uses libuv's thread pool
+  threads?: number;
+  // Whether to use exact pattern statistics, stored next to the file with a .stats extension
+  statistics?: boolean;
+  // Whether to search literals through a full-text index, stored next to the file with a .literals extension
+  literalIndex?: boolean;
+  // Whether to open the document before its index is loaded or built, which then happens in the background
+  backgroundIndex?: boolean;
+  // Whether to share the mapped file with the other shared documents of the same file in any worker thread,
+  // which requires the index to be loaded while opening
+  shared?: boolean;
+  // Directory in which to store the index, statistics, and literal index instead of next to the file
+  indexDirectory?: string;
+  // Receives progress reports while the document is opened and its index is built
+  onProgress?: (progress: IndexProgress) => void;
+  // Controls which sections of the document's files stay in memory
+  memory?: MemoryOpts;
+}
+
+export interface IndexProgress {
+  // The step that libhdt is performing
+  stage: string;
+  // The percentage of the step that is done
+  level: number;
+}
+
+export function fromFile(filename: string, opts?: FromFileOpts): Promise<Document>;
+
+export interface FromRdfOpts extends FromFileOpts {
+  // Media type or name of the input format; N-Triples by default
+  format?: string;
+  // Base IRI of the dataset, recorded in the header
+  baseIri?: string;
+  // Whether to read the input twice instead of keeping all of its triples in memory
+  lowMemory?: boolean;
+}
+
+export function fromRdf(input: string | NodeJS.ReadableStream, outputFile: string, opts?: FromRdfOpts): Promise<Document>;
+
+export interface UnionSearchOpts extends SearchTriplesOpts {
+  // Whether to leave out triples that also occur in an earlier document
+  deduplicate?: boolean;
+}
+
+export interface UnionDocument {
+  // The documents of the union, in the order in which their triples are returned
+  readonly documents: Document[];
+  readonly closed: boolean;
+
+  searchTriples(sub?: RDF.Term | null, pred?: RDF.Term | null, obj?: RDF.Term | null,
+                opts?: UnionSearchOpts): Promise<SearchResult>;
+
+  countTriples(sub?: RDF.Term | null, pred?: RDF.Term | null, obj?: RDF.Term | null): Promise<SearchResult>;
+
+  close(): Promise<void>;
+}
+
+export interface FromFilesOpts extends FromFileOpts {
+  // Whether searches leave out triples that also occur in an earlier document by default
+  deduplicate?: boolean;
 }
 
-export function fromFile(filename: string, opts?: { dataFactory?: RDF.DataFactory }): Promise<Document>;
+export function fromFiles(filenames: string[], opts?: FromFilesOpts): Promise<UnionDocument>;
@@ -1,10 +1,20 @@
 const N3 = require('n3');
+const crypto = require('crypto');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { Readable, pipeline } = require('stream');
 const { stringQuadToQuad, stringToTerm, termToString } = require('rdf-string');
 
 /*     Auxiliary methods for HdtDocument     */
 const hdtNative = require('../build/Release/hdt');
 const HdtDocumentPrototype = hdtNative.HdtDocument.prototype;
-const MAX = Math.pow(2, 31) - 1;
+const MAX = Number.MAX_SAFE_INTEGER;
+const MAX_ID = Math.pow(2, 32) - 1;
+const DEFAULT_BATCH_SIZE = 1024;
+const MAX_BATCH_SIZE = Math.pow(2, 31) - 1;
+const MAX_BATCH_THREADS = 64;
+let lastQueryId = 0;
 
 const closedError = Promise.reject(new Error('The HDT document cannot be accessed because it is closed'));
 closedError.catch(e => {});
@@ -20,30 +30,127 @@ HdtDocumentPrototype.searchTriples = function (subject, predicate, object, optio
   if (!isValidHdtTerm(predicate)) predicate = null;
   if (!isValidHdtTerm(object)) object = null;
   options = options || {};
-  const dataFactory = this.dataFactory;
-  return new Promise((resolve, reject) => {
+  const dataFactory = this.dataFactory, columnar = !!options.columnar;
+  return runQuery(this, options, (queryId, timeoutMs, resolve, reject) => {
     this._searchTriples(termToString(subject) || '', termToString(predicate) || '', termToString(object) || '',
+      parseOffset(options), parseLimit(options), columnar, options.continuation || '', queryId, timeoutMs,
+      (err, triples, totalCount, hasExactCount, continuation, timedOut) =>
+        err ? reject(err) : resolve(columnar ?
+          { columns: new TripleColumns(triples, dataFactory), totalCount, hasExactCount, continuation, timedOut } :
+          { triples: triples.map((t) => stringQuadToQuad(t, dataFactory)), totalCount, hasExactCount, continuation,
+            timedOut }));
+  });
+};
+
+// Searches the document for several patterns of subject, predicate, object, offset, and limit at once.
+HdtDocumentPrototype.searchTriplesBatch = function (patterns, options) {
+  if (this.closed) return closedError;
+  options = options || {};
+  patterns = patterns || [];
+  // Flatten the patterns into components and ranges
+  const components = [], ranges = new Float64Array(2 * patterns.length);
+  patterns.forEach((pattern, i) => {
+    for (const term of [pattern.subject, pattern.predicate, pattern.object])
+      components.push(isValidHdtTerm(term) ? termToString(term) : '');
+    ranges[2 * i] = parseOffset(pattern);
+    ranges[2 * i + 1] = parseLimit(pattern);
+  });
+  const dataFactory = this.dataFactory, columnar = !!options.columnar;
+  const threads = Math.max(1, Math.min(MAX_BATCH_THREADS, parseInt(options.threads, 10) || 1));
+  return new Promise((resolve, reject) => {
+    this._searchTriplesBatch(components, ranges, columnar, threads, (err, results) => {
+      if (err) return reject(err);
+      resolve(results.map(([triples, totalCount, hasExactCount]) => columnar ?
+        { columns: new TripleColumns(triples, dataFactory), totalCount, hasExactCount } :
+        { triples: triples.map(t => stringQuadToQuad(t, dataFactory)), totalCount, hasExactCount }));
+    });
+  });
+};
+
+// Opens a cursor over the triples with the given subject, predicate, and object.
+HdtDocumentPrototype.searchTriplesCursor = function (subject, predicate, object, options) {
+  if (this.closed) return closedError;
+  if (!isValidHdtTerm(subject)) subject = null;
+  if (!isValidHdtTerm(predicate)) predicate = null;
+  if (!isValidHdtTerm(object)) object = null;
+  options = options || {};
+  return new Promise((resolve, reject) => {
+    this._searchTriplesCursor(termToString(subject) || '', termToString(predicate) || '', termToString(object) || '',
       parseOffset(options), parseLimit(options),
-      (err, triples, totalCount, hasExactCount) =>
-        err ? reject(err) : resolve({ triples: triples.map((t) => stringQuadToQuad(t, dataFactory)), totalCount, hasExactCount }));
+      (err, cursor, totalCount, hasExactCount) => {
+        if (err) return reject(err);
+        cursor.document = this;
+        cursor.totalCount = totalCount;
+        cursor.hasExactCount = hasExactCount;
+        cursor.done = false;
+        resolve(cursor);
+      });
   });
 };
 
+// Streams the triples with the given subject, predicate, and object.
+HdtDocumentPrototype.streamTriples = function (subject, predicate, object, options) {
+  options = options || {};
+  return cursorStream(this.searchTriplesCursor(subject, predicate, object, options), options.batchSize);
+};
+
+// Writes all triples of the document to a file or file descriptor in N-Triples syntax.
+HdtDocumentPrototype.exportTo = function (target, options) {
+  if (this.closed) return closedError;
+  options = options || {};
+  const format = options.format || 'N-Triples';
+  if (!/^(application\/)?n-?(triples|quads)$/i.test(format))
+    return Promise.reject(new Error('Unsupported export format: ' + format));
+  if (typeof target !== 'number' && (typeof target !== 'string' || target.length === 0))
+    return Promise.reject(new Error('Invalid export target: ' + target));
+  const threads = Math.max(1, Math.min(MAX_BATCH_THREADS, parseInt(options.threads, 10) || os.cpus().length));
+  return new Promise((resolve, reject) =>
+    this._exportTo(target, threads, (err, count) => err ? reject(err) : resolve(count)));
+};
+
 // Gives an approximate number of matches of triples with the given subject, predicate, and object.
 HdtDocumentPrototype.countTriples = function (subject, predicate, object) {
   return this.search(subject, predicate, object, { offset: 0, limit: 0 });
 };
 
-// Searches the document for literals that contain the given string
-HdtDocumentPrototype.searchLiterals = function (substring, options) {
+// Searches the document for literals that match the given string or regular expression
+const LITERAL_SEARCH_MODES = {
+  substring: 0,
+  token: 1,
+  regex: 2,
+  regexIgnoreCase: 3,
+};
+HdtDocumentPrototype.searchLiterals = function (query, options) {
   if (this.closed) return closedError;
   options = options || {};
   const dataFactory = this.dataFactory;
-  return new Promise((resolve, reject) => {
-    this._searchLiterals(substring,
-      parseOffset(options), parseLimit(options),
-      (err, literals, totalCount) =>
-        err ? reject(err) : resolve({ literals: literals.map(l => stringToTerm(l, dataFactory)), totalCount }));
+  let mode = LITERAL_SEARCH_MODES[options.mode || 'substring'];
+  if (query instanceof RegExp) {
+    // Other flags change which literals match, which the native regular expressions cannot mirror
+    const flags = query.flags.replace('i', '');
+    if (flags)
+      return Promise.reject(new Error('Unsupported regular expression flags: ' + flags));
+    mode = query.ignoreCase ? LITERAL_SEARCH_MODES.regexIgnoreCase : LITERAL_SEARCH_MODES.regex;
+    query = query.source;
+  }
+  if (mode === undefined)
+    return Promise.reject(new Error('Unsupported literal search mode: ' + options.mode));
+  // Continuations are the ID of the last literal of the previous page
+  const afterId = parseOffset({ offset: options.continuation });
+  const offset = parseOffset(options);
+  return runQuery(this, options, (queryId, timeoutMs, resolve, reject) => {
+    this._searchLiterals(query, mode, offset, parseLimit(options), afterId, queryId, timeoutMs,
+      (err, literals, totalCount, hasExactCount, timedOut, lastId) => {
+        if (err) return reject(err);
+        const hasMore = lastId > 0 && totalCount > offset + literals.length;
+        resolve({
+          literals: literals.map(l => stringToTerm(l, dataFactory)),
+          totalCount,
+          hasExactCount,
+          timedOut,
+          continuation: hasMore ? String(lastId) : null,
+        });
+      });
   });
 };
 
@@ -66,30 +173,126 @@ HdtDocumentPrototype.searchTerms = function (options) {
   // Validate parameters
   if (!(position in POSITIONS))
     return Promise.reject(new Error('Invalid position argument. Expected subject, predicate or object.'));
-  if ((subject || object) && posId !== POSITIONS.predicate)
+  if (subject && object && posId !== POSITIONS.predicate)
     return Promise.reject(new Error('Unsupported position argument. Expected predicate.'));
+  if (subject && posId === POSITIONS.subject)
+    return Promise.reject(new Error('Unsupported position argument. Expected predicate or object.'));
+  if (object && posId === POSITIONS.object)
+    return Promise.reject(new Error('Unsupported position argument. Expected predicate or subject.'));
 
   // Return predicates that connect subject and object
   if (subject && object) {
-    return this.searchTriples(subject, null, object, { limit: limit })
+    const { signal, timeoutMs } = options;
+    return this.searchTriples(subject, null, object, { limit, signal, timeoutMs })
       .then(result => result.triples.map(statement => statement.predicate));
   }
   const dataFactory = this.dataFactory;
   // Return distinct terms
-  return new Promise((resolve, reject) => {
+  return runQuery(this, options, (queryId, timeoutMs, resolve, reject) => {
     if ('subject' in options || 'object' in options) {
       if (!subject && !object) return resolve([]);
       this._fetchDistinctTerms(termToString(subject) || '', termToString(object) || '', limit, posId,
+        queryId, timeoutMs,
         (error, results) => error ? reject(error) : resolve(results.map(t => stringToTerm(t, dataFactory))));
     }
     // No subject or object values specified, so assuming we're autocompleting a term
     else {
-      this._searchTerms(prefix, limit, posId,
+      this._searchTerms(prefix, parseOffset(options), limit, posId,
         (error, results) => error ? reject(error) : resolve(results.map(t => stringToTerm(t, dataFactory))));
     }
   });
 };
 
+// Searches a page of the terms in a position that start with the given prefix,
+// together with their exact count and the dictionary ID ranges they occupy
+HdtDocumentPrototype.searchTermsByPrefix = function (prefix, options) {
+  if (this.closed) return closedError;
+  options = options || {};
+  const position = options.position || 'object';
+  if (!(position in POSITIONS))
+    return Promise.reject(new Error('Invalid position argument. Expected subject, predicate or object.'));
+  const dataFactory = this.dataFactory;
+  return new Promise((resolve, reject) => {
+    this._searchTerms(prefix || '', parseOffset(options), parseLimit(options), POSITIONS[position],
+      (error, terms, totalCount, ranges) => error ? reject(error) :
+        resolve({ terms: terms.map(t => stringToTerm(t, dataFactory)), totalCount, ranges }));
+  });
+};
+
+// Searches the document for triples with the given subject, predicate, and object IDs.
+// An ID of 0 matches any term.
+HdtDocumentPrototype.searchTripleIds = function (subject, predicate, object, options) {
+  if (this.closed) return closedError;
+  options = options || {};
+  return new Promise((resolve, reject) => {
+    this._searchTripleIds(parseId(subject), parseId(predicate), parseId(object),
+      parseOffset(options), parseLimit(options),
+      (err, ids, totalCount, hasExactCount) =>
+        err ? reject(err) : resolve({ ids, totalCount, hasExactCount }));
+  });
+};
+
+// Converts one or more terms into their IDs in the given position, with 0 for unknown terms.
+HdtDocumentPrototype.termToId = function (terms, position) {
+  if (this.closed) return closedError;
+  if (!(position in POSITIONS))
+    return Promise.reject(new Error('Invalid position argument. Expected subject, predicate or object.'));
+  const single = !Array.isArray(terms);
+  const termStrings = (single ? [terms] : terms).map(t => isValidHdtTerm(t) ? termToString(t) : '');
+  return new Promise((resolve, reject) => {
+    this._termsToIds(termStrings, POSITIONS[position],
+      (err, ids) => err ? reject(err) : resolve(single ? ids[0] : ids));
+  });
+};
+
+// Converts one or more IDs in the given position into terms, with null for unknown IDs.
+HdtDocumentPrototype.idToTerm = function (ids, position) {
+  if (this.closed) return closedError;
+  if (!(position in POSITIONS))
+    return Promise.reject(new Error('Invalid position argument. Expected subject, predicate or object.'));
+  const single = !(ids instanceof Uint32Array || Array.isArray(ids));
+  const idArray = ids instanceof Uint32Array ? ids : Uint32Array.from(single ? [ids] : ids, parseId);
+  const dataFactory = this.dataFactory;
+  return new Promise((resolve, reject) => {
+    this._idsToTerms(idArray, POSITIONS[position], (err, terms) => {
+      if (err) return reject(err);
+      terms = terms.map(t => t ? stringToTerm(t, dataFactory) : null);
+      resolve(single ? terms[0] : terms);
+    });
+  });
+};
+
+// Evaluates a basic graph pattern, given as quads or [subject, predicate, object] arrays.
+HdtDocumentPrototype.evaluateBGP = function (patterns, options) {
+  if (this.closed) return closedError;
+  options = options || {};
+  // Variables are passed as ?name, other invalid terms as wildcards
+  const components = [];
+  for (const pattern of patterns || []) {
+    const terms = Array.isArray(pattern) ? pattern : [pattern.subject, pattern.predicate, pattern.object];
+    for (let i = 0; i < 3; i++) {
+      const term = terms[i];
+      components.push(term && term.termType === 'Variable' ? `?${term.value}` :
+        isValidHdtTerm(term) ? termToString(term) : '');
+    }
+  }
+  const dataFactory = this.dataFactory;
+  return new Promise((resolve, reject) => {
+    this._evaluateBGP(components, parseOffset(options), parseLimit(options),
+      (err, variables, values, rowCount) => {
+        if (err) return reject(err);
+        // Group the flat list of values into one binding per row
+        const bindings = new Array(rowCount), width = variables.length;
+        for (let row = 0; row < rowCount; row++) {
+          const binding = bindings[row] = {};
+          for (let i = 0; i < width; i++)
+            binding[variables[i]] = stringToTerm(values[row * width + i], dataFactory);
+        }
+        resolve({ variables, bindings });
+      });
+  });
+};
+
 // Returns the header of the HDT document as a string.
 HdtDocumentPrototype.readHeader = function () {
   if (this.closed) return closedError;
@@ -97,29 +300,89 @@ HdtDocumentPrototype.readHeader = function () {
     this._readHeader((e, header) => e ? reject(e) : resolve(header)));
 };
 
-// Replaces the current header with a new one and saves result to a new file.
-HdtDocumentPrototype.changeHeader = function (header, outputFile) {
+// Saves the document with a new header to a new file, which is returned as a new document.
+// Only the header is written anew; the other sections, and the index unless
+// the copyIndex option is false, are copied from the document's files.
+HdtDocumentPrototype.changeHeader = function (header, outputFile, options) {
   if (this.closed) return closedError;
+  const copyIndex = !options || options.copyIndex !== false;
   return new Promise((resolve, reject) => {
-    this._changeHeader(header, outputFile,
+    this._changeHeader(header, outputFile, copyIndex,
       e => e ? reject(e) : resolve(module.exports.fromFile(outputFile)));
   });
 };
 
+// Returns the latencies of the phases of the document's operations, counters of the work they did,
+// and the statistics of its caches; the reset option clears the latencies and counters afterwards
+HdtDocumentPrototype.stats = function (options) {
+  const stats = this._stats(!!(options && options.reset));
+  stats.termCache = this.termCacheStats;
+  stats.pageCache = this.pageCacheStats;
+  return stats;
+};
+
+// Returns the number of mapped and resident bytes of every section of the document's files
+HdtDocumentPrototype.memory = function () {
+  return this._memory();
+};
+
 HdtDocumentPrototype.close = function () {
   return new Promise((resolve, reject) =>
     this._close(e => e ? reject(e) : resolve()));
 };
 
+// Runs a native query that stops once the signal of the options is aborted,
+// or returns what it found so far once the timeout of the options has passed
+function runQuery(document, options, query) {
+  const signal = options.signal;
+  if (signal && signal.aborted)
+    return Promise.reject(abortError());
+  const timeoutMs = Math.min(MAX_ID, Math.max(0, Math.floor(options.timeoutMs) || 0));
+  const queryId = signal ? lastQueryId = lastQueryId % MAX_ID + 1 : 0;
+  return new Promise((resolve, reject) => {
+    // Reject right away when aborted, and let the native query stop in the background
+    function abort() {
+      document._cancelQuery(queryId);
+      reject(abortError());
+    }
+    function settle(callback) {
+      return value => {
+        if (signal) signal.removeEventListener('abort', abort);
+        callback(value);
+      };
+    }
+    if (signal) signal.addEventListener('abort', abort);
+    query(queryId, timeoutMs, settle(resolve), settle(reject));
+  });
+}
+
+function abortError() {
+  const error = new Error('The query was aborted');
+  error.name = 'AbortError';
+  return error;
+}
+
+function parseBatchSize(batchSize) {
+  if (isNaN(batchSize) || batchSize === Infinity) return DEFAULT_BATCH_SIZE;
+  return Math.min(MAX_BATCH_SIZE, Math.max(1, parseInt(batchSize, 10)));
+}
+
+function parseId(id) {
+  if (isNaN(id) || id <= 0) return 0;
+  return Math.min(MAX_ID, Math.floor(id));
+}
+
+// Offsets and limits can exceed 32 bits, and are also accepted as BigInt
 function parseOffset({ offset }) {
+  offset = Number(offset);
   if (isNaN(offset)) return 0;
-  if (offset === Infinity) return MAX;
-  return Math.max(0, parseInt(offset, 10));
+  return Math.min(MAX, Math.max(0, Math.floor(offset)));
 }
 
 function parseLimit({ limit }) {
-  if (isNaN(limit) || limit === Infinity) return MAX;
-  return Math.max(0, parseInt(limit, 10));
+  limit = Number(limit);
+  if (isNaN(limit)) return MAX;
+  return Math.min(MAX, Math.max(0, Math.floor(limit)));
 }
 
 // Deprecated method names
@@ -128,6 +391,295 @@ HdtDocumentPrototype.search = HdtDocumentPrototype.searchTriples;
 
 
 
+/*     Columnar triples     */
+
+// Triples in columnar form, whose terms are only created when accessed
+class TripleColumns {
+  constructor({ ids, subjects, predicates, objects }, dataFactory) {
+    this.ids = ids;
+    this.length = ids.length / 3;
+    this.subjects = subjects;
+    this.predicates = predicates;
+    this.objects = objects;
+    this._dataFactory = dataFactory;
+    this._strings = [subjects, predicates, objects];
+    this._terms = [new Array(subjects.length), new Array(predicates.length), new Array(objects.length)];
+  }
+
+  // Returns the term in the given position (0, 1, or 2) of the triple at the given index
+  term(index, position) {
+    const id = this.ids[3 * index + position], terms = this._terms[position];
+    return terms[id] || (terms[id] = stringToTerm(this._strings[position][id], this._dataFactory));
+  }
+
+  subject(index) {
+    return this.term(index, 0);
+  }
+
+  predicate(index) {
+    return this.term(index, 1);
+  }
+
+  object(index) {
+    return this.term(index, 2);
+  }
+
+  // Returns the triple at the given index as a quad
+  get(index) {
+    const dataFactory = this._dataFactory;
+    return dataFactory.quad(this.subject(index), this.predicate(index), this.object(index),
+      dataFactory.defaultGraph());
+  }
+
+  // Iterates over all triples as quads
+  *[Symbol.iterator]() {
+    for (let i = 0; i < this.length; i++)
+      yield this.get(i);
+  }
+
+  // Returns all triples as an array of quads
+  toArray() {
+    return Array.from(this);
+  }
+}
+
+
+
+/*     Union of HDT documents     */
+
+// The union of the triples of several HDT documents, which are searched in parallel
+class HdtUnionDocument {
+  constructor(documents, options) {
+    this.documents = documents;
+    this.dataFactory = documents[0].dataFactory;
+    this.features = Object.freeze({
+      searchTriples:  true,
+      countTriples:   true,
+      searchLiterals: false,
+      readHeader:     false,
+      changeHeader:   false,
+    });
+    this._deduplicate = !!options.deduplicate;
+    this._threads = Math.max(1, Math.min(MAX_BATCH_THREADS, documents.length, os.cpus().length));
+  }
+
+  get closed() {
+    return this.documents.some(document => document.closed);
+  }
+
+  // Searches the documents for triples with the given subject, predicate, and object,
+  // where offset and limit apply to the triples of all documents in order.
+  // With deduplicate, triples that also occur in an earlier document are left out.
+  searchTriples(subject, predicate, object, options) {
+    if (this.closed) return closedError;
+    options = options || {};
+    const deduplicate = 'deduplicate' in options ? !!options.deduplicate : this._deduplicate;
+    const dataFactory = this.dataFactory;
+    return new Promise((resolve, reject) => {
+      hdtNative.searchHdtUnion(this.documents,
+        isValidHdtTerm(subject) ? termToString(subject) : '',
+        isValidHdtTerm(predicate) ? termToString(predicate) : '',
+        isValidHdtTerm(object) ? termToString(object) : '',
+        parseOffset(options), parseLimit(options), deduplicate, this._threads,
+        (err, pages, totalCount, hasExactCount) => {
+          if (err) return reject(err);
+          const triples = [];
+          for (const page of pages) {
+            for (const triple of page)
+              triples.push(stringQuadToQuad(triple, dataFactory));
+          }
+          resolve({ triples, totalCount, hasExactCount });
+        });
+    });
+  }
+
+  // Gives an approximate number of matches of triples with the given subject, predicate, and object.
+  countTriples(subject, predicate, object) {
+    return this.searchTriples(subject, predicate, object, { offset: 0, limit: 0 });
+  }
+
+  close() {
+    return Promise.all(this.documents.map(document => document.close())).then(() => {});
+  }
+}
+
+
+
+/*     Auxiliary methods for HdtCursor     */
+const HdtCursorPrototype = hdtNative.HdtCursor.prototype;
+
+// Reads the next batch of triples; an empty batch indicates the end.
+HdtCursorPrototype.next = function (batchSize) {
+  if (this.document.closed) return closedError;
+  const dataFactory = this.document.dataFactory;
+  return new Promise((resolve, reject) => {
+    this._next(parseBatchSize(batchSize), (err, triples, done) => {
+      if (err) return reject(err);
+      this.done = done;
+      resolve(triples.map(t => stringQuadToQuad(t, dataFactory)));
+    });
+  });
+};
+
+// Closes the cursor, releasing its position in the document.
+HdtCursorPrototype.close = function () {
+  this._close();
+  return Promise.resolve();
+};
+
+// Iterates asynchronously over the remaining triples, one batch at a time.
+HdtCursorPrototype[Symbol.asyncIterator] = function () {
+  let triples = [], position = 0;
+  return {
+    next: () => {
+      if (position < triples.length)
+        return Promise.resolve({ value: triples[position++], done: false });
+      if (this.done)
+        return Promise.resolve({ value: undefined, done: true });
+      return this.next(DEFAULT_BATCH_SIZE).then(batch => {
+        triples = batch, position = 0;
+        return position < triples.length ?
+          { value: triples[position++], done: false } : { value: undefined, done: true };
+      });
+    },
+    return: () => this.close().then(() => ({ value: undefined, done: true })),
+  };
+};
+
+// Creates a readable stream of the remaining triples.
+HdtCursorPrototype.stream = function (batchSize) {
+  return cursorStream(Promise.resolve(this), batchSize);
+};
+
+// Creates a readable stream of triples from a cursor that is being opened
+function cursorStream(cursorPromise, batchSize) {
+  let reading = false;
+  return new Readable({
+    objectMode: true,
+    read() {
+      if (reading) return;
+      reading = true;
+      cursorPromise
+        .then(cursor => cursor.next(batchSize).then(triples => {
+          reading = false;
+          for (const triple of triples)
+            this.push(triple);
+          if (cursor.done) this.push(null);
+        }))
+        .catch(error => this.destroy(error));
+    },
+    destroy(error, callback) {
+      cursorPromise.then(cursor => cursor.close(), () => null)
+        .then(() => callback(error));
+    },
+  });
+}
+
+
+
+// Returns the path through which the file is opened, such that libhdt reads and writes its index
+// in the given directory: a link to the file, named after a hash of its absolute path
+function linkIndexDirectory(filename, directory) {
+  if (!directory)
+    return Promise.resolve(filename);
+  const target = path.resolve(filename);
+  const hash = crypto.createHash('sha1').update(target).digest('hex').substr(0, 16);
+  const link = path.join(directory, hash + '-' + path.basename(filename));
+  return fs.promises.mkdir(directory, { recursive: true })
+    .then(() => fs.promises.symlink(target, link))
+    .catch(error => {
+      if (error.code !== 'EEXIST')
+        throw error;
+    })
+    .then(() => link);
+}
+
+// Builds the index of the document in the background, after which all patterns are served quickly
+function buildIndex(document, hdtFile, opts) {
+  const indexReady = new Promise((resolve, reject) => {
+    document._buildIndex(hdtFile, !!opts.statistics, !!opts.literalIndex, opts.onProgress,
+      error => error ? reject(error) : resolve());
+  });
+  // Avoid unhandled rejections for callers that do not wait for the index
+  indexReady.catch(e => {});
+  return indexReady;
+}
+
+
+// Sections of a document's files, and the access patterns they can be given
+const MEMORY_SECTIONS = {
+  header: 0,
+  dictionary: 1,
+  triples: 2,
+  index: 3,
+};
+const MEMORY_ADVICE = {
+  normal: 0,
+  random: 1,
+  sequential: 2,
+};
+
+// Converts the memory options into the native access pattern per section, and the sections to lock and prefetch
+function parseMemoryPolicy(memory) {
+  const toSection = name => {
+    if (!MEMORY_SECTIONS.hasOwnProperty(name))
+      throw new Error('Unknown memory section: ' + name);
+    return MEMORY_SECTIONS[name];
+  };
+  // The advice is either one access pattern for all sections, or an object with a pattern per section
+  const advice = Object.keys(MEMORY_SECTIONS).map(() => -1);
+  const sectionAdvice = typeof memory.advice === 'string' ?
+    Object.keys(MEMORY_SECTIONS).reduce((all, name) => (all[name] = memory.advice, all), {}) : memory.advice || {};
+  for (const name in sectionAdvice) {
+    if (!MEMORY_ADVICE.hasOwnProperty(sectionAdvice[name]))
+      throw new Error('Unknown memory advice: ' + sectionAdvice[name]);
+    advice[toSection(name)] = MEMORY_ADVICE[sectionAdvice[name]];
+  }
+  return {
+    advice,
+    hugePages: !!memory.hugePages,
+    lock: [].concat(memory.lock || []).map(toSection),
+    prefetch: [].concat(memory.prefetch || []).map(toSection),
+  };
+}
+
+// Applies the memory policy to the document in the background,
+// resolving to whether all sections were prefetched before the document was closed
+function applyMemoryPolicy(document, policy) {
+  const memoryReady = new Promise((resolve, reject) => {
+    document._setMemoryPolicy(policy.advice, policy.hugePages, policy.lock, policy.prefetch,
+      (error, prefetched) => error ? reject(error) : resolve(prefetched));
+  });
+  memoryReady.catch(e => {});
+  return memoryReady;
+}
+
+
+// Returns the N-Triples file from which libhdt generates an HDT file.
+// Streams and other formats are written to a temporary file first, converting them with N3.js if needed.
+function toNTriplesFile(input, format) {
+  const isNTriples = !format || /n-?triples/i.test(format);
+  if (typeof input === 'string' && isNTriples)
+    return Promise.resolve({ file: input, directory: null });
+  return fs.promises.mkdtemp(path.join(os.tmpdir(), 'hdt-')).then(directory => {
+    const file = path.join(directory, 'input.nt');
+    const streams = [typeof input === 'string' ? fs.createReadStream(input) : input];
+    if (!isNTriples)
+      streams.push(new N3.StreamParser({ format }), new N3.StreamWriter({ format: 'N-Triples' }));
+    streams.push(fs.createWriteStream(file));
+    return new Promise((resolve, reject) => {
+      pipeline(...streams, error => error ? reject(error) : resolve({ file, directory }));
+    }).catch(error => removeDirectory(directory).then(() => { throw error; }));
+  });
+}
+
+// Removes the temporary directory, if any
+function removeDirectory(directory) {
+  return directory ? fs.promises.rm(directory, { recursive: true, force: true }) : Promise.resolve();
+}
+
+
+
 /*     Module exports     */
 
 module.exports = {
@@ -135,8 +687,16 @@ module.exports = {
   fromFile: (filename, opts) => {
     if (typeof filename !== 'string' || filename.length === 0)
       return Promise.reject(Error('Invalid filename: ' + filename));
-    return new Promise((resolve, reject) => {
-      hdtNative.createHdtDocument(filename, (error, document) => {
+    opts = opts || {};
+    let memoryPolicy = null;
+    try {
+      memoryPolicy = opts.memory ? parseMemoryPolicy(opts.memory) : null;
+    }
+    catch (error) {
+      return Promise.reject(error);
+    }
+    return linkIndexDirectory(filename, opts.indexDirectory).then(hdtFile => new Promise((resolve, reject) => {
+      hdtNative.createHdtDocument(hdtFile, opts, (error, document) => {
         // Abort the creation if any error occurred
         if (error) {
           switch (error.message) {
@@ -148,17 +708,52 @@ module.exports = {
             return reject(error);
           }
         }
-        document.dataFactory = opts && opts.dataFactory ? opts.dataFactory : N3.DataFactory;
+        // Shared documents are opened with their index, such that every thread can use it right away
+        const backgroundIndex = opts.backgroundIndex && !opts.shared;
+        document.dataFactory = opts.dataFactory || N3.DataFactory;
+        document.indexReady = backgroundIndex ? buildIndex(document, hdtFile, opts) : Promise.resolve();
+        document.memoryReady = memoryPolicy ? applyMemoryPolicy(document, memoryPolicy) : Promise.resolve(true);
+        // An index built in the background is mapped anew, so it receives the policy once it is ready
+        if (memoryPolicy && backgroundIndex)
+          document.indexReady.then(() => applyMemoryPolicy(document, memoryPolicy), e => {});
+        // Document the ID ranges of the dictionary
+        document.idRanges = Object.freeze(document._idRanges);
         // Document the features of the HDT file
         document.features = Object.freeze({
           searchTriples:  true, // supported by default
           countTriples:   true, // supported by default
-          searchLiterals: !!(document._features & 1),
+          searchLiterals: !!(document._features & 1) || !!opts.literalIndex,
           readHeader:     true, // supported by default
           changeHeader:   true, // supported by default
         });
         resolve(document);
       });
-    });
+    }));
+  },
+
+  // Opens several HDT files as a single document with the union of their triples.
+  fromFiles: (filenames, opts) => {
+    if (!Array.isArray(filenames) || filenames.length === 0)
+      return Promise.reject(Error('Invalid filenames: ' + filenames));
+    opts = opts || {};
+    // Close the documents that did open if any of them fails
+    const opening = filenames.map(filename => module.exports.fromFile(filename, opts));
+    return Promise.all(opening).then(documents => new HdtUnionDocument(documents, opts), error =>
+      Promise.all(opening.map(document => document.then(d => d.close(), e => {}))).then(() => { throw error; }));
+  },
+
+  // Generates an HDT file from an RDF file or stream, and opens it as an HDT document.
+  fromRdf: (input, outputFile, opts) => {
+    if (typeof outputFile !== 'string' || outputFile.length === 0)
+      return Promise.reject(Error('Invalid output filename: ' + outputFile));
+    if (!input || (typeof input !== 'string' && typeof input.pipe !== 'function'))
+      return Promise.reject(Error('Invalid input: ' + input));
+    opts = opts || {};
+    const baseIri = opts.baseIri || 'file://' + path.resolve(typeof input === 'string' ? input : outputFile);
+    return toNTriplesFile(input, opts.format).then(source => new Promise((resolve, reject) => {
+      hdtNative.generateHdtDocument(source.file, outputFile, baseIri, !!opts.lowMemory, opts.onProgress,
+        error => removeDirectory(source.directory).catch(e => {})
+          .then(() => error ? reject(error) : resolve()));
+    })).then(() => module.exports.fromFile(outputFile, opts));
   },
 };
@@ -0,0 +1,42 @@
+#!/usr/bin/env node
+// Compares the latencies of two benchmark runs, such as those before and after a change
+const fs = require('fs');
+
+const args = require('minimist')(process.argv.slice(2), { string: ['_'], default: { threshold: 0 } });
+if (args._.length !== 2 || args.h || args.help) {
+  console.error('usage: compare.js baseline.json candidate.json [--threshold 1.1]');
+  process.exit(1);
+}
+
+// Reads benchmark results written by run.js, either with --output or as JSON lines
+function readResults(file) {
+  const contents = fs.readFileSync(file, 'utf8').trim();
+  const records = contents.startsWith('[') ? JSON.parse(contents) :
+    contents.split('\n').filter(line => line.startsWith('{')).map(line => JSON.parse(line));
+  const results = new Map();
+  for (const record of records)
+    results.set(record.benchmark, record);
+  return results;
+}
+
+const baseline = readResults(args._[0]), candidate = readResults(args._[1]);
+const threshold = Number(args.threshold);
+const pad = (value, width) => String(value).padStart(width);
+let regressions = 0;
+console.log('benchmark'.padEnd(34) + pad('p50', 10) + pad('p50 new', 10) + pad('ratio', 8) +
+            pad('p99', 10) + pad('p99 new', 10) + pad('ratio', 8));
+for (const [name, before] of baseline) {
+  const after = candidate.get(name);
+  if (!after)
+    continue;
+  const ratio50 = after.p50 / before.p50, ratio99 = after.p99 / before.p99;
+  // Only the median counts towards regressions, since tail latencies of short runs are noisy
+  const regressed = threshold > 0 && ratio50 > threshold;
+  regressions += regressed;
+  console.log(name.padEnd(34) + pad(before.p50, 10) + pad(after.p50, 10) + pad(ratio50.toFixed(2), 8) +
+              pad(before.p99, 10) + pad(after.p99, 10) + pad(ratio99.toFixed(2), 8) + (regressed ? '  !' : ''));
+}
+if (regressions) {
+  console.error(regressions + ' benchmark(s) slowed down by more than a factor ' + threshold);
+  process.exit(1);
+}
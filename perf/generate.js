@@ -0,0 +1,150 @@
+#!/usr/bin/env node
+// Generates deterministic synthetic RDF documents of configurable size and shape as HDT files
+const { Readable } = require('stream');
+
+const DEFAULTS = {
+  triples: 100000,
+  // Average number of triples per subject
+  subjectSize: 10,
+  predicates: 50,
+  // Exponent of the Zipf distribution of predicates; higher values make few predicates more common
+  skew: 1.2,
+  // Fractions of subjects that are blank nodes, and of objects that are literals
+  blankNodes: 0.2,
+  literals: 0.6,
+  // Fraction of literals that are long, and their length in characters
+  longLiterals: 0.05,
+  literalLength: 500,
+  seed: 1,
+};
+
+const SYLLABLES = ['ka', 'lo', 'mi', 'ne', 'ru', 'sa', 'ti', 'vo', 'ze', 'ba', 'do', 'fu', 'gi', 'ha', 'je', 'po'];
+const LANGUAGES = ['en', 'nl', 'fr', 'de'];
+
+// Returns a pseudo-random number generator with values in [0, 1) for the given seed (mulberry32)
+function createRandom(seed) {
+  let state = seed >>> 0;
+  return function random() {
+    state = (state + 0x6D2B79F5) >>> 0;
+    let value = Math.imul(state ^ (state >>> 15), 1 | state);
+    value = (value + Math.imul(value ^ (value >>> 7), 61 | value)) ^ value;
+    return ((value ^ (value >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+// Returns a function that picks an index in [0, count) following a Zipf distribution
+function createZipf(count, exponent, random) {
+  const cumulative = [];
+  let total = 0;
+  for (let i = 1; i <= count; i++)
+    cumulative.push(total += 1 / Math.pow(i, exponent));
+  return function zipf() {
+    const target = random() * total;
+    let low = 0, high = count - 1;
+    while (low < high) {
+      const middle = (low + high) >>> 1;
+      if (cumulative[middle] < target)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low;
+  };
+}
+
+// Returns a pronounceable word
+function createWord(random) {
+  let word = '';
+  for (let i = 1 + Math.floor(random() * 3); i >= 0; i--)
+    word += SYLLABLES[Math.floor(random() * SYLLABLES.length)];
+  return word;
+}
+
+// Returns a text of words with at least the given number of characters
+function createText(random, length) {
+  let text = createWord(random);
+  while (text.length < length)
+    text += ' ' + createWord(random);
+  return text;
+}
+
+// Returns a stream of N-Triples of a synthetic document with the given options
+function generate(options) {
+  options = Object.assign({}, DEFAULTS, options);
+  const random = createRandom(options.seed);
+  const pickPredicate = createZipf(options.predicates, options.skew, random);
+  const subjectCount = Math.max(1, Math.ceil(options.triples / options.subjectSize));
+  const subjects = [];
+  for (let i = 0; i < subjectCount; i++) {
+    subjects.push(random() < options.blankNodes ?
+      '_:b' + i : '<http://example.org/resource/' + createWord(random) + i + '>');
+  }
+
+  // Returns the object of a triple
+  function createObject() {
+    if (random() >= options.literals)
+      return subjects[Math.floor(random() * subjectCount)];
+    const kind = random();
+    if (kind < options.longLiterals)
+      return '"' + createText(random, options.literalLength) + '"';
+    if (kind < 0.3)
+      return '"' + Math.floor(random() * 100000) + '"^^<http://www.w3.org/2001/XMLSchema#integer>';
+    if (kind < 0.6)
+      return '"' + createText(random, 12) + '"@' + LANGUAGES[Math.floor(random() * LANGUAGES.length)];
+    return '"' + createText(random, 20) + '"';
+  }
+
+  // Write the triples of one subject at a time, spreading the triples evenly over the subjects
+  let written = 0, subject = 0;
+  return new Readable({
+    read() {
+      let chunk = '';
+      while (chunk.length < 65536 && written < options.triples) {
+        const remaining = subjectCount - subject;
+        const count = Math.min(options.triples - written, Math.ceil((options.triples - written) / remaining));
+        for (let i = 0; i < count; i++) {
+          chunk += subjects[subject] + ' <http://example.org/vocabulary/p' + pickPredicate() + '> ' +
+                   createObject() + ' .\n';
+        }
+        written += count;
+        subject++;
+      }
+      this.push(chunk.length ? chunk : null);
+    },
+  });
+}
+
+// Generates an HDT file with the given options, resolving to the opened document
+function generateHdt(outputFile, options) {
+  const hdt = require('../lib/hdt');
+  return hdt.fromRdf(generate(options), outputFile, Object.assign({ format: 'N-Triples' }, options));
+}
+
+module.exports = { DEFAULTS, generate, generateHdt };
+
+// Command-line usage: generate.js output.hdt [--triples 100000] [--predicates 50] …
+if (require.main === module) {
+  const args = require('minimist')(process.argv.slice(2), { string: ['_'] });
+  const outputFile = args._[0];
+  if (!outputFile || args.h || args.help) {
+    console.error('usage: generate.js output.hdt ' +
+                  Object.keys(DEFAULTS).map(name => '[--' + name + ' ' + DEFAULTS[name] + ']').join(' '));
+    process.exit(1);
+  }
+  const options = {};
+  for (const name in DEFAULTS) {
+    if (name in args)
+      options[name] = Number(args[name]);
+  }
+  generateHdt(outputFile, options)
+    .then(document => {
+      return document.countTriples(null, null, null).then(result => {
+        console.error('Generated ' + outputFile + ' with ' + result.totalCount + ' triples');
+        return document.close();
+      });
+    })
+    .catch(error => {
+      console.error(error.message);
+      process.exit(1);
+    });
+}
@@ -0,0 +1,227 @@
+#!/usr/bin/env node
+// Measures the latency and throughput of every operation on a synthetic or given HDT document,
+// writing one JSON object per benchmark such that results of different builds can be compared
+const fs = require('fs'),
+      os = require('os'),
+      path = require('path'),
+      { namedNode, variable } = require('n3').DataFactory,
+      hdt = require('../lib/hdt'),
+      { DEFAULTS, generateHdt } = require('./generate');
+
+const args = require('minimist')(process.argv.slice(2), {
+  string: ['file', 'filter', 'output'],
+  default: { iterations: 200, concurrency: 1, threads: 0 },
+});
+if (args.h || args.help) {
+  console.error('usage: run.js [--file document.hdt | --triples 100000 …] [--iterations 200] [--concurrency 1] ' +
+                '[--threads 0] [--filter regex] [--output results.json]');
+  process.exit(1);
+}
+
+
+
+/*     Benchmarks     */
+
+const PREDICATE = 'http://example.org/vocabulary/p';
+
+// Returns the benchmarks, which use sample terms from the document
+function createBenchmarks(document, samples) {
+  const { subjects, objects, words } = samples;
+  const popular = namedNode(PREDICATE + 0), rare = namedNode(PREDICATE + (samples.predicates - 1));
+  const pick = (terms, i) => terms[i % terms.length];
+  const count = result => result.triples.length;
+  return [
+    // Triple patterns of every shape
+    { name: 'searchTriples ???', run: () => document.searchTriples(null, null, null, { limit: 100 }).then(count) },
+    { name: 'searchTriples S??', run: i => document.searchTriples(pick(subjects, i), null, null).then(count) },
+    { name: 'searchTriples ?P? popular', run: i =>
+      document.searchTriples(null, popular, null, { offset: i * 100, limit: 100 }).then(count) },
+    { name: 'searchTriples ?P? rare', run: () => document.searchTriples(null, rare, null, { limit: 100 }).then(count) },
+    { name: 'searchTriples ??O', run: i => document.searchTriples(null, null, pick(objects, i)).then(count) },
+    { name: 'searchTriples ?PO', run: i => document.searchTriples(null, popular, pick(objects, i)).then(count) },
+    { name: 'searchTriples ?P? deep offset', run: i =>
+      document.searchTriples(null, popular, null, { offset: 10000 + i, limit: 10 }).then(count) },
+    { name: 'searchTriples ?P? columnar', run: () =>
+      document.searchTriples(null, popular, null, { limit: 1000, columnar: true }).then(r => r.columns.length) },
+    { name: 'countTriples ?P?', run: () => document.countTriples(null, popular, null).then(() => 0) },
+    { name: 'searchTriplesBatch S?? x10', run: i =>
+      document.searchTriplesBatch(subjects.slice(0, 10).map((subject, j) => ({ subject: pick(subjects, i + j) })))
+        .then(results => results.reduce((total, result) => total + count(result), 0)) },
+    { name: 'searchTriplesCursor ??? 10000', iterations: 20, run: () =>
+      document.searchTriplesCursor(null, null, null).then(cursor => readCursor(cursor, 10000)) },
+    { name: 'searchTripleIds ?P?', run: i =>
+      document.searchTripleIds(0, 1, 0, { offset: i * 100, limit: 100 }).then(r => r.ids.length / 3) },
+    { name: 'exportTo', iterations: 3, run: () => document.exportTo(os.devNull) },
+
+    // Conversions between terms and IDs
+    { name: 'termToId x100', run: i =>
+      document.termToId(subjects.slice(i % 10, i % 10 + 100), 'subject').then(ids => ids.length) },
+    { name: 'idToTerm x100', run: i =>
+      document.idToTerm(Array.from({ length: 100 }, (v, j) => i * 100 + j + 1), 'object').then(t => t.length) },
+
+    // Joins
+    { name: 'evaluateBGP', run: i => document.evaluateBGP([
+      [variable('s'), popular, variable('o')],
+      [variable('s'), rare, variable('x')],
+    ], { offset: i * 10, limit: 10 }).then(result => result.bindings.length) },
+
+    // Literals and terms
+    { name: 'searchLiterals substring', run: i =>
+      document.searchLiterals(pick(words, i), { limit: 100 }).then(r => r.literals.length) },
+    { name: 'searchLiterals token', run: i =>
+      document.searchLiterals(pick(words, i) + ' ' + pick(words, i + 1), { mode: 'token', limit: 100 })
+        .then(r => r.literals.length) },
+    { name: 'searchLiterals regex', run: i =>
+      document.searchLiterals(new RegExp('^' + pick(words, i) + ' \\w+$'), { limit: 100 })
+        .then(r => r.literals.length) },
+    { name: 'searchTerms prefix', run: i =>
+      document.searchTerms({ prefix: pick(subjects, i).value.slice(0, 32), limit: 20, position: 'subject' })
+        .then(terms => terms.length) },
+    { name: 'searchTermsByPrefix offset', run: i =>
+      document.searchTermsByPrefix('http://example.org/resource/', { position: 'subject', offset: i * 20, limit: 20 })
+        .then(result => result.terms.length) },
+    { name: 'fetchDistinctTerms S->P', run: i =>
+      document.searchTerms({ subject: pick(subjects, i), position: 'predicate' }).then(terms => terms.length) },
+    { name: 'fetchDistinctTerms O->S', run: i =>
+      document.searchTerms({ object: pick(objects, i), position: 'subject', limit: 100 }).then(terms => terms.length) },
+  ];
+}
+
+// Reads the given number of triples from the cursor, resolving to the number of triples read
+function readCursor(cursor, limit) {
+  let total = 0;
+  function next() {
+    return cursor.next(1000).then(triples => {
+      total += triples.length;
+      return cursor.done || total >= limit ? cursor.close().then(() => total) : next();
+    });
+  }
+  return next();
+}
+
+// Collects subjects, IRI objects, and literal words to search for
+function collectSamples(document) {
+  return document.searchTriples(null, null, null, { limit: 20000 }).then(result => {
+    const subjects = new Map(), objects = new Map(), words = new Set();
+    for (const { subject, object } of result.triples) {
+      if (subject.termType === 'NamedNode')
+        subjects.set(subject.value, subject);
+      if (object.termType === 'NamedNode')
+        objects.set(object.value, object);
+      else if (object.termType === 'Literal' && words.size < 1000)
+        object.value.split(' ').filter(word => /^[a-z]{4,}$/.test(word)).forEach(word => words.add(word));
+    }
+    return document.countTriples(null, null, null).then(({ totalCount }) => ({
+      subjects: [...subjects.values()],
+      objects: [...objects.values()],
+      words: [...words],
+      triples: totalCount,
+      predicates: document.idRanges.predicate,
+    }));
+  });
+}
+
+
+
+/*     Measurement     */
+
+// Runs the benchmark the given number of times with the given concurrency
+function measure(document, benchmark, iterations, concurrency) {
+  const latencies = [];
+  let results = 0, started = 0;
+  function runNext() {
+    if (started >= iterations)
+      return Promise.resolve();
+    const iteration = started++, start = process.hrtime();
+    return benchmark.run(iteration).then(count => {
+      const [seconds, nanoseconds] = process.hrtime(start);
+      latencies.push(seconds * 1e3 + nanoseconds / 1e6);
+      results += count || 0;
+      return runNext();
+    });
+  }
+
+  document.stats({ reset: true });
+  const start = process.hrtime();
+  const runners = [];
+  for (let i = 0; i < Math.min(concurrency, iterations); i++)
+    runners.push(runNext());
+  return Promise.all(runners).then(() => {
+    const [seconds, nanoseconds] = process.hrtime(start), elapsed = seconds + nanoseconds / 1e9;
+    latencies.sort((a, b) => a - b);
+    const percentile = fraction => latencies[Math.min(latencies.length - 1, Math.floor(fraction * latencies.length))];
+    const stats = document.stats();
+    return {
+      benchmark: benchmark.name,
+      iterations,
+      concurrency,
+      // Latencies in milliseconds as seen by JavaScript
+      p50: round(percentile(0.5)),
+      p99: round(percentile(0.99)),
+      mean: round(latencies.reduce((total, latency) => total + latency, 0) / latencies.length),
+      opsPerSecond: round(iterations / elapsed),
+      resultsPerSecond: round(results / elapsed),
+      rss: process.memoryUsage().rss,
+      // Native phases in microseconds and counters, isolating the native code from JavaScript
+      native: stats.operations,
+      counters: stats.counters,
+    };
+  });
+}
+
+function round(value) {
+  return Math.round(value * 1000) / 1000;
+}
+
+
+
+/*     Main     */
+
+// Returns the document to benchmark, generating it if needed
+function getDocumentFile() {
+  if (args.file)
+    return Promise.resolve(args.file);
+  const options = {};
+  for (const name in DEFAULTS)
+    options[name] = name in args ? Number(args[name]) : DEFAULTS[name];
+  // Generated documents are reused by the runs with the same options
+  const directory = path.join(__dirname, 'data');
+  const file = path.join(directory, Object.keys(options).map(name => name + '-' + options[name]).join('_') + '.hdt');
+  if (fs.existsSync(file))
+    return Promise.resolve(file);
+  fs.mkdirSync(directory, { recursive: true });
+  console.error('Generating ' + file);
+  return generateHdt(file, options).then(document => document.close()).then(() => file);
+}
+
+const filter = new RegExp(args.filter || '');
+const records = [];
+let document;
+getDocumentFile()
+  .then(file => hdt.fromFile(file, { literalIndex: true, statistics: true, threads: args.threads }))
+  .then(hdtDocument => {
+    document = hdtDocument;
+    return collectSamples(document);
+  })
+  .then(samples => {
+    const environment = { node: process.version, platform: os.platform(), arch: os.arch(),
+                          cpus: os.cpus().length, triples: samples.triples, threads: args.threads };
+    // Run the benchmarks one after another, writing every result as soon as it is known
+    return createBenchmarks(document, samples)
+      .filter(benchmark => filter.test(benchmark.name))
+      .reduce((previous, benchmark) => previous.then(() =>
+        measure(document, benchmark, benchmark.iterations || args.iterations, args.concurrency).then(result => {
+          const record = Object.assign(result, environment);
+          records.push(record);
+          console.log(JSON.stringify(record));
+        })), Promise.resolve());
+  })
+  .then(() => {
+    if (args.output)
+      fs.writeFileSync(args.output, JSON.stringify(records, null, 2) + '\n');
+    return document.close();
+  })
+  .catch(error => {
+    console.error(error.stack);
+    process.exit(1);
+  });
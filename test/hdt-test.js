@@ -1,4 +1,8 @@
 require('should');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { Worker } = require('worker_threads');
 const { literal, variable, namedNode, quad, defaultGraph } = require('n3').DataFactory;
 
 const hdt = require('../lib/hdt');
@@ -128,6 +132,34 @@ describe('hdt', function () {
                          '"825"').should.be.above(-1);
         });
       });
+
+      it('should not change the header of the original document', function () {
+        return document.readHeader().then(original => {
+          original.split('\n').should.have.length(23);
+        });
+      });
+
+      it('should copy the index', function () {
+        fs.existsSync(outputFile + '.index.v1-1').should.be.true();
+      });
+
+      it('should contain the same triples', function () {
+        return Promise.all([
+          document.searchTriples(null, null, null, { limit: 1000 }),
+          newhdt.searchTriples(null, null, null, { limit: 1000 }),
+        ]).then(([original, copy]) => {
+          copy.totalCount.should.equal(original.totalCount);
+          copy.triples.should.eql(original.triples);
+        });
+      });
+    });
+
+    describe('writing a header to the same file', function () {
+      it('should throw an error', function () {
+        return document.changeHeader('', './test/test.hdt').then(
+          () => Promise.reject(new Error('Expected an error')),
+          error => error.message.should.equal('The output file must differ from the HDT file'));
+      });
     });
 
     describe('getting suggestions', function () {
@@ -190,6 +222,54 @@ describe('hdt', function () {
           }
         );
       });
+
+      it('should skip suggestions before the offset', function () {
+        return Promise.all([
+          document.searchTerms({ prefix: 'http://example.org/', position: 'object' }),
+          document.searchTerms({ prefix: 'http://example.org/', offset: 95, limit: 10, position: 'object' }),
+        ]).then(([all, page]) => {
+          page.should.have.lengthOf(5);
+          page.should.eql(all.slice(95));
+        });
+      });
+    });
+
+    describe('searching terms by prefix', function () {
+      it('should count the terms exactly', function () {
+        return document.searchTermsByPrefix('http://example.org/', { position: 'object', limit: 2 }).then(result => {
+          result.terms.should.have.lengthOf(2);
+          result.terms[0].should.eql(namedNode('http://example.org/o001'));
+          result.totalCount.should.equal(100);
+          result.ranges.reduce((total, [first, end]) => total + end - first, 0).should.equal(100);
+        });
+      });
+
+      it('should find literals in a single range', function () {
+        return document.searchTermsByPrefix('"a', { position: 'object' }).then(result => {
+          result.terms.should.have.lengthOf(9);
+          result.totalCount.should.equal(9);
+          result.ranges.should.have.lengthOf(1);
+        });
+      });
+
+      it('should return consecutive pages of sorted terms', function () {
+        const pages = [0, 40, 80, 120].map(offset =>
+          document.searchTermsByPrefix('', { position: 'object', offset, limit: 40 }));
+        return Promise.all(pages).then(results => {
+          results.map(r => r.totalCount).should.eql([114, 114, 114, 114]);
+          results.map(r => r.terms.length).should.eql([40, 40, 34, 0]);
+          const values = [].concat(...results.map(r => r.terms.map(t => t.id)));
+          new Set(values).size.should.equal(114);
+        });
+      });
+
+      it('should find no terms for an unknown prefix', function () {
+        return document.searchTermsByPrefix('http://example.org/x', { position: 'subject' }).then(result => {
+          result.terms.should.have.lengthOf(0);
+          result.totalCount.should.equal(0);
+          result.ranges.should.eql([]);
+        });
+      });
     });
 
     describe('fetching distinct terms', function () {
@@ -212,19 +292,34 @@ describe('hdt', function () {
           () => Promise.reject(new Error('Expected an error')),
           error => {
             error.should.be.an.instanceOf(Error);
-            error.message.should.equal('Unsupported position argument. Expected predicate.');
+            error.message.should.equal('Unsupported position argument. Expected predicate or object.');
           }
         );
       });
 
-      it('should throw on unsupported position (subject-object)', function () {
-        return document.searchTerms({ subject: namedNode('http://example.org/s1'), position: 'object' }).then(
-          () => Promise.reject(new Error('Expected an error')),
-          error => {
-            error.should.be.an.instanceOf(Error);
-            error.message.should.equal('Unsupported position argument. Expected predicate.');
-          }
-        );
+      it('should have correct results for given subject in object position', function () {
+        return document.searchTerms({ subject: namedNode('http://example.org/s1'), position: 'object' }).then(terms => {
+          terms.should.have.lengthOf(100);
+          terms[0].should.eql(namedNode('http://example.org/o001'));
+          terms[99].should.eql(namedNode('http://example.org/o100'));
+        });
+      });
+
+      it('should limit results for given subject in object position', function () {
+        return document.searchTerms({ subject: namedNode('http://example.org/s2'), limit: 3, position: 'object' }).then(terms => {
+          terms.should.eql([
+            namedNode('http://example.org/o001'),
+            namedNode('http://example.org/o002'),
+            namedNode('http://example.org/o003'),
+          ]);
+        });
+      });
+
+      it('should return literals for given subject in object position', function () {
+        return document.searchTerms({ subject: namedNode('http://example.org/s4'), position: 'object' }).then(terms => {
+          terms.should.have.lengthOf(14);
+          terms.forEach(term => { term.termType.should.equal('Literal'); });
+        });
       });
 
       it('should return 0 results on unspecified subject value', function () {
@@ -254,19 +349,25 @@ describe('hdt', function () {
           () => Promise.reject(new Error('Expected an error')),
           error => {
             error.should.be.an.instanceOf(Error);
-            error.message.should.equal('Unsupported position argument. Expected predicate.');
+            error.message.should.equal('Unsupported position argument. Expected predicate or subject.');
           }
         );
       });
 
-      it('should throw on unsupported position (object-subject)', function () {
-        return document.searchTerms({ object: namedNode('http://example.org/o001'), position: 'subject' }).then(
-          () => Promise.reject(new Error('Expected an error')),
-          error => {
-            error.should.be.an.instanceOf(Error);
-            error.message.should.equal('Unsupported position argument. Expected predicate.');
-          }
-        );
+      it('should have correct results for given object in subject position', function () {
+        return document.searchTerms({ object: namedNode('http://example.org/o001'), position: 'subject' }).then(terms => {
+          terms.should.eql([
+            namedNode('http://example.org/s1'),
+            namedNode('http://example.org/s2'),
+            namedNode('http://example.org/s3'),
+          ]);
+        });
+      });
+
+      it('should limit results for given object in subject position', function () {
+        return document.searchTerms({ object: namedNode('http://example.org/o001'), limit: 2, position: 'subject' }).then(terms => {
+          terms.should.eql([namedNode('http://example.org/s1'), namedNode('http://example.org/s2')]);
+        });
       });
 
       it('should throw on invalid position', function () {
@@ -599,6 +700,45 @@ describe('hdt', function () {
         });
       });
 
+      describe('with pattern null null null, offset 2^40 and limit 5', function () {
+        var triples, totalCount;
+        before(function () {
+          return document.searchTriples(null, null, null, { offset: Math.pow(2, 40), limit: 5 }).then(result => {
+            triples = result.triples;
+            totalCount = result.totalCount;
+          });
+        });
+
+        it('should return an empty array', function () {
+          triples.should.be.an.Array();
+          triples.should.be.empty();
+        });
+
+        it('should estimate the total count as 134', function () {
+          totalCount.should.equal(134);
+        });
+      });
+
+      describe('with pattern null null null, offset 10 and limit 2^40', function () {
+        var triples;
+        before(function () {
+          return document.searchTriples(null, null, null, { offset: 10, limit: Math.pow(2, 40) }).then(result => {
+            triples = result.triples;
+          });
+        });
+
+        it('should return an array with all remaining matches', function () {
+          triples.should.be.an.Array();
+          triples.should.have.length(124);
+          triples[0].should.eql(quad(
+            namedNode('http://example.org/s1'),
+            namedNode('http://example.org/p1'),
+            namedNode('http://example.org/o011'),
+            defaultGraph()
+          ));
+        });
+      });
+
       describe('with pattern ex:s2 null null', function () {
         var triples, totalCount, hasExactCount;
         before(function () {
@@ -1200,108 +1340,217 @@ describe('hdt', function () {
       });
     });
 
-    describe('being counted', function () {
-      describe('with a non-existing pattern', function () {
-        var totalCount, hasExactCount;
-        before(function () {
-          return document.countTriples(namedNode('a'), null, null).then(result => {
-            totalCount = result.totalCount;
-            hasExactCount = result.hasExactCount;
+    describe('being searched with a batch of patterns', function () {
+      const patterns = [
+        { subject: namedNode('http://example.org/s2'), offset: 2, limit: 3 },
+        { predicate: namedNode('http://example.org/p2') },
+        { object: namedNode('http://example.org/unknown') },
+        { subject: namedNode('http://example.org/s1'), predicate: namedNode('http://example.org/p1'), limit: 0 },
+      ];
+
+      function searchSeparately() {
+        return Promise.all(patterns.map(({ subject, predicate, object, offset, limit }) =>
+          document.searchTriples(subject, predicate, object, { offset, limit })));
+      }
+
+      it('should return the same results as separate searches', function () {
+        return Promise.all([document.searchTriplesBatch(patterns), searchSeparately()])
+          .then(([batch, separate]) => {
+            batch.should.have.length(4);
+            batch.map(r => r.triples).should.eql(separate.map(r => r.triples));
+            batch.map(r => r.totalCount).should.eql([10, 10, 0, 100]);
+            batch.map(r => r.hasExactCount).should.eql(separate.map(r => r.hasExactCount));
           });
-        });
+      });
 
-        it('should return 0', function () {
-          totalCount.should.equal(0);
+      it('should return the same results when using several threads', function () {
+        return Promise.all([document.searchTriplesBatch(patterns, { threads: 3 }), searchSeparately()])
+          .then(([batch, separate]) => {
+            batch.map(r => r.triples).should.eql(separate.map(r => r.triples));
+          });
+      });
+
+      it('should return columnar results', function () {
+        return document.searchTriplesBatch(patterns, { columnar: true }).then(batch => {
+          batch.map(r => r.columns.length).should.eql([3, 10, 0, 0]);
         });
+      });
 
-        it('should be an exact count', function () {
-          hasExactCount.should.equal(true);
+      it('should return no results for no patterns', function () {
+        return document.searchTriplesBatch([]).then(batch => {
+          batch.should.eql([]);
         });
       });
+    });
 
-      describe('with pattern null null null', function () {
-        var totalCount, hasExactCount;
-        before(function () {
-          return document.countTriples(null, null, null).then(result => {
-            totalCount = result.totalCount;
-            hasExactCount = result.hasExactCount;
+    describe('being searched with continuation tokens', function () {
+      function readAll(subject, predicate, object, limit) {
+        const pages = [];
+        function readPage(continuation) {
+          return document.searchTriples(subject, predicate, object, { limit, continuation }).then(result => {
+            pages.push(result.triples);
+            return result.continuation ? readPage(result.continuation) : pages;
           });
+        }
+        return readPage();
+      }
+
+      describe('with pattern null ex:p1 null and limit 30', function () {
+        var pages, all;
+        before(function () {
+          const p1 = namedNode('http://example.org/p1');
+          return Promise.all([readAll(null, p1, null, 30), document.searchTriples(null, p1, null)])
+            .then(([p, result]) => {
+              pages = p;
+              all = result.triples;
+            });
         });
 
-        it('should return 134', function () {
-          totalCount.should.equal(134);
+        it('should return 4 pages', function () {
+          pages.map(page => page.length).should.eql([30, 30, 30, 20]);
         });
 
-        it('should be an exact count', function () {
-          hasExactCount.should.equal(true);
+        it('should return the same triples as a single search', function () {
+          [].concat(...pages).should.eql(all);
         });
       });
 
-      describe('with pattern ex:s2 null null', function () {
-        var totalCount, hasExactCount;
-        before(function () {
-          return document.countTriples(namedNode('http://example.org/s2'), null, null).then(result => {
-            totalCount = result.totalCount;
-            hasExactCount = result.hasExactCount;
+      describe('with pattern null null ex:o001 and limit 1', function () {
+        it('should return all triples', function () {
+          return readAll(null, null, namedNode('http://example.org/o001'), 1).then(pages => {
+            pages.should.have.length(3);
+            pages.map(page => page[0].subject.value).should.eql([
+              'http://example.org/s1', 'http://example.org/s2', 'http://example.org/s3',
+            ]);
           });
         });
+      });
 
-        it('should return 10', function () {
-          totalCount.should.equal(10);
+      describe('with pattern ex:s2 null null and limit 10', function () {
+        it('should not return a continuation token', function () {
+          return document.searchTriples(namedNode('http://example.org/s2'), null, null, { limit: 10 })
+            .then(result => {
+              result.triples.should.have.length(10);
+              (result.continuation === null).should.be.true();
+            });
         });
+      });
 
-        it('should be an exact count', function () {
-          hasExactCount.should.equal(true);
+      describe('with an invalid continuation token', function () {
+        it('should throw an error', function () {
+          return document.searchTriples(null, null, null, { continuation: 'invalid' }).then(
+            () => Promise.reject(new Error('Expected an error')),
+            error => { error.message.should.equal('Invalid continuation token'); });
         });
       });
 
-      describe('with pattern null ex:p2 null', function () {
-        var totalCount, hasExactCount;
-        before(function () {
-          return document.countTriples(null, namedNode('http://example.org/p2'), null).then(result => {
-            totalCount = result.totalCount;
-            hasExactCount = result.hasExactCount;
-          });
+      describe('with a continuation token of another pattern', function () {
+        it('should throw an error', function () {
+          const p1 = namedNode('http://example.org/p1'), p2 = namedNode('http://example.org/p2');
+          return document.searchTriples(null, p1, null, { limit: 5 })
+            .then(result => document.searchTriples(null, p2, null, { continuation: result.continuation }))
+            .then(
+              () => Promise.reject(new Error('Expected an error')),
+              error => { error.message.should.equal('Invalid continuation token'); });
         });
+      });
+    });
 
-        it('should return 10', function () {
-          totalCount.should.equal(10);
-        });
+    describe('being searched with a signal or timeout', function () {
+      function shouldAbort(promise) {
+        return promise.then(
+          () => Promise.reject(new Error('Expected an error')),
+          error => {
+            error.name.should.equal('AbortError');
+            error.message.should.equal('The query was aborted');
+          });
+      }
 
-        it('should be an exact count', function () {
-          hasExactCount.should.equal(true);
-        });
+      it('should reject with an AbortError if the signal was already aborted', function () {
+        const controller = new AbortController();
+        controller.abort();
+        return shouldAbort(document.searchTriples(null, null, null, { signal: controller.signal }));
       });
 
-      describe('with pattern null ex:p3 null', function () {
-        var totalCount, hasExactCount;
+      it('should reject with an AbortError if the signal is aborted during the search', function () {
+        const controller = new AbortController();
+        const search = document.searchTriples(null, null, null, { signal: controller.signal });
+        controller.abort();
+        return shouldAbort(search);
+      });
+
+      it('should return all triples if the signal is not aborted', function () {
+        const controller = new AbortController();
+        return document.searchTriples(null, null, null, { signal: controller.signal, timeoutMs: 60000 })
+          .then(result => {
+            result.triples.should.have.length(134);
+            result.timedOut.should.be.false();
+          });
+      });
+
+      it('should still be searchable after an aborted search', function () {
+        const controller = new AbortController();
+        const search = document.searchTriples(null, null, null, { signal: controller.signal });
+        controller.abort();
+        return shouldAbort(search)
+          .then(() => document.searchTriples(null, null, null, { limit: 5 }))
+          .then(result => { result.triples.should.have.length(5); });
+      });
+
+      it('should reject distinct terms with an AbortError if the signal was already aborted', function () {
+        const controller = new AbortController();
+        controller.abort();
+        return shouldAbort(document.searchTerms({
+          subject: namedNode('http://example.org/s1'), position: 'predicate', signal: controller.signal,
+        }));
+      });
+
+      it('should return distinct terms within the timeout', function () {
+        return document.searchTerms({ subject: namedNode('http://example.org/s1'), position: 'predicate', timeoutMs: 60000 })
+          .then(terms => { terms.should.eql([namedNode('http://example.org/p1')]); });
+      });
+    });
+
+    describe('being searched in columnar form', function () {
+      describe('with pattern null null null', function () {
+        var columns, totalCount, hasExactCount;
         before(function () {
-          return document.countTriples(null, namedNode('http://example.org/p3'), null).then(result => {
+          return document.searchTriples(null, null, null, { columnar: true }).then(result => {
+            columns = result.columns;
             totalCount = result.totalCount;
             hasExactCount = result.hasExactCount;
           });
         });
 
-        it('should return 14', function () {
-          totalCount.should.equal(14);
+        it('should return an id for every component of every triple', function () {
+          columns.ids.should.be.an.instanceOf(Uint32Array);
+          columns.ids.should.have.length(3 * 134);
+          columns.length.should.equal(134);
         });
 
-        it('should be an exact count', function () {
-          hasExactCount.should.equal(true);
+        it('should return deduplicated string tables', function () {
+          columns.subjects.should.have.length(4);
+          columns.predicates.should.have.length(3);
+          columns.subjects[0].should.equal('http://example.org/s1');
         });
-      });
 
-      describe('with pattern null null ex:o012', function () {
-        var totalCount, hasExactCount;
-        before(function () {
-          return document.countTriples(null, null, namedNode('http://example.org/o012')).then(result => {
-            totalCount = result.totalCount;
-            hasExactCount = result.hasExactCount;
+        it('should materialize triples', function () {
+          columns.get(0).should.eql(quad(
+            namedNode('http://example.org/s1'),
+            namedNode('http://example.org/p1'),
+            namedNode('http://example.org/o001'),
+            defaultGraph()
+          ));
+        });
+
+        it('should materialize the same triples as a regular search', function () {
+          return document.searchTriples(null, null, null).then(result => {
+            columns.toArray().should.eql(result.triples);
           });
         });
 
-        it('should return 1', function () {
-          totalCount.should.equal(1);
+        it('should estimate the total count as 134', function () {
+          totalCount.should.equal(134);
         });
 
         it('should be an exact count', function () {
@@ -1309,76 +1558,1231 @@ describe('hdt', function () {
         });
       });
 
-      describe('with pattern null null "a"^^http://example.org/literal', function () {
-        var totalCount, hasExactCount;
+      describe('with pattern ex:s2 null null, offset 2 and limit 1', function () {
+        var columns;
         before(function () {
-          return document.countTriples(null, null, literal('a', namedNode('http://example.org/literal'))).then(result => {
-            totalCount = result.totalCount;
-            hasExactCount = result.hasExactCount;
+          return document.searchTriples(namedNode('http://example.org/s2'), null, null,
+            { offset: 2, limit: 1, columnar: true }).then(result => {
+            columns = result.columns;
           });
         });
 
-        it('should return 1', function () {
-          totalCount.should.equal(1);
-        });
-
-        it('should be an exact count', function () {
-          hasExactCount.should.equal(true);
+        it('should return the matching triple', function () {
+          columns.length.should.equal(1);
+          columns.object(0).should.eql(namedNode('http://example.org/o003'));
         });
       });
-    });
-  });
 
-  describe('An HDT document without a literal dictionary', function () {
-    var document;
-    before(function () {
-      return hdt.fromFile('./test/test.hdt').then(hdtDocument => {
-        document = hdtDocument;
-      });
-    });
-    after(function () {
-      return document.close();
-    });
+      describe('with a non-existing pattern', function () {
+        var columns;
+        before(function () {
+          return document.searchTriples(namedNode('a'), null, null, { columnar: true }).then(result => {
+            columns = result.columns;
+          });
+        });
 
-    describe('being searched for literals', function () {
-      it('should throw an error', function () {
-        return document.searchLiterals('abc').then(
-          () => Promise.reject(new Error('expected an error')),
-          error => {
-            error.should.be.an.instanceOf(Error);
-            error.message.should.equal('The HDT document does not support literal search');
-          }
-        );
+        it('should return empty columns', function () {
+          columns.length.should.equal(0);
+          columns.toArray().should.be.empty();
+        });
       });
     });
-  });
 
-  describe('An HDT document with a literal dictionary', function () {
-    var document;
-    before(function () {
-      return hdt.fromFile('./test/literals.hdt').then(hdtDocument => {
-        document = hdtDocument;
+    describe('being queried by ID', function () {
+      it('should expose the ID ranges of the dictionary', function () {
+        document.idRanges.should.have.properties({ shared: 0, subject: 4, predicate: 3 });
       });
-    });
-    after(function () {
-      return document.close();
-    });
 
-    describe('asked for supported features', function () {
-      it('should return an object', function () {
-        document.features.should.be.an.instanceof(Object);
+      it('should convert a term into an ID', function () {
+        return document.termToId(namedNode('http://example.org/s2'), 'subject').then(id => {
+          id.should.equal(2);
+        });
       });
 
-      it('should support searchTriples', function () {
-        document.features.searchTriples.should.be.true();
+      it('should convert several terms into IDs', function () {
+        return document.termToId([
+          namedNode('http://example.org/p2'),
+          namedNode('http://example.org/unknown'),
+          namedNode('http://example.org/p1'),
+        ], 'predicate').then(ids => {
+          ids.should.be.an.instanceOf(Uint32Array);
+          Array.from(ids).should.eql([2, 0, 1]);
+        });
       });
 
-      it('should support countTriples', function () {
-        document.features.countTriples.should.be.true();
+      it('should convert literals into IDs and back', function () {
+        const term = literal('a', namedNode('http://example.org/literal'));
+        return document.termToId(term, 'object')
+          .then(id => {
+            id.should.be.above(0);
+            return document.idToTerm(id, 'object');
+          })
+          .then(result => {
+            result.should.eql(term);
+          });
       });
 
-      it('should support searchLiterals', function () {
-        document.features.searchLiterals.should.be.true();
+      it('should convert several IDs into terms', function () {
+        return document.idToTerm(Uint32Array.of(1, 5, 0), 'subject').then(terms => {
+          terms.should.eql([namedNode('http://example.org/s1'), null, null]);
+        });
+      });
+
+      it('should throw on an invalid position', function () {
+        return document.idToTerm(1, 'graph').then(
+          () => Promise.reject(new Error('Expected an error')),
+          error => {
+            error.message.should.equal('Invalid position argument. Expected subject, predicate or object.');
+          }
+        );
+      });
+
+      describe('with pattern 2 0 0', function () {
+        var result;
+        before(function () {
+          return document.searchTripleIds(2, 0, 0, { offset: 2, limit: 3 }).then(r => {
+            result = r;
+          });
+        });
+
+        it('should return the IDs of the matching triples', function () {
+          result.ids.should.be.an.instanceOf(Uint32Array);
+          result.ids.should.have.length(9);
+          Array.from(result.ids.filter((id, i) => i % 3 !== 2)).should.eql([2, 1, 2, 1, 2, 1]);
+        });
+
+        it('should return IDs that decode to the matching terms', function () {
+          return document.idToTerm(result.ids[2], 'object').then(term => {
+            term.should.eql(namedNode('http://example.org/o003'));
+          });
+        });
+
+        it('should estimate the total count as 10', function () {
+          result.totalCount.should.equal(10);
+          result.hasExactCount.should.be.true();
+        });
+      });
+
+      describe('with an ID outside of the dictionary', function () {
+        it('should return no triples', function () {
+          return document.searchTripleIds(0, 100, 0).then(result => {
+            result.ids.should.have.length(0);
+            result.totalCount.should.equal(0);
+          });
+        });
+      });
+    });
+
+    describe('being evaluated as a basic graph pattern', function () {
+      describe('with patterns ?s ex:p1 ?o and ?x ex:p2 ?o', function () {
+        var result;
+        before(function () {
+          return document.evaluateBGP([
+            [variable('s'), namedNode('http://example.org/p1'), variable('o')],
+            [variable('x'), namedNode('http://example.org/p2'), variable('o')],
+          ]).then(r => { result = r; });
+        });
+
+        it('should return the variables', function () {
+          result.variables.should.have.length(3);
+          result.variables.should.containDeep(['s', 'o', 'x']);
+        });
+
+        it('should return 20 bindings', function () {
+          result.bindings.should.have.length(20);
+        });
+
+        it('should join the patterns on ?o', function () {
+          result.bindings.forEach(binding => {
+            binding.x.should.eql(namedNode('http://example.org/s3'));
+            binding.o.value.should.match(/^http:\/\/example\.org\/o0(0\d|10)$/);
+            ['http://example.org/s1', 'http://example.org/s2'].should.containEql(binding.s.value);
+          });
+        });
+      });
+
+      describe('with patterns ?s ex:p1 ?o and ?x ex:p2 ?o, offset 18 and limit 5', function () {
+        it('should return 2 bindings', function () {
+          return document.evaluateBGP([
+            [variable('s'), namedNode('http://example.org/p1'), variable('o')],
+            [variable('x'), namedNode('http://example.org/p2'), variable('o')],
+          ], { offset: 18, limit: 5 }).then(result => {
+            result.bindings.should.have.length(2);
+          });
+        });
+      });
+
+      describe('with patterns ex:s1 ex:p1 ?o and ?x ex:p2 ?o, which are merged on ?o', function () {
+        const patterns = [
+          [namedNode('http://example.org/s1'), namedNode('http://example.org/p1'), variable('o')],
+          [variable('x'), namedNode('http://example.org/p2'), variable('o')],
+        ];
+        var result;
+        before(function () {
+          return document.evaluateBGP(patterns).then(r => { result = r; });
+        });
+
+        it('should return 10 bindings', function () {
+          result.bindings.should.have.length(10);
+          result.bindings.forEach(binding => {
+            binding.x.should.eql(namedNode('http://example.org/s3'));
+            binding.o.value.should.match(/^http:\/\/example\.org\/o0(0\d|10)$/);
+          });
+        });
+
+        it('should return the same bindings with an offset and limit', function () {
+          return document.evaluateBGP(patterns, { offset: 3, limit: 4 }).then(page => {
+            page.bindings.should.eql(result.bindings.slice(3, 7));
+          });
+        });
+      });
+
+      describe('with a quad pattern ?s ex:p3 ?o', function () {
+        it('should return 14 bindings', function () {
+          return document.evaluateBGP([
+            quad(variable('s'), namedNode('http://example.org/p3'), variable('o')),
+          ]).then(result => {
+            result.variables.should.eql(['s', 'o']);
+            result.bindings.should.have.length(14);
+            result.bindings[0].s.should.eql(namedNode('http://example.org/s4'));
+          });
+        });
+      });
+
+      describe('with a non-existing constant', function () {
+        it('should return no bindings', function () {
+          return document.evaluateBGP([
+            [variable('s'), namedNode('http://example.org/p1'), variable('o')],
+            [variable('s'), namedNode('http://example.org/unknown'), variable('x')],
+          ]).then(result => {
+            result.bindings.should.have.length(0);
+          });
+        });
+      });
+
+      describe('without patterns', function () {
+        it('should return a single empty binding', function () {
+          return document.evaluateBGP([]).then(result => {
+            result.variables.should.eql([]);
+            result.bindings.should.eql([{}]);
+          });
+        });
+      });
+    });
+
+    describe('being searched with a cursor', function () {
+      describe('with a non-existing pattern', function () {
+        var cursor;
+        before(function () {
+          return document.searchTriplesCursor(namedNode('a'), null, null).then(result => {
+            cursor = result;
+          });
+        });
+
+        it('should estimate the total count as 0', function () {
+          cursor.totalCount.should.equal(0);
+        });
+
+        it('should return no triples', function () {
+          return cursor.next(10).then(triples => {
+            triples.should.be.an.Array();
+            triples.should.be.empty();
+            cursor.done.should.be.true();
+          });
+        });
+      });
+
+      describe('with pattern null null null, read in batches of 50', function () {
+        var cursor, batches = [];
+        before(function () {
+          return document.searchTriplesCursor(null, null, null).then(result => {
+            cursor = result;
+            return readBatches();
+          });
+          function readBatches() {
+            return cursor.next(50).then(triples => {
+              if (triples.length === 0) return;
+              batches.push(triples);
+              return readBatches();
+            });
+          }
+        });
+
+        it('should estimate the total count as 134', function () {
+          cursor.totalCount.should.equal(134);
+        });
+
+        it('should be an exact count', function () {
+          cursor.hasExactCount.should.be.true();
+        });
+
+        it('should return all triples in batches', function () {
+          batches.map(b => b.length).should.eql([50, 50, 34]);
+          batches[0][0].should.eql(quad(
+            namedNode('http://example.org/s1'),
+            namedNode('http://example.org/p1'),
+            namedNode('http://example.org/o001'),
+            defaultGraph()
+          ));
+        });
+
+        it('should be done', function () {
+          cursor.done.should.be.true();
+        });
+      });
+
+      describe('with pattern ex:s2 null null, offset 2 and limit 5', function () {
+        var triples = [];
+        before(function () {
+          return document.searchTriplesCursor(namedNode('http://example.org/s2'), null, null,
+            { offset: 2, limit: 5 }).then(cursor => {
+            const iterator = cursor[Symbol.asyncIterator]();
+            return (function next() {
+              return iterator.next().then(item => {
+                if (item.done) return;
+                triples.push(item.value);
+                return next();
+              });
+            })();
+          });
+        });
+
+        it('should iterate over the triples within the offset and limit', function () {
+          triples.should.have.length(5);
+          triples[0].should.eql(quad(
+            namedNode('http://example.org/s2'),
+            namedNode('http://example.org/p1'),
+            namedNode('http://example.org/o003'),
+            defaultGraph()
+          ));
+        });
+      });
+
+      describe('with pattern null ex:p2 null as a stream', function () {
+        var triples = [];
+        before(function (done) {
+          document.streamTriples(null, namedNode('http://example.org/p2'), null, { batchSize: 3 })
+            .on('data', triple => triples.push(triple))
+            .on('error', done)
+            .on('end', done);
+        });
+
+        it('should stream all matching triples', function () {
+          triples.should.have.length(10);
+          triples[0].should.eql(quad(
+            namedNode('http://example.org/s3'),
+            namedNode('http://example.org/p2'),
+            namedNode('http://example.org/o001'),
+            defaultGraph()
+          ));
+        });
+      });
+
+      describe('that is closed early', function () {
+        var cursor;
+        before(function () {
+          return document.searchTriplesCursor(null, null, null).then(result => {
+            cursor = result;
+            return cursor.close();
+          });
+        });
+
+        it('should be closed', function () {
+          cursor.closed.should.be.true();
+        });
+
+        it('should return no more triples', function () {
+          return cursor.next(10).then(triples => {
+            triples.should.be.empty();
+          });
+        });
+      });
+    });
+
+    describe('caching decoded terms', function () {
+      it('should report the cache capacity', function () {
+        document.termCacheStats.capacity.should.equal(32 * 1024 * 1024);
+      });
+
+      it('should serve repeated searches from the cache', function () {
+        const s2 = namedNode('http://example.org/s2');
+        let misses;
+        return document.searchTriples(s2, null, null)
+          .then(() => {
+            misses = document.termCacheStats.misses;
+            document.termCacheStats.entries.should.be.above(0);
+            return document.searchTriples(s2, null, null);
+          })
+          .then(() => {
+            const stats = document.termCacheStats;
+            stats.misses.should.equal(misses);
+            stats.hits.should.be.aboveOrEqual(12);
+          });
+      });
+    });
+
+    describe('being counted', function () {
+      describe('with a non-existing pattern', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(namedNode('a'), null, null).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 0', function () {
+          totalCount.should.equal(0);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+
+      describe('with pattern null null null', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(null, null, null).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 134', function () {
+          totalCount.should.equal(134);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+
+      describe('with pattern ex:s2 null null', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(namedNode('http://example.org/s2'), null, null).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 10', function () {
+          totalCount.should.equal(10);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+
+      describe('with pattern null ex:p2 null', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(null, namedNode('http://example.org/p2'), null).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 10', function () {
+          totalCount.should.equal(10);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+
+      describe('with pattern null ex:p3 null', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(null, namedNode('http://example.org/p3'), null).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 14', function () {
+          totalCount.should.equal(14);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+
+      describe('with pattern null null ex:o012', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(null, null, namedNode('http://example.org/o012')).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 1', function () {
+          totalCount.should.equal(1);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+
+      describe('with pattern null null "a"^^http://example.org/literal', function () {
+        var totalCount, hasExactCount;
+        before(function () {
+          return document.countTriples(null, null, literal('a', namedNode('http://example.org/literal'))).then(result => {
+            totalCount = result.totalCount;
+            hasExactCount = result.hasExactCount;
+          });
+        });
+
+        it('should return 1', function () {
+          totalCount.should.equal(1);
+        });
+
+        it('should be an exact count', function () {
+          hasExactCount.should.equal(true);
+        });
+      });
+    });
+  });
+
+  describe('An HDT document without a term cache', function () {
+    var document;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt', { termCacheSize: 0 }).then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    it('should not cache terms', function () {
+      return document.searchTriples(null, null, null, { limit: 10 }).then(result => {
+        result.triples.should.have.length(10);
+        document.termCacheStats.should.have.properties({ capacity: 0, entries: 0, hits: 0 });
+      });
+    });
+  });
+
+  describe('An HDT document being measured', function () {
+    var document;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt').then(hdtDocument => {
+        document = hdtDocument;
+        return document.searchTriples(null, namedNode('http://example.org/p1'), null, { offset: 5, limit: 10 });
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    it('should measure the phases of searches', function () {
+      const phases = document.stats().operations.searchTriples;
+      phases.should.have.properties('queue', 'resolve', 'skip', 'decode', 'execute', 'callback');
+      phases.execute.count.should.equal(1);
+      phases.execute.max.should.be.aboveOrEqual(phases.execute.p50);
+    });
+
+    it('should count the work of searches', function () {
+      const counters = document.stats().counters;
+      counters.triplesReturned.should.equal(10);
+      counters.triplesScanned.should.be.aboveOrEqual(10);
+      counters.termsDecoded.should.be.above(0);
+      counters.bytesAllocated.should.be.above(0);
+    });
+
+    it('should include the cache statistics', function () {
+      document.stats().termCache.should.eql(document.termCacheStats);
+    });
+
+    it('should clear the measurements after a reset', function () {
+      document.stats({ reset: true }).operations.should.have.property('searchTriples');
+      const stats = document.stats();
+      stats.operations.should.eql({});
+      stats.counters.triplesReturned.should.equal(0);
+    });
+  });
+
+  describe('An HDT document with a page cache', function () {
+    var document;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt', { pageCacheSize: 1024 * 1024 }).then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    it('should report the cache capacity', function () {
+      document.pageCacheStats.should.have.properties({ capacity: 1024 * 1024, entries: 0 });
+    });
+
+    it('should serve a repeated search from the cache', function () {
+      const p1 = namedNode('http://example.org/p1');
+      let first;
+      return document.searchTriples(null, p1, null, { offset: 5, limit: 10 })
+        .then(result => {
+          first = result;
+          document.pageCacheStats.should.have.properties({ hits: 0, misses: 1, entries: 1 });
+          return document.searchTriples(null, p1, null, { offset: 5, limit: 10 });
+        })
+        .then(result => {
+          result.should.eql(first);
+          result.triples.should.have.length(10);
+          document.pageCacheStats.should.have.properties({ hits: 1, misses: 1, entries: 1 });
+        });
+    });
+
+    it('should cache different pages separately', function () {
+      const p1 = namedNode('http://example.org/p1');
+      return Promise.all([
+        document.searchTriples(null, p1, null, { offset: 15, limit: 10 }),
+        document.searchTriples(null, p1, null, { offset: 5, limit: 10, columnar: true }),
+      ]).then(([page, columnar]) => {
+        page.triples.should.have.length(10);
+        columnar.columns.length.should.equal(10);
+        document.pageCacheStats.entries.should.equal(3);
+      });
+    });
+
+    describe('that is small', function () {
+      var smallDocument;
+      before(function () {
+        return hdt.fromFile('./test/test.hdt', { pageCacheSize: 64 * 1024 }).then(hdtDocument => {
+          smallDocument = hdtDocument;
+        });
+      });
+      after(function () {
+        return smallDocument.close();
+      });
+
+      it('should cache a page larger than a sixteenth of the cache', function () {
+        return smallDocument.searchTriples(null, null, null, { limit: 1000 }).then(result => {
+          result.triples.should.have.length(134);
+          smallDocument.pageCacheStats.should.have.properties({ entries: 1, oversized: 0 });
+        });
+      });
+    });
+  });
+
+  describe('An HDT document being exported', function () {
+    var document, directory;
+    before(function () {
+      directory = fs.mkdtempSync(path.join(os.tmpdir(), 'hdt-export-'));
+      return hdt.fromFile('./test/test.hdt').then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close().then(() => fs.rmSync(directory, { recursive: true, force: true }));
+    });
+
+    describe('to a file', function () {
+      var count, lines;
+      before(function () {
+        const file = path.join(directory, 'export.nt');
+        return document.exportTo(file, { threads: 4 }).then(result => {
+          count = result;
+          lines = fs.readFileSync(file, 'utf8').split('\n');
+        });
+      });
+
+      it('should return the number of triples', function () {
+        count.should.equal(134);
+      });
+
+      it('should write one line per triple', function () {
+        lines.pop().should.equal('');
+        lines.should.have.length(134);
+      });
+
+      it('should write the triples in the order of the expected export', function () {
+        const expected = fs.readFileSync('./test/testexport.nt', 'utf8').split('\n').filter(line => line);
+        var position = -1;
+        expected.forEach(line => {
+          const found = lines.indexOf(line, position + 1);
+          found.should.be.above(position);
+          position = found;
+        });
+      });
+    });
+
+    describe('to a file descriptor', function () {
+      it('should write the same triples as with a single thread', function () {
+        const file = path.join(directory, 'export-fd.nt'), fd = fs.openSync(file, 'w');
+        return document.exportTo(fd, { threads: 1 }).then(count => {
+          fs.closeSync(fd);
+          count.should.equal(134);
+          fs.readFileSync(file, 'utf8').should.equal(fs.readFileSync(path.join(directory, 'export.nt'), 'utf8'));
+        });
+      });
+    });
+
+    describe('in an unsupported format', function () {
+      it('should throw an error', function () {
+        return document.exportTo(path.join(directory, 'export.ttl'), { format: 'text/turtle' })
+          .then(() => Promise.reject(new Error('Expected an error')), error => {
+            error.should.be.an.Error();
+            error.message.should.equal('Unsupported export format: text/turtle');
+          });
+      });
+    });
+  });
+
+  describe('An HDT document with its own query threads', function () {
+    var document;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt', { threads: 2 }).then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    it('should answer concurrent searches of different kinds', function () {
+      const s1 = namedNode('http://example.org/s1'), p1 = namedNode('http://example.org/p1');
+      return Promise.all([
+        document.searchTriples(null, null, null),
+        document.countTriples(s1, null, null),
+        document.searchTriples(null, p1, null, { offset: 100, limit: 5 }),
+        document.termToId(s1, 'subject'),
+        document.readHeader(),
+      ]).then(([all, count, page, id, header]) => {
+        all.triples.should.have.length(134);
+        count.totalCount.should.equal(100);
+        page.triples.should.have.length(5);
+        id.should.equal(1);
+        header.should.be.a.String();
+      });
+    });
+
+    it('should answer many searches at once', function () {
+      const searches = [];
+      for (let i = 0; i < 100; i++)
+        searches.push(document.searchTriples(null, null, null, { offset: i, limit: 1 }));
+      return Promise.all(searches).then(results => {
+        results.forEach(result => { result.triples.should.have.length(1); });
+        results[10].triples[0].object.value.should.equal('http://example.org/o011');
+      });
+    });
+
+    it('should stream triples through a cursor', function () {
+      return document.searchTriplesCursor(null, null, null)
+        .then(cursor => cursor.next(50).then(triples => {
+          triples.should.have.length(50);
+          return cursor.close();
+        }));
+    });
+  });
+
+  describe('A shared HDT document', function () {
+    var document, other;
+    before(function () {
+      return Promise.all([
+        hdt.fromFile('./test/test.hdt', { shared: true }),
+        hdt.fromFile('./test/test.hdt', { shared: true, backgroundIndex: true }),
+      ]).then(([hdtDocument, otherDocument]) => {
+        document = hdtDocument;
+        other = otherDocument;
+      });
+    });
+    after(function () {
+      return Promise.all([document.close(), other.close()]);
+    });
+
+    it('should have its index right away', function () {
+      return other.indexReady.then(() => other.searchTriples(null, null, namedNode('http://example.org/o001')))
+        .then(result => { result.triples.should.have.length(3); });
+    });
+
+    it('should find the same triples through every document', function () {
+      return Promise.all([
+        document.searchTriples(null, null, null),
+        other.searchTriples(null, null, null),
+      ]).then(([triples, otherTriples]) => {
+        triples.triples.should.have.length(134);
+        otherTriples.triples.should.eql(triples.triples);
+      });
+    });
+
+    it('should remain usable after another document of the file is closed', function () {
+      return hdt.fromFile('./test/test.hdt', { shared: true })
+        .then(closing => closing.close())
+        .then(() => document.countTriples(null, null, null))
+        .then(result => { result.totalCount.should.equal(134); });
+    });
+
+    it('should be usable from worker threads', function () {
+      const script = `
+        const { parentPort, workerData } = require('worker_threads');
+        require(workerData.module).fromFile(workerData.file, { shared: true, threads: 1 })
+          .then(document => document.countTriples(null, null, null)
+            .then(result => document.close().then(() => parentPort.postMessage(result.totalCount))))
+          .catch(error => parentPort.postMessage(error.message));`;
+      const workerData = { module: path.join(__dirname, '../lib/hdt'), file: './test/test.hdt' };
+      const counts = [1, 2, 3].map(() => new Promise((resolve, reject) => {
+        const worker = new Worker(script, { eval: true, workerData });
+        worker.once('message', resolve);
+        worker.once('error', reject);
+      }));
+      return Promise.all(counts).then(results => { results.should.eql([134, 134, 134]); });
+    });
+  });
+
+  describe('An HDT document with pattern statistics', function () {
+    var document, indexDirectory;
+    before(function () {
+      indexDirectory = fs.mkdtempSync(path.join(os.tmpdir(), 'hdt-stats-'));
+      return hdt.fromFile('./test/test.hdt', { statistics: true, indexDirectory }).then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close().then(() => fs.rmSync(indexDirectory, { recursive: true, force: true }));
+    });
+
+    it('should count a predicate exactly', function () {
+      return document.countTriples(null, namedNode('http://example.org/p1'), null).then(result => {
+        result.totalCount.should.equal(110);
+        result.hasExactCount.should.be.true();
+      });
+    });
+
+    it('should count a predicate and object exactly', function () {
+      return document.countTriples(null, namedNode('http://example.org/p1'), namedNode('http://example.org/o001'))
+        .then(result => {
+          result.totalCount.should.equal(2);
+          result.hasExactCount.should.be.true();
+        });
+    });
+
+    it('should count all triples exactly', function () {
+      return document.countTriples(null, null, null).then(result => {
+        result.totalCount.should.equal(134);
+        result.hasExactCount.should.be.true();
+      });
+    });
+
+    it('should evaluate a basic graph pattern', function () {
+      return document.evaluateBGP([
+        [variable('s'), namedNode('http://example.org/p1'), variable('o')],
+        [variable('x'), namedNode('http://example.org/p2'), variable('o')],
+      ]).then(result => {
+        result.bindings.should.have.length(20);
+      });
+    });
+
+    it('should store the statistics in the index directory', function () {
+      sidecarFile(indexDirectory, '.stats').should.be.a.String();
+    });
+
+    describe('when opened again', function () {
+      var reopened, modified;
+      before(function () {
+        modified = fs.statSync(sidecarFile(indexDirectory, '.stats')).mtimeMs;
+        return hdt.fromFile('./test/test.hdt', { statistics: true, indexDirectory }).then(hdtDocument => {
+          reopened = hdtDocument;
+        });
+      });
+      after(function () {
+        return reopened.close();
+      });
+
+      it('should not compute the statistics again', function () {
+        fs.statSync(sidecarFile(indexDirectory, '.stats')).mtimeMs.should.equal(modified);
+      });
+
+      it('should read the statistics from their file', function () {
+        return reopened.countTriples(null, namedNode('http://example.org/p1'), null).then(result => {
+          result.totalCount.should.equal(110);
+          result.hasExactCount.should.be.true();
+        });
+      });
+    });
+  });
+
+  describe('An HDT document with a literal index', function () {
+    var document, indexDirectory;
+    before(function () {
+      indexDirectory = fs.mkdtempSync(path.join(os.tmpdir(), 'hdt-literals-'));
+      return hdt.fromFile('./test/test.hdt', { literalIndex: true, indexDirectory }).then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close().then(() => fs.rmSync(indexDirectory, { recursive: true, force: true }));
+    });
+
+    it('should support searchLiterals', function () {
+      document.features.searchLiterals.should.be.true();
+    });
+
+    it('should store the index in the index directory', function () {
+      sidecarFile(indexDirectory, '.literals').should.be.a.String();
+    });
+
+    it('should find substrings regardless of case', function () {
+      return document.searchLiterals('A"B').then(result => {
+        result.literals.should.have.length(4);
+        result.literals.forEach(l => l.value.should.equal('a"b\'c\\\r\n\\'));
+        result.totalCount.should.equal(4);
+        result.hasExactCount.should.be.true();
+        (result.continuation === null).should.be.true();
+      });
+    });
+
+    it('should find words that start with the query words', function () {
+      return document.searchLiterals('XSD str', { mode: 'token' }).then(result => {
+        result.literals.should.eql([literal('"a"^^xsd:string', 'en')]);
+        result.totalCount.should.equal(1);
+      });
+    });
+
+    it('should find literals matching a regular expression', function () {
+      return document.searchLiterals(/^a$/).then(result => {
+        result.literals.should.have.length(5);
+        result.literals.forEach(l => l.value.should.equal('a'));
+      });
+    });
+
+    it('should find literals matching a case-insensitive regular expression', function () {
+      return document.searchLiterals(/^A$/i).then(result => {
+        result.literals.should.have.length(5);
+      });
+    });
+
+    it('should find literals matching a case-insensitive regular expression string', function () {
+      return document.searchLiterals('^A$', { mode: 'regexIgnoreCase' }).then(result => {
+        result.literals.should.have.length(5);
+      });
+    });
+
+    it('should reject regular expression flags other than i', function () {
+      return document.searchLiterals(/^a$/imu).then(
+        () => Promise.reject(new Error('Expected an error')),
+        error => { error.message.should.equal('Unsupported regular expression flags: mu'); });
+    });
+
+    it('should find literals matching a regular expression string', function () {
+      return document.searchLiterals("b'c", { mode: 'regex' }).then(result => {
+        result.totalCount.should.equal(4);
+      });
+    });
+
+    it('should continue searching after the previous page', function () {
+      const pages = [];
+      function readPage(continuation) {
+        return document.searchLiterals('a', { limit: 4, continuation }).then(result => {
+          pages.push(result);
+          return result.continuation ? readPage(result.continuation) : pages;
+        });
+      }
+      return readPage().then(() => {
+        pages.map(p => p.literals.length).should.eql([4, 4, 2]);
+        pages.map(p => p.totalCount).should.eql([10, 6, 2]);
+        const values = [].concat(...pages.map(p => p.literals)).map(l => l.id);
+        new Set(values).size.should.equal(10);
+      });
+    });
+
+    it('should reject an unsupported search mode', function () {
+      return document.searchLiterals('a', { mode: 'fuzzy' }).then(
+        () => Promise.reject(new Error('Expected an error')),
+        error => { error.message.should.equal('Unsupported literal search mode: fuzzy'); });
+    });
+
+    describe('with dates and accented literals', function () {
+      var dated, directory;
+      before(function () {
+        directory = fs.mkdtempSync(path.join(os.tmpdir(), 'hdt-regex-'));
+        const input = path.join(directory, 'input.nt');
+        fs.writeFileSync(input, '<http://example.org/s> <http://example.org/p> "2023-12" .\n' +
+                                '<http://example.org/s> <http://example.org/p> "Apple" .\n' +
+                                '<http://example.org/s> <http://example.org/p> "caf\u00e9" .\n');
+        return hdt.fromRdf(input, path.join(directory, 'dated.hdt'), { literalIndex: true, indexDirectory: directory })
+          .then(hdtDocument => {
+            dated = hdtDocument;
+          });
+      });
+      after(function () {
+        return dated.close().then(() => fs.rmSync(directory, { recursive: true, force: true }));
+      });
+
+      it('should find literals matching a quantified regular expression', function () {
+        return dated.searchLiterals(/^\d{4}-\d{2}$/).then(result => {
+          result.literals.should.eql([literal('2023-12')]);
+        });
+      });
+
+      it('should find literals matching a regular expression with escapes', function () {
+        return Promise.all([dated.searchLiterals(/^\x41pple$/), dated.searchLiterals(/^\u0041pple$/)])
+          .then(results => {
+            results.forEach(result => result.literals.should.eql([literal('Apple')]));
+          });
+      });
+
+      it('should find literals matching an optional non-ASCII character', function () {
+        return dated.searchLiterals(/^café?$/).then(result => {
+          result.literals.should.eql([literal('café')]);
+        });
+      });
+    });
+
+    describe('when opened again', function () {
+      var reopened, modified;
+      before(function () {
+        modified = fs.statSync(sidecarFile(indexDirectory, '.literals')).mtimeMs;
+        return hdt.fromFile('./test/test.hdt', { literalIndex: true, indexDirectory }).then(hdtDocument => {
+          reopened = hdtDocument;
+        });
+      });
+      after(function () {
+        return reopened.close();
+      });
+
+      it('should not compute the index again', function () {
+        fs.statSync(sidecarFile(indexDirectory, '.literals')).mtimeMs.should.equal(modified);
+      });
+
+      it('should read the index from its file', function () {
+        return reopened.searchLiterals('a"b', { limit: 1 }).then(result => {
+          result.literals.should.have.length(1);
+          result.totalCount.should.equal(4);
+          result.continuation.should.be.a.String();
+        });
+      });
+    });
+  });
+
+  describe('An HDT document with its index built in the background', function () {
+    var document, indexDirectory, progress = [];
+    before(function () {
+      indexDirectory = fs.mkdtempSync(path.join(os.tmpdir(), 'hdt-index-'));
+      return hdt.fromFile('./test/test.hdt', {
+        backgroundIndex: true,
+        indexDirectory,
+        onProgress: report => progress.push(report),
+      }).then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close().then(() => fs.rmSync(indexDirectory, { recursive: true, force: true }));
+    });
+
+    it('should answer searches before the index is ready', function () {
+      return document.searchTriples(null, namedNode('http://example.org/p2'), null).then(result => {
+        result.triples.should.have.length(10);
+      });
+    });
+
+    it('should answer searches by object once the index is ready', function () {
+      return document.indexReady
+        .then(() => document.searchTriples(null, null, namedNode('http://example.org/o001')))
+        .then(result => {
+          result.triples.should.have.length(3);
+        });
+    });
+
+    it('should store the index in the index directory', function () {
+      return document.indexReady.then(() => {
+        fs.readdirSync(indexDirectory).some(file => /\.index/.test(file)).should.be.true();
+      });
+    });
+
+    it('should report progress as stages and percentages', function () {
+      progress.forEach(report => {
+        report.stage.should.be.a.String();
+        report.level.should.be.a.Number();
+      });
+    });
+  });
+
+  describe('An HDT document with memory controls', function () {
+    var document, prefetched;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt', {
+        memory: { prefetch: ['dictionary', 'triples'], advice: { dictionary: 'random', triples: 'sequential' } },
+      }).then(hdtDocument => {
+        document = hdtDocument;
+        return document.memoryReady;
+      }).then(result => {
+        prefetched = result;
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    it('should prefetch all sections', function () {
+      prefetched.should.be.true();
+    });
+
+    it('should report every section of the file', function () {
+      const memory = document.memory();
+      memory.should.have.keys('header', 'dictionary', 'triples', 'index');
+      (memory.header.mapped + memory.dictionary.mapped + memory.triples.mapped)
+        .should.equal(fs.statSync('./test/test.hdt').size);
+      memory.header.mapped.should.be.above(0);
+      memory.index.mapped.should.be.above(0);
+    });
+
+    it('should report prefetched sections as resident', function () {
+      const memory = document.memory();
+      memory.dictionary.resident.should.equal(memory.dictionary.mapped);
+      memory.triples.resident.should.equal(memory.triples.mapped);
+      memory.triples.locked.should.be.false();
+    });
+
+    describe('without memory options', function () {
+      it('should report every section of the file once asked', function () {
+        return hdt.fromFile('./test/test.hdt').then(plainDocument => {
+          const memory = plainDocument.memory();
+          (memory.header.mapped + memory.dictionary.mapped + memory.triples.mapped)
+            .should.equal(fs.statSync('./test/test.hdt').size);
+          return plainDocument.close();
+        });
+      });
+    });
+
+    describe('with an unknown section', function () {
+      it('should throw an error', function () {
+        return hdt.fromFile('./test/test.hdt', { memory: { prefetch: ['literals'] } })
+          .then(() => Promise.reject(new Error('Expected an error')), error => {
+            error.should.be.an.Error();
+            error.message.should.equal('Unknown memory section: literals');
+          });
+      });
+    });
+
+    describe('with an unknown access pattern', function () {
+      it('should throw an error', function () {
+        return hdt.fromFile('./test/test.hdt', { memory: { advice: 'often' } })
+          .then(() => Promise.reject(new Error('Expected an error')), error => {
+            error.should.be.an.Error();
+            error.message.should.equal('Unknown memory advice: often');
+          });
+      });
+    });
+  });
+
+  describe('An HDT document generated from RDF', function () {
+    var directory;
+    before(function () {
+      directory = fs.mkdtempSync(path.join(os.tmpdir(), 'hdt-generate-'));
+    });
+    after(function () {
+      fs.rmSync(directory, { recursive: true, force: true });
+    });
+
+    describe('from an N-Triples file', function () {
+      var document;
+      before(function () {
+        const input = path.join(directory, 'input.nt');
+        fs.writeFileSync(input, '<http://example.org/s> <http://example.org/p> <http://example.org/o1> .\n' +
+                                '<http://example.org/s> <http://example.org/p> "o2" .\n');
+        return hdt.fromRdf(input, path.join(directory, 'ntriples.hdt')).then(hdtDocument => {
+          document = hdtDocument;
+        });
+      });
+      after(function () {
+        return document.close();
+      });
+
+      it('should contain all triples', function () {
+        return document.searchTriples(namedNode('http://example.org/s'), null, null).then(result => {
+          result.triples.should.have.length(2);
+          result.triples[1].object.should.eql(literal('o2'));
+        });
+      });
+    });
+
+    describe('from a Turtle stream', function () {
+      var document;
+      before(function () {
+        return hdt.fromRdf(fs.createReadStream('./test/test.ttl'), path.join(directory, 'turtle.hdt'),
+          { format: 'text/turtle' }).then(hdtDocument => {
+          document = hdtDocument;
+        });
+      });
+      after(function () {
+        return document.close();
+      });
+
+      it('should contain all triples', function () {
+        return document.countTriples(null, null, null).then(result => {
+          result.totalCount.should.equal(134);
+        });
+      });
+    });
+
+    describe('with an invalid output filename', function () {
+      it('should throw an error', function () {
+        return hdt.fromRdf('./test/test.ttl', '').then(() => Promise.reject(new Error('Expected an error')), error => {
+          error.should.be.an.Error();
+          error.message.should.equal('Invalid output filename: ');
+        });
+      });
+    });
+  });
+
+  describe('An HDT document without a literal dictionary', function () {
+    var document;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt').then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    describe('being searched for literals', function () {
+      it('should throw an error', function () {
+        return document.searchLiterals('abc').then(
+          () => Promise.reject(new Error('expected an error')),
+          error => {
+            error.should.be.an.instanceOf(Error);
+            error.message.should.equal('The HDT document does not support literal search');
+          }
+        );
+      });
+    });
+  });
+
+  describe('An HDT document with a literal dictionary', function () {
+    var document;
+    before(function () {
+      return hdt.fromFile('./test/literals.hdt').then(hdtDocument => {
+        document = hdtDocument;
+      });
+    });
+    after(function () {
+      return document.close();
+    });
+
+    describe('asked for supported features', function () {
+      it('should return an object', function () {
+        document.features.should.be.an.instanceof(Object);
+      });
+
+      it('should support searchTriples', function () {
+        document.features.searchTriples.should.be.true();
+      });
+
+      it('should support countTriples', function () {
+        document.features.countTriples.should.be.true();
+      });
+
+      it('should support searchLiterals', function () {
+        document.features.searchLiterals.should.be.true();
       });
 
       it('should support readHeader', function () {
@@ -1615,7 +3019,151 @@ describe('hdt', function () {
         totalCount.should.equal(12);
       });
     });
+
+    describe('for the literal "b" with a timeout', function () {
+      it('should return all literals that were found in time', function () {
+        return document.searchLiterals('b', { timeoutMs: 60000 }).then(result => {
+          result.literals.should.have.length(12);
+          result.hasExactCount.should.be.true();
+          result.timedOut.should.be.false();
+        });
+      });
+
+      it('should reject with an AbortError if the signal was already aborted', function () {
+        const controller = new AbortController();
+        controller.abort();
+        return document.searchLiterals('b', { signal: controller.signal }).then(
+          () => Promise.reject(new Error('Expected an error')),
+          error => { error.name.should.equal('AbortError'); });
+      });
+    });
+
+    describe('for words without a literal index', function () {
+      it('should throw an error', function () {
+        return document.searchLiterals('b', { mode: 'token' }).then(
+          () => Promise.reject(new Error('Expected an error')),
+          error => {
+            error.message.should.equal('The HDT document needs a literal index for this kind of literal search');
+          });
+      });
+    });
+  });
+  describe('A union of HDT documents', function () {
+    var union, document;
+    before(function () {
+      return Promise.all([
+        hdt.fromFiles(['./test/test.hdt', './test/test.hdt', './test/literals.hdt']),
+        hdt.fromFile('./test/test.hdt'),
+      ]).then(documents => {
+        union = documents[0];
+        document = documents[1];
+      });
+    });
+    after(function () {
+      return Promise.all([union.close(), document.close()]);
+    });
+
+    it('should expose its documents', function () {
+      union.documents.should.have.length(3);
+      union.closed.should.be.false();
+    });
+
+    describe('being counted', function () {
+      it('should sum the counts of all documents', function () {
+        return Promise.all([union.countTriples(null, null, null),
+                            union.documents[2].countTriples(null, null, null)]).then(([result, literals]) => {
+          result.totalCount.should.equal(268 + literals.totalCount);
+          result.hasExactCount.should.be.true();
+        });
+      });
+    });
+
+    describe('being searched with an offset across documents', function () {
+      it('should continue in the next document', function () {
+        return Promise.all([
+          union.searchTriples(null, null, null, { offset: 130, limit: 10 }),
+          document.searchTriples(null, null, null, { offset: 130 }),
+          document.searchTriples(null, null, null, { limit: 6 }),
+        ]).then(([result, end, start]) => {
+          result.triples.should.eql(end.triples.concat(start.triples));
+        });
+      });
+    });
+
+    describe('being searched for a pattern that only some documents contain', function () {
+      it('should return the matches of those documents', function () {
+        return union.searchTriples(namedNode('http://example.org/s2'), null, null).then(result => {
+          result.triples.should.have.length(20);
+          result.totalCount.should.equal(20);
+        });
+      });
+    });
+
+    describe('being searched with deduplication', function () {
+      it('should leave out triples of earlier documents', function () {
+        return union.searchTriples(namedNode('http://example.org/s2'), null, null, { deduplicate: true })
+          .then(result => {
+            result.triples.should.have.length(10);
+            result.totalCount.should.equal(20);
+            result.hasExactCount.should.be.false();
+          });
+      });
+
+      it('should apply the offset to the remaining triples', function () {
+        return Promise.all([
+          union.searchTriples(null, null, null, { deduplicate: true, offset: 130, limit: 10 }),
+          document.searchTriples(null, null, null, { offset: 130 }),
+          union.documents[2].searchTriples(null, null, null, { limit: 6 }),
+        ]).then(([result, end, literals]) => {
+          result.triples.should.eql(end.triples.concat(literals.triples));
+        });
+      });
+    });
+
+    describe('with an invalid list of files', function () {
+      it('should throw an error', function () {
+        return hdt.fromFiles([]).then(() => Promise.reject(new Error('Expected an error')), error => {
+          error.should.be.an.Error();
+          error.message.should.equal('Invalid filenames: ');
+        });
+      });
+    });
+
+    describe('with a file that cannot be opened', function () {
+      it('should throw an error', function () {
+        return hdt.fromFiles(['./test/test.hdt', 'abc']).then(() => Promise.reject(new Error('Expected an error')),
+          error => {
+            error.should.be.an.Error();
+            error.message.should.equal('Could not open HDT file "abc"');
+          });
+      });
+    });
+  });
+
+  describe('An HDT document that is closed while being searched', function () {
+    var result, closedDuringSearch;
+    before(function () {
+      return hdt.fromFile('./test/test.hdt').then(document => {
+        const search = document.searchTriples(null, null, null);
+        const close = document.close().then(() => {
+          closedDuringSearch = document.closed;
+        });
+        return Promise.all([search, close]).then(results => {
+          result = results[0];
+        });
+      });
+    });
+
+    it('should be closed immediately', function () {
+      closedDuringSearch.should.be.true();
+    });
+
+    it('should complete the pending search', function () {
+      result.triples.should.have.length(134);
+      result.totalCount.should.equal(134);
+    });
   });
+
   describe('A closed HDT document', function () {
     var document;
     before(function () {
@@ -1649,6 +3197,18 @@ describe('hdt', function () {
       });
     });
 
+    describe('being searched with a cursor', function () {
+      it('should throw an error', function () {
+        return document.searchTriplesCursor(null, null, null).then(() =>
+            Promise.reject(new Error('Expected an error')),
+          error => {
+            error.should.be.an.instanceOf(Error);
+            error.message.should.equal('The HDT document cannot be accessed because it is closed');
+          }
+        );
+      });
+    });
+
     describe('being searched for literals', function () {
       it('should throw an error', function () {
         return document.searchLiterals('abc').then(() =>
@@ -1662,3 +3222,11 @@ describe('hdt', function () {
     });
   });
 });
+
+// Returns the path of the sidecar file with the given extension in the directory
+function sidecarFile(directory, extension) {
+  const file = fs.readdirSync(directory).find(name => name.endsWith('.hdt' + extension));
+  if (!file)
+    throw new Error('No ' + extension + ' file in ' + directory);
+  return path.join(directory, file);
+}